@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "TSKPub/frame.hh"
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Groups the framed messages of a lidar, a camera and an IMU by
+  ///        capture time. Every lidar frame yields one SensorBundle with the
+  ///        closest camera frame and the IMU samples since the previous
+  ///        lidar frame. Only the frame headers are read, the bundle refers
+  ///        to the messages by topic id and sequence number.
+  ///        Thread safe, the sensors may be read on different threads
+  class Bundler {
+  public:
+    struct Params {
+      /// @brief Sensor names, the lidar frames set the bundle period.
+      ///        An empty camera or imu is left out of the bundles
+      std::string lidar;
+      std::string camera;
+      std::string imu;
+      /// @brief Longest wait in seconds for the camera and the IMU to pass
+      ///        a lidar frame, in capture time of the later messages
+      double max_delay{0.1};
+    };
+
+    explicit Bundler(const Params& params);
+
+    /// @brief Take note of a message, unframed messages are ignored
+    /// @param sensor Sensor name
+    /// @param msg Framed message
+    /// @return [FrameHeader][packed SensorBundle] once a bundle is
+    ///         complete, nullptr otherwise
+    MsgConstPtr add(const std::string& sensor, const Msg& msg);
+
+  private:
+    struct Ref {
+      uint16_t topic_id;
+      uint32_t seq;
+      uint64_t stamp;
+      Schema schema;
+    };
+
+    /// @brief Pack the bundle of the pending lidar frame, mtx_ is held
+    MsgConstPtr emit();
+
+    const Params params_;
+    const uint64_t max_delay_;
+    std::mutex mtx_;
+    // lidar frame waiting for the camera and the IMU
+    std::optional<Ref> lidar_;
+    // recent camera frames and the IMU samples not bundled yet
+    std::deque<Ref> cameras_;
+    std::deque<Ref> imus_;
+    // latest capture time of every sensor, 0 before the first message
+    uint64_t camera_stamp_{0};
+    uint64_t imu_stamp_{0};
+    uint64_t newest_{0};
+    // lidar frame of the previous bundle
+    uint64_t start_{0};
+    uint32_t seq_{0};
+  };
+}  // namespace tskpub
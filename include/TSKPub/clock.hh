@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Capture times of all readers. Times are taken on the monotonic
+  ///        clock and mapped to wall time with a smoothed offset, so that a
+  ///        step of the system clock, e.g. the first NTP sync after the link
+  ///        comes up, does not reach the messages as a jump
+  class Clock {
+  public:
+    /// @brief Monotonic time in nanoseconds
+    static uint64_t mono_now();
+
+    /// @brief Wall time in nanoseconds of a monotonic time
+    static uint64_t to_wall(uint64_t mono);
+
+    /// @brief Wall time in nanoseconds of a system clock time, e.g. a
+    ///        capture time taken by a driver
+    static uint64_t from_system(uint64_t system);
+
+    /// @brief Current wall time in nanoseconds, to_wall(mono_now())
+    static uint64_t now();
+
+  private:
+    Clock() = delete;
+  };
+
+  /// @brief Smoothed offset from the monotonic clock to the system clock.
+  ///        Small errors are slewed out, larger ones are stepped at once
+  class OffsetFilter {
+  public:
+    struct Params {
+      /// @brief Largest change of the offset per second
+      double slew{0.0005};
+      /// @brief Errors above this many nanoseconds are stepped
+      uint64_t step{500000000};
+    };
+
+    explicit OffsetFilter(const Params& params) : params_(params) {}
+
+    /// @brief Follow a measured offset
+    /// @param mono Monotonic time of the measurement in nanoseconds
+    /// @param measured System time minus monotonic time in nanoseconds
+    /// @return true if the offset was stepped
+    bool update(uint64_t mono, int64_t measured);
+
+    /// @brief Smoothed offset in nanoseconds, 0 before the first update
+    int64_t offset() const { return offset_; }
+
+  private:
+    const Params params_;
+    int64_t offset_{0};
+    uint64_t last_{0};
+    bool init_{false};
+  };
+
+  /// @brief Sample times of a sensor that stamps its samples with its own
+  ///        clock. A line from the sensor clock to the arrival times is
+  ///        fitted over the recent samples and moved down to the least
+  ///        delayed one, so that the variable buffering delay of serial and
+  ///        USB links is taken out while the drift of the sensor clock is
+  ///        followed
+  class StampFilter {
+  public:
+    struct Params {
+      /// @brief Samples in the fit
+      size_t window{256};
+      /// @brief Samples before the fit is used, arrival times until then
+      size_t warmup{16};
+      /// @brief Largest correction in nanoseconds, the filter restarts
+      ///        beyond it
+      uint64_t max_delay{20000000};
+      /// @brief Silence in nanoseconds after which the filter restarts
+      uint64_t max_gap{1000000000};
+    };
+
+    explicit StampFilter(const Params& params);
+
+    /// @brief Estimate the sample time of a sample. The filter restarts
+    ///        when the sensor time does not increase, so a sensor without
+    ///        a clock gets its arrival times back
+    /// @param arrival Arrival time in nanoseconds
+    /// @param sensor Sample time on the sensor clock in nanoseconds, any
+    ///        origin
+    /// @return Sample time in nanoseconds, not after arrival and not
+    ///         decreasing
+    uint64_t update(uint64_t arrival, uint64_t sensor);
+
+    /// @brief Forget the fit
+    void reset();
+
+    /// @brief Arrival nanoseconds per sensor nanosecond, 0 during the
+    ///        warmup
+    double rate() const { return rate_; }
+
+  private:
+    struct Point {
+      uint64_t sensor;
+      uint64_t arrival;
+    };
+
+    const Params params_;
+    // ring of the recent samples
+    std::vector<Point> points_;
+    size_t head_{0};
+    size_t count_{0};
+    // previous estimate, later ones do not go below it
+    uint64_t last_{0};
+    double rate_{0};
+  };
+}  // namespace tskpub
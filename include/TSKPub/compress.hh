@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Compression algorithms, stored in the low nibble of the header
+  enum class Compression : uint8_t {
+    None = 0,
+    LZ4 = 1,
+    Zstd = 2,
+  };
+
+  /// @brief Header in front of a compressed message body.
+  ///        Layout: [0xC0 | algorithm][dictionary id][raw size as LEB128]
+  struct CompressHeader {
+    /// @brief Upper nibble of the first byte, marks a compressed body
+    static constexpr uint8_t Magic = 0xC0;
+    /// @brief Maximum encoded header size
+    static constexpr size_t MaxSize = 2 + 10;
+    /// @brief Default limit of the uncompressed size a decoder accepts
+    static constexpr uint64_t MaxRawSize = uint64_t(256) << 20;
+
+    Compression algo{Compression::None};
+    /// @brief Dictionary id, 0 means no dictionary
+    uint8_t dict_id{0};
+    /// @brief Size of the uncompressed body
+    uint64_t raw_size{0};
+
+    /// @brief Write the header
+    /// @param dst Buffer with at least MaxSize bytes
+    /// @return Number of bytes written
+    size_t encode(uint8_t* dst) const;
+
+    /// @brief Read the header
+    /// @param src Message body
+    /// @param size Size of the body
+    /// @return Number of bytes read, 0 if src does not start with a header
+    size_t decode(const uint8_t* src, size_t size);
+  };
+
+  /// @brief General purpose compressor applied after capnp packing
+  class Compressor {
+  public:
+    using Ptr = std::shared_ptr<Compressor>;
+    virtual ~Compressor() = default;
+
+    /// @brief Algorithm written into the header
+    virtual Compression algo() const = 0;
+
+    /// @brief Worst case compressed size of n bytes
+    virtual size_t bound(size_t n) const = 0;
+
+    /// @brief Compress a buffer
+    /// @param src Input
+    /// @param n Input size
+    /// @param dst Output with at least bound(n) bytes
+    /// @return Compressed size, 0 on failure
+    virtual size_t compress(const uint8_t* src, size_t n, uint8_t* dst) = 0;
+
+    /// @brief Dictionary id written into the header
+    uint8_t dict_id() const { return dict_id_; }
+
+  protected:
+    uint8_t dict_id_{0};
+  };
+
+  /// @brief Parameters of a compressor
+  struct CompressParams {
+    /// @brief Algorithm name: lz4, zstd
+    std::string algo;
+    /// @brief Compression level, meaning depends on the algorithm
+    int level{0};
+    /// @brief Dictionary content, empty means no dictionary
+    Msg dict;
+    /// @brief Dictionary id, must be unique among the dictionaries in use
+    uint8_t dict_id{0};
+  };
+
+  /// @brief Factory class for creating compressors
+  class CompressorFactory {
+  public:
+    /// @brief Creator function type
+    using Creator = std::function<Compressor::Ptr(const CompressParams&)>;
+
+    /// @brief Create a compressor
+    /// @param params Compressor parameters
+    /// @return Compressor::Ptr, nullptr if the algorithm is unknown
+    static Compressor::Ptr create(const CompressParams& params);
+
+    /// @brief Register a creator function
+    /// @param algo Algorithm name
+    /// @param creator Creator function
+    /// @return false if the algorithm already exists
+    static bool regist(std::string algo, Creator creator);
+
+    /// @brief algo -> Creator map, constructed on first use
+    static std::unordered_map<std::string, Creator>& creaters();
+
+  private:
+    CompressorFactory() = delete;
+  };
+
+  /// @brief Compress a message body and put the header in front of it.
+  ///        Falls back to Compression::None when compression does not help
+  /// @param c Compressor
+  /// @param src Message body
+  /// @param n Body size
+  /// @param prefix Bytes to write before the header (sensor name)
+  /// @return Byte vector [prefix][header][compressed body]
+  MsgPtr compress(Compressor& c, const uint8_t* src, size_t n,
+                  const std::string& prefix = "");
+
+  /// @brief Register a dictionary for decompression
+  /// @param id Dictionary id used in the header
+  /// @param dict Dictionary content
+  void add_dictionary(uint8_t id, const Msg& dict);
+
+  /// @brief Decompress a message body starting with a CompressHeader.
+  ///        Throws std::runtime_error on malformed input. The raw size of
+  ///        the header is checked against max_size and against what the
+  ///        compressed size can expand to before anything is allocated
+  /// @param src Message body (without the sensor name prefix)
+  /// @param n Body size
+  /// @param max_size Largest accepted uncompressed size
+  /// @return Uncompressed body
+  Msg decompress(const uint8_t* src, size_t n,
+                 uint64_t max_size = CompressHeader::MaxRawSize);
+
+  /// @brief Train a zstd dictionary from recorded message bodies
+  /// @param samples Recorded messages
+  /// @param capacity Maximum dictionary size in bytes
+  /// @return Dictionary content, empty on failure
+  Msg train_dictionary(const std::vector<Msg>& samples, size_t capacity);
+}  // namespace tskpub
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "TSKPub/simd.hh"
+
+namespace tskpub {
+  /// @brief Point filter applied while converting a lidar frame.
+  ///        A point is kept if it is not NaN, inside the box, inside the
+  ///        range shell around the sensor and its intensity is in range.
+  ///        The defaults keep every valid point
+  struct CropParams {
+    static constexpr float inf = std::numeric_limits<float>::infinity();
+    /// @brief Distance to the sensor in meters
+    float min_range{0.f};
+    float max_range{inf};
+    /// @brief Axis aligned box in meters
+    float min[3]{-inf, -inf, -inf};
+    float max[3]{inf, inf, inf};
+    /// @brief Intensity thresholds
+    float min_intensity{-inf};
+    float max_intensity{inf};
+  };
+
+  /// @brief Filter and convert points in one pass.
+  ///        Four points are tested at a time in SoA form, kept points are
+  ///        compacted without branches: every point is written to out and
+  ///        the output index only advances if it passed. The float after z
+  ///        of a kept point holds its capture position i / n in [0, 1), so
+  ///        rotate_points() finds its capture time after the removed points
+  /// @tparam InT x, y, z and intensity as 4 consecutive floats
+  /// @tparam OutT point type with x, y, z (consecutive) and intensity members,
+  ///         at least 16 bytes from x are written, the fourth float is the
+  ///         capture position unless it is the intensity
+  /// @param in input points
+  /// @param n number of input points
+  /// @param params filter
+  /// @param out output buffer with room for n points
+  /// @return number of points kept, stored in out[0, ret)
+  template <typename InT, typename OutT>
+  size_t crop_points(const InT* in, size_t n, const CropParams& params,
+                     OutT* out) {
+    static_assert(sizeof(InT) == 4 * sizeof(float),
+                  "input must be packed x, y, z, intensity");
+    static_assert(sizeof(OutT) >= 4 * sizeof(float),
+                  "output must have room for x, y, z and a pad");
+    using namespace simd;
+    const f32x4 lo{params.min[0], params.min[1], params.min[2],
+                   params.min_intensity};
+    const f32x4 hi{params.max[0], params.max[1], params.max[2],
+                   params.max_intensity};
+    const float rmin = params.min_range * params.min_range;
+    const float rmax = params.max_range * params.max_range;
+
+    size_t k = 0;
+    const float step = n ? 1.f / n : 0.f;
+    auto store = [&](const f32x4& p, size_t i, int32_t keep) {
+      auto q = p;
+      q[3] = i * step;
+      std::memcpy(&out[k].x, &q, sizeof(q));
+      out[k].intensity = p[3];
+      k += keep & 1;
+    };
+
+    size_t i = 0;
+    const f32x4 lx = splat(lo[0]), ly = splat(lo[1]), lz = splat(lo[2]),
+                lv = splat(lo[3]);
+    const f32x4 hx = splat(hi[0]), hy = splat(hi[1]), hz = splat(hi[2]),
+                hv = splat(hi[3]);
+    const f32x4 rlo = splat(rmin), rhi = splat(rmax);
+    for (; i + 4 <= n; i += 4) {
+      auto p0 = load(in + i), p1 = load(in + i + 1), p2 = load(in + i + 2),
+           p3 = load(in + i + 3);
+      // transpose to x, y, z, intensity of four points
+      f32x4 x{p0[0], p1[0], p2[0], p3[0]};
+      f32x4 y{p0[1], p1[1], p2[1], p3[1]};
+      f32x4 z{p0[2], p1[2], p2[2], p3[2]};
+      f32x4 v{p0[3], p1[3], p2[3], p3[3]};
+      auto r = x * x + y * y + z * z;
+      // NaN fails every comparison
+      i32x4 m = (x >= lx) & (x <= hx) & (y >= ly) & (y <= hy) & (z >= lz)
+                & (z <= hz) & (v >= lv) & (v <= hv) & (r >= rlo)
+                & (r <= rhi);
+      store(p0, i, m[0]);
+      store(p1, i + 1, m[1]);
+      store(p2, i + 2, m[2]);
+      store(p3, i + 3, m[3]);
+    }
+    for (; i < n; i++) {
+      auto p = load(in + i);
+      i32x4 m = (p >= lo) & (p <= hi);
+      float r = p[0] * p[0] + p[1] * p[1] + p[2] * p[2];
+      store(p, i, m[0] & m[1] & m[2] & m[3] & -(r >= rmin) & -(r <= rmax));
+    }
+    return k;
+  }
+}  // namespace tskpub
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "TSKPub/imu_history.hh"
+#include "TSKPub/simd.hh"
+
+namespace tskpub {
+  /// @brief Rotations that move points captured during a window into the
+  ///        sensor frame at its end. The window is cut into slices of equal
+  ///        time, every slice gets the rotation at its middle
+  /// @param rates Angular rates covering (start, end] from ImuHistory::copy,
+  ///        the last rate is held if they end early
+  /// @param n Number of rates
+  /// @param start Window start in nanoseconds
+  /// @param end Window end in nanoseconds
+  /// @param slices Number of slices
+  /// @param out 3x3 row major rotation of every slice, 9 * slices floats
+  void deskew_rotations(const RateSample* rates, size_t n, uint64_t start,
+                        uint64_t end, size_t slices, float* out);
+
+  /// @brief Rotate points in place. The float after z is the capture
+  ///        position of the point in [0, 1) as written by crop_points(), the
+  ///        point is in slice position * slices and the float is set back
+  ///        to 1. One point per vector: the columns of the rotation are
+  ///        scaled by x, y and z and added
+  /// @tparam PointT point type with x, y, z (consecutive), at least 16 bytes
+  ///         from x
+  /// @param pts Points
+  /// @param n Number of points
+  /// @param rotations Rotations from deskew_rotations()
+  /// @param slices Number of slices
+  template <typename PointT>
+  void rotate_points(PointT* pts, size_t n, const float* rotations,
+                     size_t slices) {
+    static_assert(sizeof(PointT) >= 4 * sizeof(float),
+                  "point must have room for x, y, z and a pad");
+    using namespace simd;
+    // points come mostly in capture order, the columns are only loaded
+    // when the slice changes
+    size_t slice = slices;
+    f32x4 c0{}, c1{}, c2{};
+    for (size_t i = 0; i < n; i++) {
+      auto p = load(&pts[i].x);
+      // NaN and positions out of range go to the nearest slice
+      const float pos = p[3] * slices;
+      size_t k = !(pos > 0.f)            ? 0
+                 : pos < float(slices) ? size_t(pos)
+                                       : slices - 1;
+      if (k != slice) {
+        const float* r = rotations + k * 9;
+        c0 = f32x4{r[0], r[3], r[6], 0.f};
+        c1 = f32x4{r[1], r[4], r[7], 0.f};
+        c2 = f32x4{r[2], r[5], r[8], 0.f};
+        slice = k;
+      }
+      auto q = c0 * p[0] + c1 * p[1] + c2 * p[2];
+      q[3] = 1.f;
+      store(&pts[i].x, q);
+    }
+  }
+}  // namespace tskpub
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Fixed pool of workers for reading, packaging and compression.
+  ///        Every worker has its own queue per priority and steals from the
+  ///        others when it runs dry, so a lidar burst spreads over idle
+  ///        cores. A worker always takes the highest priority task of the
+  ///        whole pool, its own queue first
+  class Executor {
+  public:
+    using Task = std::function<void()>;
+
+    /// @brief Task priority, IMU tasks jump the queue of the others
+    enum class Priority : uint8_t {
+      High,
+      Normal,
+      Low,
+      /// @brief Number of priorities
+      Count,
+    };
+
+    /// @brief Start the workers
+    /// @param workers Number of worker threads, at least one
+    explicit Executor(size_t workers);
+
+    /// @brief Run the queued tasks and join the workers
+    ~Executor();
+
+    /// @brief Shared executor of the readers, never destroyed. The size is
+    ///        app.workers of the config file, the number of cores without it
+    static Executor& shared();
+
+    /// @brief Queue a task. Tasks submitted by a worker go to its own queue
+    /// @param task Task
+    /// @param priority Priority
+    void submit(Task task, Priority priority = Priority::Normal);
+
+    /// @brief Number of workers
+    size_t size() const { return workers_.size(); }
+
+    /// @brief Number of tasks taken from the queue of another worker
+    uint64_t steals() const { return steals_; }
+
+  private:
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    struct Worker {
+      std::mutex mtx;
+      std::array<std::deque<Task>, size_t(Priority::Count)> queues;
+    };
+
+    /// @brief Worker thread
+    void run(size_t index);
+
+    /// @brief Take the next task for a worker
+    /// @return false if every queue is empty
+    bool take(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+    // queued tasks, may be negative for a moment between push and count
+    std::atomic<int64_t> pending_{0};
+    std::atomic<size_t> next_{0};
+    std::atomic<uint64_t> steals_{0};
+    // guards stop_ and the sleeping workers
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_{false};
+  };
+}  // namespace tskpub
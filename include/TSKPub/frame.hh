@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tskpub {
+  /// @brief Capnp schema of a message body, sent in the frame header so that
+  ///        subscribers need no topic text to decode
+  enum class Schema : uint8_t {
+    Unknown = 0,
+    Status = 1,
+    Imu = 2,
+    Image = 3,
+    PointCloud = 4,
+    OctreeCloud = 5,
+    RangeImage = 6,
+    TopicDictionary = 7,
+    ImuDelta = 8,
+    SensorBundle = 9,
+    Series = 10,
+  };
+
+  /// @brief Schema of a reader message type (the type key of the config)
+  /// @param msg_type Status, Imu, Image, PointCloud, ...
+  /// @return Schema::Unknown for unknown types
+  Schema schema_from_type(const std::string& msg_type);
+
+  /// @brief Fixed binary header in front of every message body.
+  ///        Layout, little endian:
+  ///        [version << 4 | flags][schema][topic id:2][sequence:4][stamp:8]
+  struct FrameHeader {
+    static constexpr uint8_t Version = 1;
+    static constexpr size_t Size = 16;
+    /// @brief Topic id of the topic dictionary message
+    static constexpr uint16_t DictionaryId = 0xffff;
+    /// @brief Topic id of the sensor bundle message
+    static constexpr uint16_t BundleId = 0xfffe;
+
+    /// @brief Flags in the low nibble of the first byte
+    enum Flags : uint8_t {
+      /// @brief The body starts with a CompressHeader
+      Compressed = 1,
+    };
+
+    uint8_t flags{0};
+    Schema schema{Schema::Unknown};
+    /// @brief Position of the sensor in the sensor list plus one, 0 for
+    ///        readers outside of the list
+    uint16_t topic_id{0};
+    /// @brief Per topic message counter
+    uint32_t seq{0};
+    /// @brief Capture time in nanoseconds
+    uint64_t stamp{0};
+
+    /// @brief Write the header
+    /// @param dst Buffer with at least Size bytes
+    void encode(uint8_t* dst) const;
+
+    /// @brief Read the header
+    /// @param src Message
+    /// @param size Size of the message
+    /// @return false if src is too short or has another version
+    bool decode(const uint8_t* src, size_t size);
+  };
+
+  /// @brief First frame of a framed message, subscribers filter on it. The
+  ///        message is the two frames [name\0] and [FrameHeader][body], so
+  ///        the body is sent without copying it behind the topic. The
+  ///        terminating zero keeps "imu" from matching "imu0"
+  /// @param sensor_name Sensor name
+  /// @return Topic frame content
+  inline std::string topic_frame(const std::string& sensor_name) {
+    return sensor_name + '\0';
+  }
+
+  /// @brief Sensor name of the topic dictionary message
+  inline const std::string& dictionary_topic() {
+    static const std::string name{"_dictionary"};
+    return name;
+  }
+
+  /// @brief Sensor name of the sensor bundle message
+  inline const std::string& bundle_topic() {
+    static const std::string name{"_bundle"};
+    return name;
+  }
+}  // namespace tskpub
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Time series coder after Facebook Gorilla, one sample of a fixed
+  ///        set of channels per call, each coded against the previous one.
+  ///        Bits are written most significant first, the last byte is
+  ///        padded with zeros.
+  ///
+  ///        A key sample is [stamp:64][value:64]... and needs no earlier
+  ///        sample. Any other sample is the delta of delta of the stamp
+  ///        followed by every value XOR the previous one:
+  ///
+  ///        stamp  '0' same delta, '10' 16 bits, '110' 24 bits,
+  ///               '1110' 36 bits, '1111' 64 bits, two's complement ns
+  ///        value  '0' unchanged, '10' meaningful bits in the window of the
+  ///               previous value of the channel, '11' [leading zeros:5]
+  ///               [meaningful bits:6, 0 for 64][meaningful bits]
+  ///
+  ///        A subscriber decodes from a key on and waits for the next key
+  ///        after a missing sample, so keys are repeated every key_interval
+  ///        samples
+  class GorillaEncoder {
+  public:
+    /// @param key_interval samples from one key to the next, 1 makes every
+    ///        sample a key
+    explicit GorillaEncoder(uint32_t key_interval);
+
+    /// @brief Code a sample, a key if the interval is over, after reset()
+    ///        or when the number of channels changed
+    /// @param stamp capture time in nanoseconds
+    /// @param values channel values
+    /// @param n number of channels
+    /// @param out coded sample, replaced
+    /// @return number of samples since the last key, 0 for a key
+    uint32_t encode(uint64_t stamp, const double* values, size_t n,
+                    std::vector<uint8_t>& out);
+
+    /// @brief Code the next sample as a key
+    void reset() { index_ = 0; }
+
+  private:
+    uint32_t key_interval_;
+    // index of the next sample since the last key
+    uint32_t index_{0};
+    uint64_t stamp_{0};
+    uint64_t delta_{0};
+    // bit patterns of the previous values
+    std::vector<uint64_t> values_;
+    // leading and trailing zeros of the previous XOR window of each
+    // channel, leading 64 while there is none
+    std::vector<uint8_t> leading_, trailing_;
+  };
+}  // namespace tskpub
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tskpub {
+  /// @brief Angular rate of an IMU, held from the previous sample to stamp
+  struct RateSample {
+    /// @brief Sample time in nanoseconds
+    uint64_t stamp;
+    /// @brief Angular rate in rad/s
+    float gyr[3];
+  };
+
+  /// @brief Recent angular rates of an IMU, shared with other readers.
+  ///        One thread pushes, any number of threads copy without locks: a
+  ///        copy checks afterwards which slots were overwritten meanwhile
+  class ImuHistory {
+  public:
+    /// @brief Number of samples kept, about 2.5 s at 400 Hz
+    static constexpr size_t Capacity = 1024;
+
+    /// @brief History of an IMU, created on first use and never removed
+    /// @param imu Sensor name of the IMU
+    static ImuHistory& get(const std::string& imu);
+
+    /// @brief Append a sample, only called by the decoding thread
+    /// @param stamp Sample time in nanoseconds, not decreasing
+    /// @param gyr Angular rate in rad/s
+    void push(uint64_t stamp, const float gyr[3]);
+
+    /// @brief Copy the samples covering (from, to]: every sample after from
+    ///        up to the first one at or after to, oldest first
+    /// @param from Start time in nanoseconds
+    /// @param to End time in nanoseconds
+    /// @param out Output
+    /// @param max Size of out
+    /// @return Number of samples, 0 if the history does not reach from
+    size_t copy(uint64_t from, uint64_t to, RateSample* out,
+                size_t max) const;
+
+  private:
+    struct Slot {
+      std::atomic<uint64_t> stamp{0};
+      std::atomic<float> gyr[3]{};
+    };
+
+    std::array<Slot, Capacity> slots_;
+    // index of the next sample, published after the slot is written
+    std::atomic<uint64_t> head_{0};
+    // index of the sample being written, taken before the slot is written
+    std::atomic<uint64_t> claim_{0};
+  };
+}  // namespace tskpub
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Level of detail parameters
+  struct LodParams {
+    /// @brief Number of layers, at least 1
+    uint8_t layers{4};
+    /// @brief Density ratio between neighbouring layers, at least 2. Layer
+    ///        0 keeps every stride^(layers - 1)-th point
+    uint32_t stride{4};
+  };
+
+  /// @brief Splits a point cloud into progressive layers.
+  ///        The points are ordered along a Morton curve over the bounding
+  ///        cube of the frame, so that every stride-th point of the curve
+  ///        is a spatially even sample. Layer 0 is the coarsest sample on
+  ///        its own, every further layer holds the points of the next finer
+  ///        sample that are not in the layers before. All layers together
+  ///        are the whole cloud, each layer stays in curve order. Buffers
+  ///        are reused between frames
+  class LodSplitter {
+  public:
+    /// @brief Bits per axis of the curve grid, the order inside a cell of
+    ///        1/1024 of the bounding cube is the input order
+    static constexpr int Bits = 10;
+
+    explicit LodSplitter(const LodParams& params);
+
+    /// @brief Reorder a point cloud layer by layer
+    /// @tparam PointT point type with x, y and z members
+    /// @param points first point, no NaN
+    /// @param n number of points
+    /// @param out reordered points, layer k is [offset(k), offset(k + 1))
+    template <typename PointT, typename Alloc>
+    void split(const PointT* points, size_t n,
+               std::vector<PointT, Alloc>& out) {
+      float lo[3]{0, 0, 0}, hi[3]{0, 0, 0};
+      for (size_t i = 0; i < n; i++) {
+        const float v[3]{points[i].x, points[i].y, points[i].z};
+        for (int a = 0; a < 3; a++) {
+          lo[a] = i == 0 ? v[a] : std::min(lo[a], v[a]);
+          hi[a] = i == 0 ? v[a] : std::max(hi[a], v[a]);
+        }
+      }
+      // a cube keeps the curve from stretching along the long axis
+      float edge = std::max({hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]});
+      const float scale = edge > 0 ? ((1u << Bits) - 1) / edge : 0.f;
+      keys_.resize(n);
+      for (size_t i = 0; i < n; i++) {
+        const auto& p = points[i];
+        keys_[i] = {code((p.x - lo[0]) * scale, (p.y - lo[1]) * scale,
+                         (p.z - lo[2]) * scale),
+                    static_cast<uint32_t>(i)};
+      }
+      order();
+      out.resize(n);
+      for (size_t i = 0; i < n; i++) out[i] = points[keys_[i].second];
+    }
+
+    /// @brief First point of a layer in the output of the last split()
+    /// @param layer 0 to layers(), layers() gives the number of points
+    size_t offset(size_t layer) const { return offsets_[layer]; }
+
+    /// @brief Number of layers
+    uint8_t layers() const { return params_.layers; }
+
+  private:
+    /// @brief Morton code of a grid cell
+    static uint32_t code(float x, float y, float z);
+
+    /// @brief Sort keys_ along the curve, then group them layer by layer
+    ///        and fill offsets_
+    void order();
+
+    LodParams params_;
+    // (morton code, point index), in output order after order()
+    std::vector<std::pair<uint32_t, uint32_t>> keys_, scratch_;
+    std::vector<size_t> offsets_;
+  };
+}  // namespace tskpub
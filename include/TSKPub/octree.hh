@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Octree occupancy coded point cloud.
+  ///        Points are quantized into voxels of a fixed grid, the voxels are
+  ///        described by one child mask byte per octree node in breadth first
+  ///        order and one intensity byte per voxel in Morton order.
+  ///        Non-key frames only carry the voxels removed since the reference
+  ///        frame and the ones added or whose intensity changed by more than
+  ///        OctreeParams::intensity_threshold
+  struct OctreeFrame {
+    /// @brief Frame counter
+    uint32_t frame_index{0};
+    /// @brief Frame a non-key frame applies to, the previous frame or the
+    ///        last key frame, see OctreeParams::reference
+    uint32_t reference{0};
+    /// @brief Full frame or difference to the reference frame
+    bool keyframe{true};
+    /// @brief Voxel edge length in meters
+    float resolution{0};
+    /// @brief Minimum corner of the grid
+    float origin[3]{0, 0, 0};
+    /// @brief Octree depth, the grid has 2^depth voxels per axis
+    uint8_t depth{0};
+    /// @brief Child masks of the (added or updated) voxels
+    std::vector<uint8_t> occupancy;
+    /// @brief Intensity of each (added or updated) voxel
+    std::vector<uint8_t> intensity;
+    /// @brief Child masks of the removed voxels, empty for key frames
+    std::vector<uint8_t> removed;
+
+    /// @brief Payload size in bytes
+    size_t bytes() const {
+      return occupancy.size() + intensity.size() + removed.size();
+    }
+  };
+
+  /// @brief Octree codec parameters
+  struct OctreeParams {
+    /// @brief Voxel edge length in meters
+    float resolution{0.01f};
+    /// @brief Half edge length of the cube around the sensor to encode
+    float range{8.f};
+    /// @brief Intensity mapped to 255
+    float max_intensity{2000.f};
+    /// @brief Send a key frame every n frames, 1 disables differences
+    uint32_t keyframe_interval{10};
+    /// @brief Intensity change (0~255) that makes a kept voxel resent
+    uint8_t intensity_threshold{4};
+    /// @brief Frame the differences are taken against
+    enum class Reference {
+      /// @brief Smallest differences, a lost frame breaks the chain until
+      ///        the next key frame
+      Previous,
+      /// @brief Every difference only needs the last key frame, lost frames
+      ///        are skipped
+      Keyframe,
+    };
+    Reference reference{Reference::Previous};
+  };
+
+  /// @brief Hash set of the voxels of a frame keyed by morton code, with the
+  ///        intensity sum of the points in each. The voxels are stored in the
+  ///        slots of an open addressing table with linear probing, clear()
+  ///        only bumps a generation counter so the table is reused between
+  ///        frames
+  class VoxelHash {
+  public:
+    struct Voxel {
+      uint64_t code;
+      uint32_t sum;
+      uint16_t count;
+      // slots of another generation are empty
+      uint16_t generation;
+
+      /// @brief Mean intensity of the points
+      uint8_t intensity() const { return sum / count; }
+    };
+
+    /// @brief Remove all voxels, the memory is kept
+    void clear();
+
+    /// @brief Add a point to a voxel
+    /// @param code morton code of the voxel
+    /// @param intensity intensity of the point
+    void add(uint64_t code, uint8_t intensity);
+
+    /// @brief Voxel of a code, nullptr if there is none
+    const Voxel* find(uint64_t code) const;
+
+    /// @brief Call f with every voxel, in slot order
+    template <typename F>
+    void for_each(F&& f) {
+      for (auto& v : slots_) {
+        if (v.generation == generation_) f(v);
+      }
+    }
+
+    size_t size() const { return size_; }
+
+  private:
+    /// @brief First slot to probe for a code
+    size_t home(uint64_t code) const {
+      return (code * 0x9e3779b97f4a7c15ull) >> shift_;
+    }
+
+    /// @brief Double the slots and insert the voxels again
+    void grow();
+
+    std::vector<Voxel> slots_;
+    size_t size_{0};
+    uint16_t generation_{1};
+    int shift_{64};
+  };
+
+  /// @brief Octree encoder, keeps the reference frame in a VoxelHash for
+  ///        difference coding. All buffers are reused between frames
+  class OctreeEncoder {
+  public:
+    OctreeEncoder(const OctreeParams& params);
+
+    /// @brief Encode a point cloud
+    /// @tparam PointT point type with x, y, z and intensity members
+    /// @param points first point
+    /// @param n number of points
+    /// @param out encoded frame, buffers are reused
+    template <typename PointT>
+    void encode(const PointT* points, size_t n, OctreeFrame& out) {
+      current_.clear();
+      for (size_t i = 0; i < n; i++) {
+        const auto& p = points[i];
+        uint64_t code;
+        if (!quantize(p.x, p.y, p.z, code)) continue;
+        auto v = std::clamp(p.intensity * intensity_scale_, 0.f, 255.f);
+        current_.add(code, static_cast<uint8_t>(v));
+      }
+      encode_voxels(out);
+    }
+
+    /// @brief Force the next frame to be a key frame
+    void reset() { count_ = 0; }
+
+    /// @brief Octree depth derived from the parameters
+    uint8_t depth() const { return depth_; }
+
+  private:
+    /// @brief Voxel index of a point
+    /// @return false if the point is outside the grid or NaN
+    bool quantize(float x, float y, float z, uint64_t& code) const;
+
+    /// @brief Write the frame of current_
+    void encode_voxels(OctreeFrame& out);
+
+    /// @brief Difference between current_ and reference_ into added_ and
+    ///        removed_
+    /// @return false if the difference is not smaller than the frame
+    bool diff();
+
+    /// @brief Sort (code, intensity) pairs and write their child masks and
+    ///        intensities
+    void write(std::vector<std::pair<uint64_t, uint8_t>>& voxels,
+               std::vector<uint8_t>& occupancy,
+               std::vector<uint8_t>& intensity);
+
+    OctreeParams params_;
+    uint8_t depth_;
+    float origin_;
+    float intensity_scale_;
+    uint32_t count_{0};
+    uint32_t frame_index_{0};
+    uint32_t reference_index_{0};
+
+    // voxels of the current frame
+    VoxelHash current_;
+    // voxels as the decoder knows them after the reference frame
+    VoxelHash reference_;
+    // scratch buffers for the frame and difference coding
+    std::vector<std::pair<uint64_t, uint8_t>> voxels_, added_, scratch_;
+    std::vector<uint64_t> codes_, removed_;
+  };
+
+  /// @brief Octree decoder, keeps the previous frame and the last key frame
+  ///        for difference coding
+  class OctreeDecoder {
+  public:
+    struct Point {
+      float x, y, z, intensity;
+    };
+
+    /// @brief Decode a frame
+    /// @param frame encoded frame
+    /// @param max_intensity must match OctreeParams::max_intensity
+    /// @param out voxel centers of the full cloud
+    /// @return false if the reference of a non-key frame is not known
+    bool decode(const OctreeFrame& frame, float max_intensity,
+                std::vector<Point>& out);
+
+  private:
+    // sorted voxels and their intensity of the previous frame
+    std::vector<std::pair<uint64_t, uint8_t>> voxels_;
+    uint32_t frame_index_{0};
+    bool valid_{false};
+    // the same for the last key frame
+    std::vector<std::pair<uint64_t, uint8_t>> key_;
+    uint32_t key_index_{0};
+    bool key_valid_{false};
+    // scratch buffer of the merged voxels
+    std::vector<std::pair<uint64_t, uint8_t>> merged_;
+  };
+
+  /// @brief Write the child masks of sorted unique morton codes
+  /// @param codes sorted unique morton codes
+  /// @param depth octree depth
+  /// @param out child masks in breadth first order
+  void encode_occupancy(const std::vector<uint64_t>& codes, uint8_t depth,
+                        std::vector<uint8_t>& out);
+
+  /// @brief Read child masks back into sorted morton codes
+  /// @param occupancy child masks in breadth first order
+  /// @param depth octree depth
+  /// @param out sorted morton codes
+  /// @return false if the masks are truncated
+  bool decode_occupancy(const std::vector<uint8_t>& occupancy, uint8_t depth,
+                        std::vector<uint64_t>& out);
+}  // namespace tskpub
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace tskpub {
+  /// @brief Noise densities of an IMU, used for the delta covariance
+  struct ImuNoise {
+    /// @brief Gyroscope noise density in rad/s/sqrt(Hz)
+    double gyro{1.7e-4};
+    /// @brief Accelerometer noise density in m/s^2/sqrt(Hz)
+    double acc{2.0e-3};
+  };
+
+  /// @brief Motion between two times, expressed in the body frame at the
+  ///        start. Gravity is not removed: in a world frame with gravity g
+  ///        the velocity gains g * dt and the position 0.5 * g * dt^2
+  struct ImuDelta {
+    /// @brief Start and end time in nanoseconds
+    uint64_t start{0};
+    uint64_t end{0};
+    /// @brief Number of integrated samples, split ones count on both sides
+    uint32_t samples{0};
+    /// @brief Rotation from the end body frame to the start one, w x y z
+    std::array<double, 4> rotation{1, 0, 0, 0};
+    /// @brief Velocity change in m/s
+    std::array<double, 3> velocity{0, 0, 0};
+    /// @brief Position change in m
+    std::array<double, 3> position{0, 0, 0};
+    /// @brief Covariance of the rotation (so3), velocity and position
+    ///        errors, 9x9 row major
+    std::array<double, 81> covariance{};
+
+    /// @brief Duration in seconds
+    double duration() const { return (end - start) * 1e-9; }
+  };
+
+  /// @brief On-manifold IMU preintegration. Every sample is held constant
+  ///        from the end of the delta to its time stamp, so a sample can be
+  ///        split at an anchor by integrating it up to the anchor, calling
+  ///        reset() and integrating it again. Never allocates
+  class Preintegrator {
+  public:
+    explicit Preintegrator(const ImuNoise& noise = {}) : noise_(noise) {}
+
+    /// @brief Start an empty delta
+    /// @param start Start time in nanoseconds
+    void reset(uint64_t start);
+
+    /// @brief Integrate a sample from delta().end to stamp, ignored unless
+    ///        stamp is after delta().end
+    /// @param acc Specific force in m/s^2
+    /// @param gyr Angular rate in rad/s
+    /// @param stamp Sample time in nanoseconds
+    void integrate(const double acc[3], const double gyr[3], uint64_t stamp);
+
+    /// @brief Delta since the last reset()
+    const ImuDelta& delta() const { return delta_; }
+
+  private:
+    ImuNoise noise_;
+    ImuDelta delta_;
+    // rotation of delta_ as a matrix, row major
+    std::array<double, 9> rot_{1, 0, 0, 0, 1, 0, 0, 0, 1};
+  };
+}  // namespace tskpub
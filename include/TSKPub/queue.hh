@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Bounded queue between the reading threads and the publisher.
+  ///        Every topic is limited in messages and bytes, and all topics
+  ///        together by a memory ceiling. Messages are shared, not copied,
+  ///        so a message is accounted with its allocated capacity.
+  ///        Thread safe, any number of producers and one consumer
+  class MessageQueue {
+  public:
+    /// @brief What to do with a message that does not fit
+    enum class Policy {
+      /// @brief Discard the oldest queued messages of the topic
+      DropOldest,
+      /// @brief Discard the new message
+      DropNewest,
+      /// @brief Wait in push() until the consumer made room
+      Block,
+    };
+
+    /// @brief Per topic limits
+    struct TopicParams {
+      /// @brief Maximum queued messages
+      size_t max_msgs{8};
+      /// @brief Maximum queued bytes, 0 means unlimited
+      size_t max_bytes{0};
+      /// @brief Action when a limit is reached
+      Policy policy{Policy::DropOldest};
+      /// @brief Longest wait of Policy::Block before the message is
+      ///        dropped, 0 waits until there is room
+      std::chrono::nanoseconds max_wait{0};
+    };
+
+    /// @brief Per topic counters
+    struct TopicStats {
+      uint64_t pushed_msgs{0};
+      uint64_t dropped_msgs{0};
+      uint64_t dropped_bytes{0};
+      uint64_t blocked_ns{0};
+    };
+
+    /// @brief Create a queue
+    /// @param max_bytes Memory ceiling over all topics, 0 means unlimited
+    explicit MessageQueue(size_t max_bytes = 0);
+
+    /// @brief Register a topic, unknown topics get default parameters
+    /// @param name Topic name
+    /// @param params Queue limits
+    void add_topic(const std::string& name, const TopicParams& params);
+
+    /// @brief Queue a message. A topic never evicts messages of other
+    ///        topics, so a fast sensor cannot starve the others. Queued
+    ///        messages of a higher level make room first, the highest level
+    ///        and the oldest of it first, before the policy applies. A
+    ///        message above level 0 refines earlier ones, it is dropped
+    ///        instead of waiting or evicting messages of its level or below
+    /// @param name Topic name
+    /// @param msg Message
+    /// @param level Refinement level, 0 for messages complete on their own
+    /// @return Number of messages dropped to enforce the limits, the new
+    ///         message included
+    size_t push(const std::string& name, MsgConstPtr msg, uint8_t level = 0);
+
+    /// @brief Take the oldest queued message of all topics, never blocks
+    /// @param name Optional output of the topic name
+    /// @param level Optional output of the refinement level
+    /// @return Message or nullptr if the queue is empty
+    MsgConstPtr pop(std::string* name = nullptr, uint8_t* level = nullptr);
+
+    /// @brief Wake up blocked producers, later pushes drop their message
+    void close();
+
+    /// @brief Counters of a topic
+    /// @param name Topic name
+    /// @return TopicStats, zeros for unknown topics
+    TopicStats stats(const std::string& name) const;
+
+    /// @brief Number of queued messages over all topics
+    size_t size() const;
+
+    /// @brief Queued bytes over all topics
+    size_t bytes() const;
+
+  private:
+    struct Entry {
+      // arrival order over all topics
+      uint64_t seq;
+      MsgConstPtr msg;
+      size_t bytes;
+      uint8_t level;
+    };
+
+    struct Topic {
+      std::string name;
+      TopicParams params;
+      std::deque<Entry> queue;
+      size_t bytes{0};
+      TopicStats stats;
+    };
+
+    /// @brief Find or create a topic, holds mtx_
+    Topic& topic(const std::string& name);
+
+    /// @brief Whether n more bytes fit into the topic and the ceiling
+    bool fits(const Topic& t, size_t n) const;
+
+    /// @brief Remove the head of a topic, holds mtx_
+    void drop_head(Topic& t);
+
+    /// @brief Remove the oldest message of the highest level above level,
+    ///        holds mtx_
+    /// @return false if there is none
+    bool drop_refinement(Topic& t, uint8_t level);
+
+    /// @brief Remove a queued message, holds mtx_
+    void drop(Topic& t, std::deque<Entry>::iterator it);
+
+    size_t max_bytes_;
+    size_t bytes_{0};
+    size_t size_{0};
+    uint64_t seq_{0};
+    bool closed_{false};
+    mutable std::mutex mtx_;
+    std::condition_variable room_;
+    // a deque keeps references valid while a producer waits for room
+    std::deque<Topic> topics_;
+    std::unordered_map<std::string, size_t> index_;
+  };
+}  // namespace tskpub
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Pinhole intrinsics of an organized frame, pixel (u, v) looks along
+  ///        ((u - cx) / fx, (v - cy) / fy, 1) in the sensor frame
+  struct Intrinsics {
+    float fx{0}, fy{0}, cx{0}, cy{0};
+
+    bool valid() const { return fx > 0 && fy > 0; }
+  };
+
+  /// @brief Organized lidar frame as a 16 bit range image and an 8 bit
+  ///        intensity image, both row major
+  struct RangeImage {
+    uint16_t width{0};
+    uint16_t height{0};
+    Intrinsics intrinsics;
+    /// @brief Meters per range unit
+    float depth_scale{0.001f};
+    /// @brief Intensity mapped to 255
+    float max_intensity{2000.f};
+    /// @brief Distance to the sensor, 0 means no return
+    std::vector<uint16_t> depth;
+    std::vector<uint8_t> intensity;
+
+    /// @brief Fill the images from an organized cloud
+    /// @tparam PointT point type with x, y, z and intensity members
+    /// @param pts width * height points, NaN for pixels without return
+    template <typename PointT>
+    void from_points(const PointT* pts, uint16_t w, uint16_t h) {
+      width = w;
+      height = h;
+      depth.resize(size_t(w) * h);
+      intensity.resize(size_t(w) * h);
+      const float inv = 1.f / depth_scale;
+      const float iscale = 255.f / max_intensity;
+      for (size_t i = 0; i < depth.size(); i++) {
+        const auto& p = pts[i];
+        float r = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z) * inv + 0.5f;
+        // NaN and out of range pixels fail the comparison
+        bool ok = r >= 1.f && r < 65536.f;
+        depth[i] = ok ? static_cast<uint16_t>(r) : 0;
+        float v = ok ? std::clamp(p.intensity * iscale, 0.f, 255.f) : 0.f;
+        intensity[i] = static_cast<uint8_t>(v + 0.5f);
+      }
+    }
+
+    /// @brief Reproject the pixels with a return
+    /// @tparam PointT point type with x, y, z and intensity members
+    /// @param out buffer with room for width * height points
+    /// @return number of points written
+    template <typename PointT>
+    size_t to_points(PointT* out) const {
+      const auto& k = intrinsics;
+      const float iscale = max_intensity / 255.f;
+      size_t n = 0;
+      for (uint16_t v = 0; v < height; v++) {
+        float dy = (v - k.cy) / k.fy;
+        for (uint16_t u = 0; u < width; u++) {
+          auto i = size_t(v) * width + u;
+          if (!depth[i]) continue;
+          float dx = (u - k.cx) / k.fx;
+          float s = depth[i] * depth_scale / std::sqrt(dx * dx + dy * dy + 1);
+          auto& p = out[n++];
+          p.x = dx * s;
+          p.y = dy * s;
+          p.z = s;
+          p.intensity = intensity[i] * iscale;
+        }
+      }
+      return n;
+    }
+  };
+
+  /// @brief Least squares fit of the intrinsics of an organized cloud in the
+  ///        optical frame (x right, y down, z forward)
+  /// @param pts width * height points, NaN for pixels without return
+  /// @return false if there are not enough points in front of the sensor
+  template <typename PointT>
+  bool fit_intrinsics(const PointT* pts, uint16_t w, uint16_t h,
+                      Intrinsics& out) {
+    // u = fx * x / z + cx and v = fy * y / z + cy
+    double n = 0, sa = 0, saa = 0, su = 0, sau = 0;
+    double sb = 0, sbb = 0, sv = 0, sbv = 0;
+    for (uint16_t v = 0; v < h; v++) {
+      for (uint16_t u = 0; u < w; u++) {
+        const auto& p = pts[size_t(v) * w + u];
+        if (!(p.z > 0) || std::isnan(p.x) || std::isnan(p.y)) continue;
+        double a = p.x / p.z, b = p.y / p.z;
+        n++;
+        sa += a;
+        saa += a * a;
+        su += u;
+        sau += a * u;
+        sb += b;
+        sbb += b * b;
+        sv += v;
+        sbv += b * v;
+      }
+    }
+    double da = n * saa - sa * sa, db = n * sbb - sb * sb;
+    if (n < 16 || da <= 0 || db <= 0) return false;
+    out.fx = (n * sau - sa * su) / da;
+    out.cx = (su - out.fx * sa) / n;
+    out.fy = (n * sbv - sb * sv) / db;
+    out.cy = (sv - out.fy * sb) / n;
+    return out.valid();
+  }
+
+  /// @brief Split 16 bit values into a low byte plane followed by a high byte
+  ///        plane, neighbouring pixels mostly share the high byte which makes
+  ///        the planes compress much better than interleaved bytes
+  void shuffle_depth(const std::vector<uint16_t>& depth, Msg& out);
+
+  /// @brief Inverse of shuffle_depth
+  /// @return false if the size of planes is odd
+  bool unshuffle_depth(const Msg& planes, std::vector<uint16_t>& out);
+}  // namespace tskpub
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace tskpub {
+  /// @brief Side of the blocks compared by block_sad() in pixels
+  constexpr size_t SceneBlock = 8;
+
+  /// @brief Sums of absolute differences of the 8x8 blocks of two images,
+  ///        16 pixels of a row at a time. Partial blocks at the right and
+  ///        bottom edges are left out
+  /// @param a First image, 8 bit
+  /// @param b Second image of the same size
+  /// @param width Width in pixels
+  /// @param height Height in pixels
+  /// @param out Row major sums, (width / 8) * (height / 8) values
+  void block_sad(const uint8_t* a, const uint8_t* b, size_t width,
+                 size_t height, uint32_t* out);
+
+  /// @brief Decides whether a camera frame shows a new scene. The luma of a
+  ///        JPEG frame is decoded at 1/8 scale, which only needs the DC
+  ///        coefficients, and compared block by block with the last frame
+  ///        that passed
+  class SceneGate {
+  public:
+    struct Params {
+      /// @brief Mean absolute luma difference of a changed block, above
+      ///        the sensor noise
+      double block_threshold{10};
+      /// @brief Fraction of changed blocks that makes a new scene
+      double threshold{0.02};
+      /// @brief Longest time between frames that pass in seconds, 0 only
+      ///        passes new scenes
+      double keepalive{1};
+    };
+
+    explicit SceneGate(const Params& params);
+    ~SceneGate();
+
+    /// @brief Check a frame, a frame that passes is the new reference.
+    ///        Frames that cannot be decoded pass
+    /// @param jpeg JPEG data
+    /// @param size Size of the data
+    /// @param stamp Capture time in nanoseconds
+    /// @return true if the frame should be published
+    bool check(const uint8_t* jpeg, size_t size, uint64_t stamp);
+
+    /// @brief Fraction of changed blocks in the last checked frame
+    double change() const;
+
+    /// @brief Forget the reference, the next frame passes
+    void reset();
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+  };
+}  // namespace tskpub
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Token bucket measured in bytes
+  struct TokenBucket {
+    /// @brief Refill rate in bytes per second, 0 means unlimited
+    double rate{0};
+    /// @brief Bucket depth in bytes
+    double burst{0};
+    /// @brief Tokens currently in the bucket, may go negative after sending
+    ///        a message larger than the burst size
+    double tokens{0};
+    /// @brief Last refill time in nanoseconds
+    uint64_t last{0};
+
+    TokenBucket() = default;
+    TokenBucket(double rate, double burst);
+
+    /// @brief Add tokens accumulated since the last refill
+    /// @param now Current time in nanoseconds
+    void refill(uint64_t now);
+
+    /// @brief Check if a message of n bytes may pass now.
+    ///        Messages larger than the burst size pass once the bucket is full
+    /// @param n Message size in bytes
+    /// @return true if the message conforms
+    bool conform(size_t n) const;
+
+    /// @brief Take n bytes worth of tokens out of the bucket
+    /// @param n Message size in bytes
+    void consume(size_t n);
+
+    /// @brief Time until a message of n bytes conforms
+    /// @param n Message size in bytes
+    /// @return Nanoseconds to wait, 0 if it conforms already
+    uint64_t wait_time(size_t n) const;
+  };
+
+  /// @brief Traffic shaper in front of the publishing socket.
+  ///        Every topic has its own queue, so a small message never waits
+  ///        behind a large one of another topic. Topics are served by
+  ///        strict priority, topics of the same priority share the link by
+  ///        weight (start-time fair queueing). Both the link and every topic
+  ///        are limited by token buckets.
+  ///        Not thread safe, all calls come from the publisher thread
+  class Shaper {
+  public:
+    /// @brief What to do with a message that exceeds its topic budget
+    enum class Policy {
+      /// @brief Discard it on arrival
+      Drop,
+      /// @brief Keep it in the topic queue until the budget allows
+      Delay,
+    };
+
+    /// @brief Per topic shaping parameters
+    struct TopicParams {
+      /// @brief Higher priorities are always served first
+      int priority{0};
+      /// @brief Share of the link among topics with the same priority
+      double weight{1.0};
+      /// @brief Topic rate limit in bytes per second, 0 means unlimited
+      double rate{0};
+      /// @brief Topic bucket depth in bytes
+      double burst{0};
+      /// @brief Action when the topic budget is exceeded
+      Policy policy{Policy::Delay};
+      /// @brief Maximum queued messages, the oldest one is dropped beyond it
+      size_t queue_size{8};
+    };
+
+    /// @brief Per topic counters
+    struct TopicStats {
+      uint64_t sent_msgs{0};
+      uint64_t sent_bytes{0};
+      uint64_t dropped_msgs{0};
+      uint64_t dropped_bytes{0};
+    };
+
+    /// @brief Create a shaper
+    /// @param rate Total uplink rate in bytes per second, 0 means unlimited
+    /// @param burst Link bucket depth in bytes
+    Shaper(double rate, double burst);
+
+    /// @brief Register a topic, unknown topics get default parameters
+    /// @param name Topic name
+    /// @param params Shaping parameters
+    void add_topic(const std::string& name, const TopicParams& params);
+
+    /// @brief Queue a message for sending. A full topic queue drops the
+    ///        oldest message of the highest refinement level
+    /// @param name Topic name
+    /// @param msg Message
+    /// @param now Current time in nanoseconds
+    /// @param level Refinement level, 0 for messages complete on their own
+    /// @return false if the message was dropped
+    bool push(const std::string& name, MsgConstPtr msg, uint64_t now,
+              uint8_t level = 0);
+
+    /// @brief Take the next message allowed on the link
+    /// @param now Current time in nanoseconds
+    /// @param name Optional output of the topic name
+    /// @return Message or nullptr if nothing may be sent now
+    MsgConstPtr pop(uint64_t now, std::string* name = nullptr);
+
+    /// @brief Time until pop() may return the next message. Follows the
+    ///        choice of pop(), a level waiting for the link is not
+    ///        overtaken by a small message of a lower level
+    /// @param now Current time in nanoseconds
+    /// @return Nanoseconds to wait, UINT64_MAX if all queues are empty
+    uint64_t next_ready(uint64_t now);
+
+    /// @brief Counters of a topic
+    /// @param name Topic name
+    /// @return TopicStats, zeros for unknown topics
+    TopicStats stats(const std::string& name) const;
+
+    /// @brief Number of queued messages over all topics
+    size_t queued() const;
+
+  private:
+    struct Entry {
+      MsgConstPtr msg;
+      uint8_t level;
+    };
+
+    struct Topic {
+      std::string name;
+      TopicParams params;
+      TokenBucket bucket;
+      std::deque<Entry> queue;
+      // virtual start time of the head message
+      double vtime{0};
+      TopicStats stats;
+    };
+
+    /// @brief Find or create a topic
+    Topic& topic(const std::string& name);
+
+    /// @brief Refill every bucket
+    void refill(uint64_t now);
+
+    /// @brief Pick the topic a priority level sends next
+    /// @param begin First topic of the level
+    /// @param end Output, one past the last topic of the level
+    /// @return Topic with the smallest virtual time among those within
+    ///         their own budget, nullptr if there is none
+    Topic* select(size_t begin, size_t& end);
+
+    /// @brief Whether the head of a non-empty topic is within its budget
+    bool eligible(const Topic& t) const;
+
+    TokenBucket link_;
+    // topics sorted by priority (descending), stable in registration order
+    std::vector<Topic> topics_;
+    std::unordered_map<std::string, size_t> index_;
+    // virtual time of each priority level
+    std::unordered_map<int, double> level_vtime_;
+  };
+}  // namespace tskpub
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace tskpub {
+  namespace simd {
+    // GCC/Clang vector extensions, lowered to SSE on x86 and NEON on arm
+    typedef float f32x4 __attribute__((vector_size(16)));
+    typedef int32_t i32x4 __attribute__((vector_size(16)));
+    typedef uint8_t u8x16 __attribute__((vector_size(16)));
+    typedef uint16_t u16x16 __attribute__((vector_size(32)));
+
+    inline f32x4 load(const void* p) {
+      f32x4 v;
+      std::memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    inline void store(void* p, const f32x4& v) {
+      std::memcpy(p, &v, sizeof(v));
+    }
+
+    inline f32x4 splat(float v) { return f32x4{v, v, v, v}; }
+
+    inline u8x16 load_u8(const void* p) {
+      u8x16 v;
+      std::memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    /// @brief |a - b| per lane without overflow
+    inline u8x16 absdiff(const u8x16& a, const u8x16& b) {
+      auto gt = reinterpret_cast<u8x16>(a > b);
+      return ((a - b) & gt) | ((b - a) & ~gt);
+    }
+  }  // namespace simd
+}  // namespace tskpub
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <zmq.hpp>
+
+#include <string>
+
+#include "TSKPub/frame.hh"
+#include "TSKPub/tskpub.hh"
+
+namespace tskpub {
+  /// @brief Default number of messages ZMQ keeps per subscriber
+  constexpr int SendHighWater = 64;
+
+  /// @brief Set up the XPUB socket messages are published on.
+  ///        Every message handed to the socket is kept: the shaper already
+  ///        decided what to drop or delay, and the topic dictionary, octree
+  ///        diffs and Gorilla samples need the messages before them. The
+  ///        high water mark only bounds the memory of a slow subscriber.
+  ///        Every subscribe and unsubscribe is passed up, see
+  ///        SubscriptionTracker
+  /// @param socket XPUB socket, before bind or connect
+  /// @param sndhwm Messages kept per subscriber
+  inline void setup_publisher(zmq::socket_t& socket,
+                              int sndhwm = SendHighWater) {
+    socket.set(zmq::sockopt::sndhwm, sndhwm);
+    socket.set(zmq::sockopt::xpub_verbose, 1);
+    socket.set(zmq::sockopt::xpub_verboser, 1);
+  }
+
+  /// @brief Publish a message. A framed message goes out as the topic frame
+  ///        followed by the message, so the message is never copied to put
+  ///        the topic in front; a legacy message starts with its sensor name
+  /// @param socket Publisher socket
+  /// @param topic Sensor name of the message
+  /// @param msg [FrameHeader][body] if framed, [name][body] otherwise
+  /// @param framed Whether the config selects framing: header
+  inline void send_message(zmq::socket_t& socket, const std::string& topic,
+                           const Msg& msg, bool framed) {
+    if (framed) {
+      socket.send(zmq::buffer(topic_frame(topic)), zmq::send_flags::sndmore);
+    }
+    socket.send(zmq::buffer(msg), zmq::send_flags::none);
+  }
+}  // namespace tskpub
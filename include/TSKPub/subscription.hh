@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Track which topics have subscribers from the messages received
+  ///        on a ZMQ XPUB socket.
+  ///        A message is [1 | 0][prefix] for subscribe and unsubscribe, a
+  ///        topic is wanted while any subscribed prefix matches it. The socket
+  ///        should have xpub_verbose and xpub_verboser set so that every
+  ///        subscriber is counted
+  class SubscriptionTracker {
+  public:
+    /// @brief Called when a topic gains its first or loses its last subscriber
+    using Callback = std::function<void(const std::string& topic, bool wanted)>;
+
+    /// @param topics Published topics, messages start with the topic
+    /// @param callback Called on every change
+    SubscriptionTracker(std::vector<std::string> topics, Callback callback);
+
+    /// @brief Feed a message received on the XPUB socket
+    /// @param data Message
+    /// @param size Message size
+    /// @return false if the message is not a subscription message
+    bool update(const uint8_t* data, size_t size);
+
+    /// @brief Whether a topic has subscribers
+    bool wanted(const std::string& topic) const;
+
+    /// @brief Number of subscriptions per prefix
+    const std::map<std::string, int>& subscriptions() const {
+      return subscriptions_;
+    }
+
+  private:
+    std::vector<std::string> topics_;
+    std::vector<bool> wanted_;
+    std::map<std::string, int> subscriptions_;
+    Callback callback_;
+  };
+}  // namespace tskpub
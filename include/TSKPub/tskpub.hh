@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace tskpub {
@@ -8,14 +13,136 @@ namespace tskpub {
   using MsgPtr = std::shared_ptr<Msg>;
   using MsgConstPtr = std::shared_ptr<const Msg>;
 
+  /// @brief Pipeline stages where messages of a sensor can be discarded.
+  ///        Every stage after Decode leaves a gap in the sequence numbers
+  enum class DropStage : uint8_t {
+    /// @brief Corrupted device data, dropped before it became a message
+    Decode,
+    /// @brief Captured data replaced by newer data before it was read
+    Overwrite,
+    /// @brief Captured data the reader failed to package
+    Read,
+    /// @brief Queue from the reading thread to the publisher was full
+    Queue,
+    /// @brief Dropped by the traffic shaper
+    Shaper,
+    /// @brief Number of stages
+    Count,
+  };
+
+  /// @brief Resolved sensor name, valid for the TSKPub object that returned
+  ///        it. Reading through a handle skips the name lookup
+  class SensorHandle {
+  public:
+    SensorHandle() = default;
+
+    /// @brief Whether the sensor was found
+    bool valid() const { return index_ != npos; }
+
+    /// @brief Position of the sensor in the configuration file
+    size_t index() const { return index_; }
+
+  private:
+    friend class TSKPub;
+    static constexpr size_t npos = SIZE_MAX;
+    explicit SensorHandle(size_t index) : index_(index) {}
+    size_t index_{npos};
+  };
+
   class TSKPub {
   public:
+    /// @brief Create the readers and open all devices concurrently in the
+    ///        background, use wait_ready() to wait for the first data. A
+    ///        device that fails to open is logged, recorded as its "failed"
+    ///        startup phase and reported by failed(), it is not retried.
+    ///        Objects alive at the same time share the config and the
+    ///        logger of the first one, config_file of the others is ignored
     TSKPub(const std::string& config_file);
     ~TSKPub();
 
+    /// @brief Wait until every sensor that is not paused delivered its
+    ///        first data
+    /// @param timeout Maximum time to wait
+    /// @return false on timeout, the missing sensors are logged at debug
+    ///         level
+    bool wait_ready(std::chrono::milliseconds timeout) const;
+
+    /// @brief Whether a sensor delivered its first data
+    /// @param sensor_name Sensor name in configuration file
+    bool ready(const std::string& sensor_name) const;
+
+    /// @brief Whether opening the device of a sensor failed
+    /// @param sensor_name Sensor name in configuration file
+    bool failed(const std::string& sensor_name) const;
+
+    /// @brief Whether opening the device of a sensor failed
+    /// @param handle Handle from handle()
+    bool failed(SensorHandle handle) const;
+
+    /// @brief Resolve a sensor name once for read(SensorHandle)
+    /// @param sensor_name Sensor name in configuration file
+    /// @return Invalid handle if the sensor is unknown
+    SensorHandle handle(const std::string& sensor_name) const;
+
     /// @brief Read data from a sensor with a given name
     /// @param sensor_name Sensor name in configuration file
     /// @return Byte vector
     MsgConstPtr read(const std::string& sensor_name) const;
+
+    /// @brief Read data from a sensor, for the hot path of reading threads
+    /// @param handle Handle from handle()
+    /// @return Byte vector, nullptr until the device is open and for a
+    ///         failed one
+    MsgConstPtr read(SensorHandle handle) const;
+
+    /// @brief Take the messages that refine the one last read from a
+    ///        sensor, e.g. the finer level of detail layers of a point
+    ///        cloud. The i-th one has refinement level i + 1, queue them
+    ///        after the message so that they are dropped first
+    /// @param handle Handle from handle()
+    /// @return Messages, empty for sensors that send whole messages
+    std::vector<MsgConstPtr> refinements(SensorHandle handle) const;
+
+    /// @brief Stop capturing from a sensor, read() returns nullptr until
+    ///        resume() is called
+    /// @param sensor_name Sensor name in configuration file
+    void pause(const std::string& sensor_name);
+
+    /// @brief Start capturing from a paused sensor
+    /// @param sensor_name Sensor name in configuration file
+    void resume(const std::string& sensor_name);
+
+    /// @brief Whether a sensor is paused
+    /// @param sensor_name Sensor name in configuration file
+    bool paused(const std::string& sensor_name) const;
+
+    /// @brief Whether a sensor is paused
+    /// @param handle Handle from handle()
+    bool paused(SensorHandle handle) const;
+
+    /// @brief Count messages discarded after read(), the counters are
+    ///        published in the status message
+    /// @param handle Handle from handle(), invalid handles are ignored
+    /// @param stage Stage that discarded the messages
+    /// @param n Number of messages
+    void drop(SensorHandle handle, DropStage stage, uint64_t n = 1) const;
+
+    /// @brief Topic id dictionary of the framed messages. Publish it
+    ///        periodically so that subscribers can map the topic ids of the
+    ///        frame headers to topics and schemas
+    /// @return [FrameHeader][packed TopicDictionary]
+    MsgConstPtr dictionary() const;
+
+    /// @brief Change parameters of a running sensor without reopening it.
+    ///        Either all parameters are applied or none
+    /// @param sensor_name Sensor name in configuration file
+    /// @param params Parameter name as in the config file -> value
+    /// @return false if the sensor or a parameter is unknown
+    bool set_params(const std::string& sensor_name,
+                    const std::unordered_map<std::string, double>& params);
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
   };
 }  // namespace tskpub
\ No newline at end of file
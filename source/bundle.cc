@@ -0,0 +1,100 @@
+#include "TSKPub/bundle.hh"
+
+#include <TSKPub/msg/SensorBundle.capnp.h>
+#include <capnp/serialize-packed.h>
+
+#include <algorithm>
+
+namespace {
+  // camera frames to choose from, a few periods of a fast camera
+  constexpr size_t MaxCameras = 8;
+  // IMU samples between two lidar frames, 2.5 s at 400 Hz
+  constexpr size_t MaxImus = 1024;
+}  // namespace
+
+namespace tskpub {
+  Bundler::Bundler(const Params& params)
+      : params_(params), max_delay_(uint64_t(params.max_delay * 1e9)) {}
+
+  MsgConstPtr Bundler::add(const std::string& sensor, const Msg& msg) {
+    FrameHeader hdr;
+    if (!hdr.decode(msg.data(), msg.size())) return nullptr;
+    Ref ref{hdr.topic_id, hdr.seq, hdr.stamp, hdr.schema};
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    MsgConstPtr ret{nullptr};
+    if (sensor == params_.lidar) {
+      // the previous frame waited in vain
+      if (lidar_) ret = emit();
+      lidar_ = ref;
+    } else if (sensor == params_.camera) {
+      cameras_.push_back(ref);
+      if (cameras_.size() > MaxCameras) cameras_.pop_front();
+      camera_stamp_ = std::max(camera_stamp_, ref.stamp);
+    } else if (sensor == params_.imu) {
+      imus_.push_back(ref);
+      if (imus_.size() > MaxImus) imus_.pop_front();
+      imu_stamp_ = std::max(imu_stamp_, ref.stamp);
+    } else {
+      return nullptr;
+    }
+    newest_ = std::max(newest_, ref.stamp);
+    if (ret || !lidar_) return ret;
+
+    // the camera and the IMU have passed the lidar frame, or gave up
+    auto t = lidar_->stamp;
+    bool done = (params_.camera.empty() || camera_stamp_ >= t)
+                && (params_.imu.empty() || imu_stamp_ >= t);
+    if (done || newest_ > t + max_delay_) return emit();
+    return nullptr;
+  }
+
+  MsgConstPtr Bundler::emit() {
+    auto lidar = *lidar_;
+    lidar_.reset();
+    auto t = lidar.stamp;
+
+    capnp::MallocMessageBuilder builder{256};
+    auto bundle = builder.initRoot<SensorBundle>();
+    bundle.setTimestamp(t);
+    bundle.setStartTime(start_);
+    auto set = [](SensorBundle::Part::Builder part, const Ref& ref) {
+      part.setTopicId(ref.topic_id);
+      part.setSeq(ref.seq);
+      part.setTimestamp(ref.stamp);
+      part.setSchema(static_cast<uint8_t>(ref.schema));
+    };
+    set(bundle.initLidar(), lidar);
+
+    auto dist = [t](const Ref& r) {
+      return r.stamp > t ? r.stamp - t : t - r.stamp;
+    };
+    auto camera = std::min_element(
+        cameras_.begin(), cameras_.end(),
+        [&](const Ref& a, const Ref& b) { return dist(a) < dist(b); });
+    if (camera != cameras_.end()) set(bundle.initCamera(), *camera);
+
+    // samples after t belong to the next bundle
+    auto end = std::find_if(imus_.begin(), imus_.end(),
+                            [t](const Ref& r) { return r.stamp > t; });
+    auto begin = std::find_if(
+        imus_.begin(), end, [this](const Ref& r) { return r.stamp > start_; });
+    auto imu = bundle.initImu(end - begin);
+    for (unsigned i = 0; begin + i != end; i++) set(imu[i], begin[i]);
+    imus_.erase(imus_.begin(), end);
+    start_ = t;
+
+    FrameHeader hdr;
+    hdr.schema = Schema::SensorBundle;
+    hdr.topic_id = FrameHeader::BundleId;
+    hdr.seq = seq_++;
+    hdr.stamp = t;
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    auto body = out.getArray();
+    auto ret = std::make_shared<Msg>(FrameHeader::Size + body.size());
+    hdr.encode(ret->data());
+    std::copy(body.begin(), body.end(), ret->begin() + FrameHeader::Size);
+    return ret;
+  }
+}  // namespace tskpub
@@ -0,0 +1,170 @@
+#include "TSKPub/clock.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include "common.hh"
+
+namespace {
+  // the offset is measured again after this many nanoseconds
+  constexpr uint64_t Remeasure = 100000000;
+
+  uint64_t system_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// @brief System time minus monotonic time, both read back to back
+  int64_t measure(uint64_t& mono) {
+    mono = tskpub::Clock::mono_now();
+    return int64_t(system_now()) - int64_t(mono);
+  }
+
+  /// @brief Offset shared by all readers
+  struct Shared {
+    std::mutex mtx;
+    tskpub::OffsetFilter filter{{}};
+    std::atomic<int64_t> offset{0};
+    std::atomic<uint64_t> next{0};
+
+    Shared() {
+      uint64_t mono;
+      auto measured = measure(mono);
+      filter.update(mono, measured);
+      offset = filter.offset();
+      next = mono + Remeasure;
+    }
+
+    /// @brief Offset at mono, measured again by the first caller after
+    ///        Remeasure while the others keep the previous one
+    int64_t at(uint64_t mono) {
+      if (mono >= next.load(std::memory_order_relaxed)) {
+        std::unique_lock<std::mutex> lock(mtx, std::try_to_lock);
+        if (lock && mono >= next.load(std::memory_order_relaxed)) {
+          uint64_t now;
+          auto measured = measure(now);
+          if (filter.update(now, measured)) {
+            tskpub::Log::warn("System clock stepped by "
+                              + std::to_string(measured - offset.load())
+                              + " ns");
+          }
+          offset.store(filter.offset(), std::memory_order_relaxed);
+          next.store(now + Remeasure, std::memory_order_relaxed);
+        }
+      }
+      return offset.load(std::memory_order_relaxed);
+    }
+  };
+
+  Shared& shared() {
+    static Shared s;
+    return s;
+  }
+}  // namespace
+
+namespace tskpub {
+  uint64_t Clock::mono_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  uint64_t Clock::to_wall(uint64_t mono) {
+    return mono + shared().at(mono);
+  }
+
+  uint64_t Clock::from_system(uint64_t system) {
+    uint64_t mono;
+    auto raw = measure(mono);
+    return to_wall(system - raw);
+  }
+
+  uint64_t Clock::now() { return to_wall(mono_now()); }
+
+  bool OffsetFilter::update(uint64_t mono, int64_t measured) {
+    auto dt = mono > last_ ? mono - last_ : 0;
+    last_ = mono;
+    if (!init_) {
+      init_ = true;
+      offset_ = measured;
+      return false;
+    }
+    auto err = measured - offset_;
+    if (uint64_t(std::abs(err)) > params_.step) {
+      offset_ = measured;
+      return true;
+    }
+    auto limit = int64_t(params_.slew * dt);
+    offset_ += std::clamp(err, -limit, limit);
+    return false;
+  }
+
+  StampFilter::StampFilter(const Params& params)
+      : params_(params), points_(std::max<size_t>(params.window, 2)) {}
+
+  void StampFilter::reset() {
+    count_ = 0;
+    rate_ = 0;
+  }
+
+  uint64_t StampFilter::update(uint64_t arrival, uint64_t sensor) {
+    if (count_) {
+      const auto& prev = points_[(head_ + count_ - 1) % points_.size()];
+      if (sensor <= prev.sensor || arrival < prev.arrival
+          || arrival - prev.arrival > params_.max_gap) {
+        reset();
+      }
+    }
+    if (count_ == points_.size()) {
+      head_ = (head_ + 1) % points_.size();
+      count_--;
+    }
+    points_[(head_ + count_++) % points_.size()] = {sensor, arrival};
+
+    uint64_t est = arrival;
+    if (count_ >= std::max<size_t>(params_.warmup, 2)) {
+      // relative to the oldest sample, the sums stay small
+      const auto& p0 = points_[head_];
+      double mx = 0, my = 0;
+      for (size_t i = 0; i < count_; i++) {
+        const auto& p = points_[(head_ + i) % points_.size()];
+        mx += double(p.sensor - p0.sensor);
+        my += double(p.arrival - p0.arrival);
+      }
+      mx /= count_;
+      my /= count_;
+      double sxx = 0, sxy = 0;
+      for (size_t i = 0; i < count_; i++) {
+        const auto& p = points_[(head_ + i) % points_.size()];
+        double x = double(p.sensor - p0.sensor) - mx;
+        sxy += x * (double(p.arrival - p0.arrival) - my);
+        sxx += x * x;
+      }
+      rate_ = sxy / sxx;
+      // the least delayed of the earlier samples
+      double low = std::numeric_limits<double>::max();
+      for (size_t i = 0; i + 1 < count_; i++) {
+        const auto& p = points_[(head_ + i) % points_.size()];
+        low = std::min(low, double(p.arrival - p0.arrival)
+                                - rate_ * double(p.sensor - p0.sensor));
+      }
+      auto fit = low + rate_ * double(sensor - p0.sensor);
+      auto delay = double(arrival - p0.arrival) - fit;
+      if (std::abs(delay) > params_.max_delay) {
+        // the sensor clock jumped or does not match the arrivals
+        reset();
+        points_[(head_ + count_++) % points_.size()] = {sensor, arrival};
+      } else if (delay > 0) {
+        est = arrival - uint64_t(delay);
+      }
+    }
+    if (est < last_ && last_ <= arrival) est = last_;
+    last_ = est;
+    return est;
+  }
+}  // namespace tskpub
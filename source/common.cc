@@ -7,12 +7,10 @@
 #include <fstream>
 #include <string>
 
+#include "TSKPub/clock.hh"
+
 namespace tskpub {
-  uint64_t nano_now() {
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(
-               std::chrono::system_clock::now().time_since_epoch())
-        .count();
-  }
+  uint64_t nano_now() { return Clock::now(); }
 
   std::shared_ptr<spdlog::logger> Log::logger_ = nullptr;
 
@@ -43,6 +41,66 @@ namespace tskpub {
     logger_ = nullptr;
   }
 
+  std::mutex Startup::mtx_;
+  std::chrono::steady_clock::time_point Startup::start_
+      = std::chrono::steady_clock::now();
+  std::vector<Startup::Phase> Startup::phases_;
+
+  void Startup::reset() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    start_ = std::chrono::steady_clock::now();
+    phases_.clear();
+  }
+
+  double Startup::record(const std::string& sensor, const std::string& phase) {
+    double ms;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      ms = std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start_)
+               .count();
+      phases_.push_back({sensor, phase, ms});
+    }
+    Log::info(sensor + " " + phase + " after " + std::to_string(ms) + " ms");
+    return ms;
+  }
+
+  std::vector<Startup::Phase> Startup::phases() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return phases_;
+  }
+
+  std::mutex ReadStats::mtx_;
+  std::map<std::string, ReadCounter> ReadStats::counters_;
+
+  ReadCounter& ReadStats::counter(const std::string& sensor) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return counters_[sensor];
+  }
+
+  uint64_t ReadStats::take_total() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    uint64_t total = 0;
+    for (auto& [sensor, c] : counters_) {
+      total += c.bytes.exchange(0, std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  std::vector<LossReport> ReadStats::losses() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    std::vector<LossReport> ret;
+    ret.reserve(counters_.size());
+    for (auto& [sensor, c] : counters_) {
+      LossReport r{sensor, c.seq.load(std::memory_order_relaxed), {}};
+      for (size_t i = 0; i < r.dropped.size(); i++) {
+        r.dropped[i] = c.dropped[i].load(std::memory_order_relaxed);
+      }
+      ret.push_back(std::move(r));
+    }
+    return ret;
+  }
+
   GlobalParams::GlobalParams() {}
   GlobalParams::~GlobalParams() {}
 
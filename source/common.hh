@@ -2,13 +2,19 @@
 
 #include <spdlog/spdlog.h>
 
+#include <array>
+#include <chrono>
 #include <fkYAML/node.hpp>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "TSKPub/tskpub.hh"
 
 namespace tskpub {
-  /// @brief Get current time in nanoseconds
+  /// @brief Get current time in nanoseconds, wall time of the monotonic
+  ///        clock, see Clock
   /// @return
   uint64_t nano_now();
 
@@ -49,6 +55,75 @@ namespace tskpub {
     static std::shared_ptr<spdlog::logger> logger_;
   };
 
+  /// @brief Startup phases of the sensors, logged and published by the
+  ///        status reader so that slow cold starts can be traced
+  class Startup {
+  public:
+    struct Phase {
+      std::string sensor;
+      std::string phase;
+      // time since reset() in ms
+      double ms;
+    };
+
+    /// @brief Clear the phases and restart the clock
+    static void reset();
+
+    /// @brief Record and log a phase
+    /// @param sensor Sensor name
+    /// @param phase Phase name
+    /// @return time since reset() in ms
+    static double record(const std::string& sensor, const std::string& phase);
+
+    /// @brief Copy of all recorded phases
+    static std::vector<Phase> phases();
+
+  private:
+    Startup() = delete;
+    static std::mutex mtx_;
+    static std::chrono::steady_clock::time_point start_;
+    static std::vector<Phase> phases_;
+  };
+
+  /// @brief Counters of one sensor. Sensors are read from different
+  ///        threads, the padding keeps every counter on its own cache line
+  struct alignas(64) ReadCounter {
+    /// @brief Bytes read since the last ReadStats::take_total()
+    std::atomic<uint64_t> bytes{0};
+    /// @brief Next sequence number, taken when a message is captured
+    std::atomic<uint32_t> seq{0};
+    /// @brief Capture time in nanoseconds of the last packed message
+    std::atomic<uint64_t> stamp{0};
+    /// @brief Discarded messages per DropStage, never reset
+    std::array<std::atomic<uint64_t>, size_t(DropStage::Count)> dropped{};
+  };
+
+  /// @brief Sequence number and drop counters of a sensor
+  struct LossReport {
+    std::string sensor;
+    uint32_t seq;
+    std::array<uint64_t, size_t(DropStage::Count)> dropped;
+  };
+
+  /// @brief Per-sensor read counters, summed only when the status is read
+  class ReadStats {
+  public:
+    /// @brief Counter of a sensor, created on first use and never removed
+    /// @param sensor Sensor name
+    static ReadCounter& counter(const std::string& sensor);
+
+    /// @brief Sum of all counters since the last call, resets them
+    static uint64_t take_total();
+
+    /// @brief Sequence numbers and drop counters of all sensors
+    static std::vector<LossReport> losses();
+
+  private:
+    ReadStats() = delete;
+    static std::mutex mtx_;
+    static std::map<std::string, ReadCounter> counters_;
+  };
+
   /// @brief Global parameters
   class GlobalParams {
   public:
@@ -66,9 +141,6 @@ namespace tskpub {
     /// @brief YAML node
     fkyaml::node yml;
 
-    /// @brief Total read bytes
-    std::atomic<uint64_t> total_read_bytes;
-
   private:
     GlobalParams();
     ~GlobalParams();
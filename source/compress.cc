@@ -0,0 +1,287 @@
+#include "TSKPub/compress.hh"
+
+#include <lz4.h>
+#include <lz4hc.h>
+#include <zdict.h>
+#include <zstd.h>
+
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "common.hh"
+
+namespace {
+  using tskpub::Compression;
+  using tskpub::Compressor;
+  using tskpub::CompressParams;
+
+  class LZ4Compressor final : public Compressor {
+  public:
+    LZ4Compressor(const CompressParams& params) : level_(params.level) {
+      if (!params.dict.empty()) {
+        tskpub::Log::warn("lz4 does not support dictionaries, ignored");
+      }
+    }
+
+    Compression algo() const override { return Compression::LZ4; }
+
+    size_t bound(size_t n) const override { return LZ4_compressBound(n); }
+
+    size_t compress(const uint8_t* src, size_t n, uint8_t* dst) override {
+      auto s = reinterpret_cast<const char*>(src);
+      auto d = reinterpret_cast<char*>(dst);
+      int cap = bound(n);
+      // level > 0 selects lz4hc, otherwise -level is the acceleration
+      int ret = level_ > 0 ? LZ4_compress_HC(s, d, n, cap, level_)
+                           : LZ4_compress_fast(s, d, n, cap, 1 - level_);
+      return ret > 0 ? ret : 0;
+    }
+
+  private:
+    int level_;
+  };
+
+  class ZstdCompressor final : public Compressor {
+  public:
+    ZstdCompressor(const CompressParams& params)
+        : cctx_(ZSTD_createCCtx(), ZSTD_freeCCtx),
+          cdict_(nullptr, ZSTD_freeCDict),
+          level_(params.level) {
+      if (!params.dict.empty()) {
+        cdict_.reset(ZSTD_createCDict(params.dict.data(), params.dict.size(),
+                                      level_));
+        if (!cdict_) throw std::runtime_error("Invalid zstd dictionary");
+        dict_id_ = params.dict_id;
+      }
+    }
+
+    Compression algo() const override { return Compression::Zstd; }
+
+    size_t bound(size_t n) const override { return ZSTD_compressBound(n); }
+
+    size_t compress(const uint8_t* src, size_t n, uint8_t* dst) override {
+      auto ret = cdict_ ? ZSTD_compress_usingCDict(cctx_.get(), dst, bound(n),
+                                                   src, n, cdict_.get())
+                        : ZSTD_compressCCtx(cctx_.get(), dst, bound(n), src,
+                                            n, level_);
+      return ZSTD_isError(ret) ? 0 : ret;
+    }
+
+  private:
+    // contexts are reused between messages to avoid reallocation
+    std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx_;
+    std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)> cdict_;
+    int level_;
+  };
+
+  const bool lz4_registed = tskpub::CompressorFactory::regist(
+      "lz4", [](const CompressParams& p) {
+        return std::make_shared<LZ4Compressor>(p);
+      });
+  const bool zstd_registed = tskpub::CompressorFactory::regist(
+      "zstd", [](const CompressParams& p) {
+        return std::make_shared<ZstdCompressor>(p);
+      });
+
+  /// @brief Dictionaries known to the decoder
+  struct Dictionaries {
+    std::mutex mtx;
+    std::unordered_map<uint8_t, std::shared_ptr<ZSTD_DDict>> ddicts;
+
+    static Dictionaries& get_instance() {
+      static Dictionaries instance;
+      return instance;
+    }
+
+    std::shared_ptr<ZSTD_DDict> find(uint8_t id) {
+      std::lock_guard<std::mutex> lock(mtx);
+      auto it = ddicts.find(id);
+      return it == ddicts.end() ? nullptr : it->second;
+    }
+  };
+}  // namespace
+
+namespace tskpub {
+  // ******************
+  // * CompressHeader *
+  // ******************
+  size_t CompressHeader::encode(uint8_t* dst) const {
+    size_t n = 0;
+    dst[n++] = Magic | static_cast<uint8_t>(algo);
+    dst[n++] = dict_id;
+    auto v = raw_size;
+    do {
+      uint8_t b = v & 0x7f;
+      v >>= 7;
+      dst[n++] = b | (v ? 0x80 : 0);
+    } while (v);
+    return n;
+  }
+
+  size_t CompressHeader::decode(const uint8_t* src, size_t size) {
+    if (size < 3 || (src[0] & 0xf0) != Magic) return 0;
+    algo = static_cast<Compression>(src[0] & 0x0f);
+    dict_id = src[1];
+    raw_size = 0;
+    for (size_t i = 2, shift = 0; i < size && i < MaxSize; i++, shift += 7) {
+      raw_size |= static_cast<uint64_t>(src[i] & 0x7f) << shift;
+      if (!(src[i] & 0x80)) return i + 1;
+    }
+    return 0;
+  }
+
+  // *********************
+  // * CompressorFactory *
+  // *********************
+  Compressor::Ptr CompressorFactory::create(const CompressParams& params) {
+    const auto& map = creaters();
+    auto it = map.find(params.algo);
+    if (it == map.end()) {
+      Log::critical("No compressor for algorithm: " + params.algo);
+      return nullptr;
+    }
+    return it->second(params);
+  }
+
+  bool CompressorFactory::regist(std::string algo, Creator creator) {
+    auto& map = creaters();
+    if (map.find(algo) != map.end()) {
+      Log::critical("Compressor for algorithm: " + algo + " already exists");
+      return false;
+    }
+    map[algo] = creator;
+    return true;
+  }
+
+  std::unordered_map<std::string, CompressorFactory::Creator>&
+  CompressorFactory::creaters() {
+    static std::unordered_map<std::string, Creator> creaters;
+    return creaters;
+  }
+
+  // *************
+  // * functions *
+  // *************
+  MsgPtr compress(Compressor& c, const uint8_t* src, size_t n,
+                  const std::string& prefix) {
+    auto ret = std::make_shared<Msg>(prefix.size() + CompressHeader::MaxSize
+                                     + std::max(c.bound(n), n));
+    std::copy(prefix.begin(), prefix.end(), ret->begin());
+
+    CompressHeader hdr;
+    hdr.raw_size = n;
+    hdr.algo = c.algo();
+    hdr.dict_id = c.dict_id();
+    auto body = ret->data() + prefix.size();
+    auto hsz = hdr.encode(body);
+    auto csz = c.compress(src, n, body + hsz);
+
+    // store the raw body if compression failed or did not pay off
+    if (csz == 0 || csz >= n) {
+      hdr.algo = Compression::None;
+      hdr.dict_id = 0;
+      hsz = hdr.encode(body);
+      std::memcpy(body + hsz, src, n);
+      csz = n;
+    }
+    ret->resize(prefix.size() + hsz + csz);
+    return ret;
+  }
+
+  void add_dictionary(uint8_t id, const Msg& dict) {
+    std::shared_ptr<ZSTD_DDict> ddict(
+        ZSTD_createDDict(dict.data(), dict.size()), ZSTD_freeDDict);
+    if (!ddict) throw std::runtime_error("Invalid zstd dictionary");
+    auto& dicts = Dictionaries::get_instance();
+    std::lock_guard<std::mutex> lock(dicts.mtx);
+    dicts.ddicts[id] = ddict;
+  }
+
+  Msg decompress(const uint8_t* src, size_t n, uint64_t max_size) {
+    CompressHeader hdr;
+    auto hsz = hdr.decode(src, n);
+    if (hsz == 0) throw std::runtime_error("Missing compression header");
+    src += hsz;
+    n -= hsz;
+
+    // the raw size comes from the wire, check it before allocating
+    if (hdr.raw_size > max_size) {
+      throw std::runtime_error("Message too large: "
+                               + std::to_string(hdr.raw_size));
+    }
+    bool plausible = true;
+    if (hdr.algo == Compression::None) {
+      plausible = hdr.raw_size == n;
+    } else if (hdr.algo == Compression::LZ4) {
+      // an lz4 sequence expands to at most 255 bytes per input byte
+      plausible = hdr.raw_size <= uint64_t(n) * 255;
+    } else if (hdr.algo == Compression::Zstd) {
+      // our frames carry their content size
+      auto fcs = ZSTD_getFrameContentSize(src, n);
+      plausible = fcs == hdr.raw_size || fcs == ZSTD_CONTENTSIZE_UNKNOWN;
+    }
+    if (!plausible) throw std::runtime_error("Corrupted compression header");
+
+    Msg ret(hdr.raw_size);
+    switch (hdr.algo) {
+      case Compression::None: {
+        if (n != hdr.raw_size) throw std::runtime_error("Truncated message");
+        std::memcpy(ret.data(), src, n);
+        break;
+      }
+      case Compression::LZ4: {
+        auto sz = LZ4_decompress_safe(reinterpret_cast<const char*>(src),
+                                      reinterpret_cast<char*>(ret.data()), n,
+                                      ret.size());
+        if (sz < 0 || static_cast<size_t>(sz) != ret.size()) {
+          throw std::runtime_error("Corrupted lz4 message");
+        }
+        break;
+      }
+      case Compression::Zstd: {
+        thread_local std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>
+            dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+        size_t sz = 0;
+        if (hdr.dict_id) {
+          auto ddict = Dictionaries::get_instance().find(hdr.dict_id);
+          if (!ddict) {
+            throw std::runtime_error("Unknown zstd dictionary "
+                                     + std::to_string(hdr.dict_id));
+          }
+          sz = ZSTD_decompress_usingDDict(dctx.get(), ret.data(), ret.size(),
+                                          src, n, ddict.get());
+        } else {
+          sz = ZSTD_decompressDCtx(dctx.get(), ret.data(), ret.size(), src, n);
+        }
+        if (ZSTD_isError(sz) || sz != ret.size()) {
+          throw std::runtime_error("Corrupted zstd message");
+        }
+        break;
+      }
+      default:
+        throw std::runtime_error("Unknown compression algorithm");
+    }
+    return ret;
+  }
+
+  Msg train_dictionary(const std::vector<Msg>& samples, size_t capacity) {
+    Msg buffer;
+    std::vector<size_t> sizes;
+    for (const auto& s : samples) {
+      buffer.insert(buffer.end(), s.begin(), s.end());
+      sizes.push_back(s.size());
+    }
+    Msg dict(capacity);
+    auto sz = ZDICT_trainFromBuffer(dict.data(), dict.size(), buffer.data(),
+                                    sizes.data(), sizes.size());
+    if (ZDICT_isError(sz)) {
+      Log::error(std::string("Failed to train dictionary: ")
+                 + ZDICT_getErrorName(sz));
+      return {};
+    }
+    dict.resize(sz);
+    return dict;
+  }
+}  // namespace tskpub
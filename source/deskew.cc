@@ -0,0 +1,44 @@
+#include "TSKPub/deskew.hh"
+
+#include <algorithm>
+
+#include "so3.hh"
+
+namespace tskpub {
+  void deskew_rotations(const RateSample* rates, size_t n, uint64_t start,
+                        uint64_t end, size_t slices, float* out) {
+    using namespace so3;
+    // rotation from the body at t to the body at start
+    Mat3 r = Identity;
+    uint64_t t = start;
+    size_t j = 0;
+    const float still[3] = {0.f, 0.f, 0.f};
+    auto advance = [&](uint64_t to) {
+      while (t < to) {
+        while (j < n && rates[j].stamp <= t) j++;
+        // a rate holds until its stamp, the last one beyond
+        const float* w = j < n ? rates[j].gyr : n ? rates[n - 1].gyr : still;
+        auto next = j < n ? std::min(rates[j].stamp, to) : to;
+        double dt = (next - t) * 1e-9;
+        r = mul(r, exp_so3({w[0] * dt, w[1] * dt, w[2] * dt}));
+        t = next;
+      }
+      return r;
+    };
+
+    const double span = double(end - start) / slices;
+    for (size_t k = 0; k < slices; k++) {
+      auto m = advance(start + uint64_t(span * (k + 0.5)));
+      std::copy(m.begin(), m.end(), out + k * 9);
+    }
+    // from the body at t to the body at end: R_end^T R_t
+    auto e = transpose(advance(end));
+    for (size_t k = 0; k < slices; k++) {
+      float* o = out + k * 9;
+      Mat3 m;
+      std::copy(o, o + 9, m.begin());
+      m = mul(e, m);
+      std::copy(m.begin(), m.end(), o);
+    }
+  }
+}  // namespace tskpub
@@ -0,0 +1,106 @@
+#include "TSKPub/executor.hh"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "common.hh"
+
+namespace {
+  // executor and worker of the calling thread, tasks submitted from a
+  // worker stay on its queue
+  thread_local const tskpub::Executor* current = nullptr;
+  thread_local size_t current_index = 0;
+}  // namespace
+
+namespace tskpub {
+  Executor::Executor(size_t workers) {
+    workers = std::max<size_t>(1, workers);
+    for (size_t i = 0; i < workers; i++) {
+      workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers; i++) {
+      threads_.emplace_back(&Executor::run, this, i);
+    }
+  }
+
+  Executor::~Executor() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) t.join();
+  }
+
+  Executor& Executor::shared() {
+    // never destroyed, readers may still submit during static destruction
+    static Executor* executor = [] {
+      size_t n = std::thread::hardware_concurrency();
+      const auto& yml = GlobalParams::get_instance().yml;
+      if (yml.is_mapping() && yml.contains("app")
+          && yml["app"].contains("workers")) {
+        n = yml["app"]["workers"].get_value<size_t>();
+      }
+      return new Executor(n);
+    }();
+    return *executor;
+  }
+
+  void Executor::submit(Task task, Priority priority) {
+    size_t index = current == this
+                       ? current_index
+                       : next_.fetch_add(1, std::memory_order_relaxed)
+                             % workers_.size();
+    {
+      auto& w = *workers_[index];
+      std::lock_guard<std::mutex> lock(w.mtx);
+      w.queues[size_t(priority)].push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      pending_++;
+    }
+    cv_.notify_one();
+  }
+
+  void Executor::run(size_t index) {
+    current = this;
+    current_index = index;
+    Task task;
+    while (true) {
+      if (take(index, task)) {
+        try {
+          task();
+        } catch (const std::exception& e) {
+          Log::error(std::string("Executor task failed: ") + e.what());
+        }
+        task = nullptr;
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(mtx_);
+      // the queued tasks are still run after stop
+      if (stop_ && pending_ <= 0) return;
+      cv_.wait(lock, [this] { return stop_ || pending_ > 0; });
+    }
+  }
+
+  bool Executor::take(size_t index, Task& task) {
+    const size_t n = workers_.size();
+    for (size_t p = 0; p < size_t(Priority::Count); p++) {
+      // own queue first, then steal the same priority from the others
+      for (size_t k = 0; k < n; k++) {
+        auto& w = *workers_[(index + k) % n];
+        std::lock_guard<std::mutex> lock(w.mtx);
+        auto& q = w.queues[p];
+        if (q.empty()) continue;
+        task = std::move(q.front());
+        q.pop_front();
+        pending_--;
+        if (k) steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+}  // namespace tskpub
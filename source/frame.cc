@@ -0,0 +1,52 @@
+#include "TSKPub/frame.hh"
+
+#include <unordered_map>
+
+namespace {
+  template <typename T> void put(uint8_t* dst, T v) {
+    for (size_t i = 0; i < sizeof(T); i++) dst[i] = uint8_t(v >> (8 * i));
+  }
+
+  template <typename T> T get(const uint8_t* src) {
+    T v = 0;
+    for (size_t i = 0; i < sizeof(T); i++) v |= T(src[i]) << (8 * i);
+    return v;
+  }
+}  // namespace
+
+namespace tskpub {
+  Schema schema_from_type(const std::string& msg_type) {
+    static const std::unordered_map<std::string, Schema> schemas{
+        {"Status", Schema::Status},
+        {"Imu", Schema::Imu},
+        {"Image", Schema::Image},
+        {"PointCloud", Schema::PointCloud},
+        {"OctreeCloud", Schema::OctreeCloud},
+        {"RangeImage", Schema::RangeImage},
+        {"TopicDictionary", Schema::TopicDictionary},
+        {"ImuDelta", Schema::ImuDelta},
+        {"SensorBundle", Schema::SensorBundle},
+        {"Series", Schema::Series},
+    };
+    auto it = schemas.find(msg_type);
+    return it == schemas.end() ? Schema::Unknown : it->second;
+  }
+
+  void FrameHeader::encode(uint8_t* dst) const {
+    dst[0] = Version << 4 | (flags & 0x0f);
+    dst[1] = static_cast<uint8_t>(schema);
+    put(dst + 2, topic_id);
+    put(dst + 4, seq);
+    put(dst + 8, stamp);
+  }
+
+  bool FrameHeader::decode(const uint8_t* src, size_t size) {
+    if (size < Size || src[0] >> 4 != Version) return false;
+    flags = src[0] & 0x0f;
+    schema = static_cast<Schema>(src[1]);
+    topic_id = get<uint16_t>(src + 2);
+    seq = get<uint32_t>(src + 4);
+    stamp = get<uint64_t>(src + 8);
+    return true;
+  }
+}  // namespace tskpub
@@ -0,0 +1,124 @@
+#include "TSKPub/gorilla.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+  /// @brief Appends bits to a byte vector, most significant first
+  class BitWriter {
+  public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) { out_.clear(); }
+
+    /// @brief Append the low bits of v
+    void put(uint64_t v, int bits) {
+      while (bits > 0) {
+        if (used_ == 0) out_.push_back(0);
+        int n = std::min(bits, 8 - used_);
+        auto chunk = uint8_t((v >> (bits - n)) & ((1u << n) - 1));
+        out_.back() |= chunk << (8 - used_ - n);
+        used_ = (used_ + n) % 8;
+        bits -= n;
+      }
+    }
+
+  private:
+    std::vector<uint8_t>& out_;
+    // bits used in the last byte
+    int used_{0};
+  };
+
+  /// @brief Delta of delta classes of the stamp: prefix, prefix bits and
+  ///        value bits
+  struct StampClass {
+    uint8_t prefix, prefix_bits, bits;
+  };
+  constexpr StampClass StampClasses[] = {
+      {0b10, 2, 16}, {0b110, 3, 24}, {0b1110, 4, 36}, {0b1111, 4, 64}};
+
+  bool fits(int64_t v, int bits) {
+    if (bits == 64) return true;
+    const int64_t half = int64_t(1) << (bits - 1);
+    return v >= -half && v < half;
+  }
+
+  uint64_t bits_of(double v) {
+    uint64_t b;
+    std::memcpy(&b, &v, sizeof(b));
+    return b;
+  }
+}  // namespace
+
+namespace tskpub {
+  GorillaEncoder::GorillaEncoder(uint32_t key_interval)
+      : key_interval_(key_interval) {
+    if (key_interval == 0) {
+      throw std::invalid_argument("Invalid Gorilla key interval");
+    }
+  }
+
+  uint32_t GorillaEncoder::encode(uint64_t stamp, const double* values,
+                                  size_t n, std::vector<uint8_t>& out) {
+    if (n != values_.size()) index_ = 0;
+    BitWriter bits(out);
+    const auto index = index_;
+    index_ = (index_ + 1) % key_interval_;
+
+    if (index == 0) {
+      bits.put(stamp, 64);
+      values_.resize(n);
+      leading_.assign(n, 64);
+      trailing_.assign(n, 0);
+      for (size_t i = 0; i < n; i++) {
+        values_[i] = bits_of(values[i]);
+        bits.put(values_[i], 64);
+      }
+      stamp_ = stamp;
+      delta_ = 0;
+      return index;
+    }
+
+    // wraps the same way in the decoder
+    const uint64_t delta = stamp - stamp_;
+    const auto dod = int64_t(delta - delta_);
+    if (dod == 0) {
+      bits.put(0, 1);
+    } else {
+      for (const auto& c : StampClasses) {
+        if (!fits(dod, c.bits)) continue;
+        bits.put(c.prefix, c.prefix_bits);
+        bits.put(uint64_t(dod), c.bits);
+        break;
+      }
+    }
+    stamp_ = stamp;
+    delta_ = delta;
+
+    for (size_t i = 0; i < n; i++) {
+      const auto v = bits_of(values[i]);
+      const auto x = v ^ values_[i];
+      values_[i] = v;
+      if (x == 0) {
+        bits.put(0, 1);
+        continue;
+      }
+      // leading zeros beyond 31 do not fit the field, they are sent as
+      // meaningful bits
+      const int leading = std::min(__builtin_clzll(x), 31);
+      const int trailing = __builtin_ctzll(x);
+      if (leading >= leading_[i] && trailing >= trailing_[i]) {
+        bits.put(0b10, 2);
+        bits.put(x >> trailing_[i], 64 - leading_[i] - trailing_[i]);
+        continue;
+      }
+      const int meaningful = 64 - leading - trailing;
+      bits.put(0b11, 2);
+      bits.put(leading, 5);
+      bits.put(meaningful & 63, 6);
+      bits.put(x >> trailing, meaningful);
+      leading_[i] = leading;
+      trailing_[i] = trailing;
+    }
+    return index;
+  }
+}  // namespace tskpub
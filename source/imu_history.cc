@@ -0,0 +1,56 @@
+#include "TSKPub/imu_history.hh"
+
+#include <map>
+#include <mutex>
+
+namespace tskpub {
+  ImuHistory& ImuHistory::get(const std::string& imu) {
+    static std::mutex mtx;
+    static std::map<std::string, ImuHistory> histories;
+    std::lock_guard<std::mutex> lock(mtx);
+    return histories[imu];
+  }
+
+  void ImuHistory::push(uint64_t stamp, const float gyr[3]) {
+    auto h = head_.load(std::memory_order_relaxed);
+    claim_.store(h + 1, std::memory_order_relaxed);
+    // a reader that sees the new slot also sees the claim
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& slot = slots_[h % Capacity];
+    slot.stamp.store(stamp, std::memory_order_relaxed);
+    for (int i = 0; i < 3; i++)
+      slot.gyr[i].store(gyr[i], std::memory_order_relaxed);
+    head_.store(h + 1, std::memory_order_release);
+  }
+
+  size_t ImuHistory::copy(uint64_t from, uint64_t to, RateSample* out,
+                          size_t max) const {
+    auto head = head_.load(std::memory_order_acquire);
+    uint64_t oldest = head > Capacity ? head - Capacity : 0;
+    // skip back to the newest sample at or before from
+    auto i = head;
+    while (i > oldest
+           && slots_[(i - 1) % Capacity].stamp.load(std::memory_order_relaxed)
+                  > from) {
+      i--;
+    }
+    if (i == oldest) return 0;
+    const auto first = i;
+
+    size_t n = 0;
+    while (i < head && n < max) {
+      const auto& slot = slots_[i++ % Capacity];
+      auto& s = out[n++];
+      s.stamp = slot.stamp.load(std::memory_order_relaxed);
+      for (int k = 0; k < 3; k++)
+        s.gyr[k] = slot.gyr[k].load(std::memory_order_relaxed);
+      if (s.stamp >= to) break;
+    }
+
+    // the writer claims a slot before overwriting it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto claim = claim_.load(std::memory_order_relaxed);
+    if (first - 1 + Capacity < claim) return 0;
+    return n;
+  }
+}  // namespace tskpub
@@ -0,0 +1,46 @@
+#include "TSKPub/lod.hh"
+
+#include <stdexcept>
+
+#include "morton.hh"
+
+namespace tskpub {
+  LodSplitter::LodSplitter(const LodParams& params)
+      : params_(params), offsets_(params.layers + 1, 0) {
+    if (params.layers == 0 || params.stride < 2) {
+      throw std::invalid_argument("Invalid level of detail params");
+    }
+  }
+
+  uint32_t LodSplitter::code(float x, float y, float z) {
+    return morton::encode(static_cast<uint64_t>(x), static_cast<uint64_t>(y),
+                          static_cast<uint64_t>(z));
+  }
+
+  void LodSplitter::order() {
+    morton::radix_sort(
+        keys_, scratch_, 3 * Bits,
+        [](const std::pair<uint32_t, uint32_t>& k) { return k.first; });
+
+    // the layer of curve position i is set by how often stride divides i,
+    // position 0 belongs to layer 0
+    const size_t n = keys_.size(), last = params_.layers - 1;
+    auto layer = [&](size_t i) {
+      size_t l = last;
+      while (l > 0 && i % params_.stride == 0) {
+        i /= params_.stride;
+        l--;
+      }
+      return l;
+    };
+    std::fill(offsets_.begin(), offsets_.end(), 0);
+    for (size_t i = 0; i < n; i++) offsets_[layer(i) + 1]++;
+    for (size_t l = 0; l < last + 1; l++) offsets_[l + 1] += offsets_[l];
+
+    // stable scatter keeps every layer in curve order
+    scratch_.resize(n);
+    std::vector<size_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (size_t i = 0; i < n; i++) scratch_[next[layer(i)]++] = keys_[i];
+    keys_.swap(scratch_);
+  }
+}  // namespace tskpub
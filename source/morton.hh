@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace tskpub {
+  /// @brief Morton (Z order) codes of 3D grid cells, shared by the octree
+  ///        and the level of detail coding
+  namespace morton {
+    /// @brief Bits per axis that fit a 64 bit code
+    constexpr uint8_t MaxBits = 21;
+
+    /// @brief Spread the lower 21 bits of v so that there are two zero bits
+    ///        between each of them
+    inline uint64_t split_by_3(uint64_t v) {
+      v &= 0x1fffff;
+      v = (v | v << 32) & 0x1f00000000ffffull;
+      v = (v | v << 16) & 0x1f0000ff0000ffull;
+      v = (v | v << 8) & 0x100f00f00f00f00full;
+      v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+      v = (v | v << 2) & 0x1249249249249249ull;
+      return v;
+    }
+
+    /// @brief Inverse of split_by_3
+    inline uint64_t compact_by_3(uint64_t v) {
+      v &= 0x1249249249249249ull;
+      v = (v ^ (v >> 2)) & 0x10c30c30c30c30c3ull;
+      v = (v ^ (v >> 4)) & 0x100f00f00f00f00full;
+      v = (v ^ (v >> 8)) & 0x1f0000ff0000ffull;
+      v = (v ^ (v >> 16)) & 0x1f00000000ffffull;
+      v = (v ^ (v >> 32)) & 0x1fffff;
+      return v;
+    }
+
+    /// @brief Code of a cell, x in the lowest bit
+    inline uint64_t encode(uint64_t x, uint64_t y, uint64_t z) {
+      return split_by_3(x) | split_by_3(y) << 1 | split_by_3(z) << 2;
+    }
+
+    /// @brief Least significant digit first radix sort by morton code, the
+    ///        hash order of voxels or the scan order of points has no runs
+    ///        for std::sort to use. Stable
+    /// @param v values to sort
+    /// @param tmp scratch buffer, reused between calls
+    /// @param bits significant bits of the codes
+    /// @param key morton code of a value
+    template <typename T, typename Key>
+    void radix_sort(std::vector<T>& v, std::vector<T>& tmp, int bits,
+                    Key key) {
+      constexpr int Digit = 11;
+      constexpr uint64_t Mask = (1u << Digit) - 1;
+      tmp.resize(v.size());
+      for (int shift = 0; shift < bits; shift += Digit) {
+        std::array<uint32_t, 1u << Digit> count{};
+        for (const auto& x : v) count[(key(x) >> shift) & Mask]++;
+        uint32_t sum = 0;
+        for (auto& c : count) {
+          auto n = c;
+          c = sum;
+          sum += n;
+        }
+        for (const auto& x : v) tmp[count[(key(x) >> shift) & Mask]++] = x;
+        v.swap(tmp);
+      }
+    }
+  }  // namespace morton
+}  // namespace tskpub
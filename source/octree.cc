@@ -0,0 +1,298 @@
+#include "TSKPub/octree.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+#include "morton.hh"
+
+namespace tskpub {
+  // *************
+  // * occupancy *
+  // *************
+  void encode_occupancy(const std::vector<uint64_t>& codes, uint8_t depth,
+                        std::vector<uint8_t>& out) {
+    out.clear();
+    if (codes.empty()) return;
+    // one pass per level, sorted codes give nodes in breadth first order
+    for (uint8_t l = 0; l < depth; l++) {
+      auto shift = 3 * (depth - l - 1);
+      uint64_t node = codes.front() >> (shift + 3);
+      uint8_t mask = 0;
+      for (auto c : codes) {
+        auto parent = c >> (shift + 3);
+        if (parent != node) {
+          out.push_back(mask);
+          node = parent;
+          mask = 0;
+        }
+        mask |= 1 << ((c >> shift) & 7);
+      }
+      out.push_back(mask);
+    }
+  }
+
+  bool decode_occupancy(const std::vector<uint8_t>& occupancy, uint8_t depth,
+                        std::vector<uint64_t>& out) {
+    out.clear();
+    if (occupancy.empty()) return true;
+    std::vector<uint64_t> next;
+    out.push_back(0);
+    size_t pos = 0;
+    for (uint8_t l = 0; l < depth; l++) {
+      next.clear();
+      for (auto node : out) {
+        if (pos >= occupancy.size()) return false;
+        auto mask = occupancy[pos++];
+        for (uint8_t d = 0; d < 8; d++) {
+          if (mask & (1 << d)) next.push_back(node << 3 | d);
+        }
+      }
+      out.swap(next);
+    }
+    return pos == occupancy.size();
+  }
+
+  // *************
+  // * VoxelHash *
+  // *************
+  void VoxelHash::clear() {
+    size_ = 0;
+    if (++generation_ == 0) {
+      // wrapped around, old generations could match again
+      for (auto& v : slots_) v.generation = 0;
+      generation_ = 1;
+    }
+  }
+
+  void VoxelHash::add(uint64_t code, uint8_t intensity) {
+    // at most half full keeps the probes short
+    if (2 * (size_ + 1) > slots_.size()) grow();
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = home(code);; i = (i + 1) & mask) {
+      auto& v = slots_[i];
+      if (v.generation != generation_) {
+        v = {code, intensity, 1, generation_};
+        size_++;
+        return;
+      }
+      if (v.code == code) {
+        // the mean of the first points of a crowded voxel
+        if (v.count < UINT16_MAX) {
+          v.sum += intensity;
+          v.count++;
+        }
+        return;
+      }
+    }
+  }
+
+  const VoxelHash::Voxel* VoxelHash::find(uint64_t code) const {
+    if (slots_.empty()) return nullptr;
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = home(code);; i = (i + 1) & mask) {
+      const auto& v = slots_[i];
+      if (v.generation != generation_) return nullptr;
+      if (v.code == code) return &v;
+    }
+  }
+
+  void VoxelHash::grow() {
+    const size_t n = std::max<size_t>(1024, 2 * slots_.size());
+    std::vector<Voxel> old(n, Voxel{0, 0, 0, 0});
+    old.swap(slots_);
+    shift_ = 64 - static_cast<int>(std::log2(n));
+    for (const auto& v : old) {
+      if (v.generation != generation_) continue;
+      size_t i = home(v.code);
+      while (slots_[i].generation == generation_) i = (i + 1) & (n - 1);
+      slots_[i] = v;
+    }
+  }
+
+  // *****************
+  // * OctreeEncoder *
+  // *****************
+  OctreeEncoder::OctreeEncoder(const OctreeParams& params) : params_(params) {
+    auto cells = 2 * params_.range / params_.resolution;
+    depth_ = std::clamp<int>(std::ceil(std::log2(cells)), 1, morton::MaxBits);
+    // center the grid on the sensor
+    origin_ = -params_.resolution * (1u << depth_) / 2;
+    intensity_scale_ = 255.f / params_.max_intensity;
+  }
+
+  bool OctreeEncoder::quantize(float x, float y, float z,
+                               uint64_t& code) const {
+    const float inv = 1.f / params_.resolution;
+    const float max = static_cast<float>(1u << depth_);
+    auto qx = (x - origin_) * inv;
+    auto qy = (y - origin_) * inv;
+    auto qz = (z - origin_) * inv;
+    // NaN fails every comparison
+    if (!(qx >= 0 && qx < max && qy >= 0 && qy < max && qz >= 0 && qz < max)) {
+      return false;
+    }
+    code = morton::encode(static_cast<uint64_t>(qx), static_cast<uint64_t>(qy),
+                          static_cast<uint64_t>(qz));
+    return true;
+  }
+
+  void OctreeEncoder::encode_voxels(OctreeFrame& out) {
+    out.frame_index = frame_index_++;
+    out.resolution = params_.resolution;
+    out.origin[0] = out.origin[1] = out.origin[2] = origin_;
+    out.depth = depth_;
+    out.removed.clear();
+    out.keyframe = params_.keyframe_interval <= 1
+                   || count_ % params_.keyframe_interval == 0;
+    count_++;
+
+    if (!out.keyframe && !diff()) {
+      out.keyframe = true;
+      count_ = 1;
+    }
+
+    if (out.keyframe) {
+      voxels_.clear();
+      current_.for_each([this](const VoxelHash::Voxel& v) {
+        voxels_.emplace_back(v.code, v.intensity());
+      });
+      write(voxels_, out.occupancy, out.intensity);
+    } else {
+      write(added_, out.occupancy, out.intensity);
+      morton::radix_sort(removed_, codes_, 3 * depth_,
+                         [](uint64_t c) { return c; });
+      encode_occupancy(removed_, depth_, out.removed);
+    }
+
+    out.reference = out.keyframe ? out.frame_index : reference_index_;
+    // a key frame stays the reference until the next one
+    if (out.keyframe
+        || params_.reference == OctreeParams::Reference::Previous) {
+      std::swap(reference_, current_);
+      reference_index_ = out.frame_index;
+    }
+  }
+
+  bool OctreeEncoder::diff() {
+    added_.clear();
+    removed_.clear();
+    const bool previous
+        = params_.reference == OctreeParams::Reference::Previous;
+    // a difference larger than the frame itself is not worth it
+    const size_t limit = current_.size();
+    bool small = true;
+    current_.for_each([&](VoxelHash::Voxel& v) {
+      if (!small) return;
+      auto i = v.intensity();
+      auto r = reference_.find(v.code);
+      // kept voxels are only resent if the intensity drifted too far from
+      // what the decoder has
+      if (!r || std::abs(i - r->intensity()) > params_.intensity_threshold) {
+        added_.emplace_back(v.code, i);
+        small = added_.size() < limit;
+      } else if (previous) {
+        // the next reference, as the decoder knows it
+        v.sum = r->intensity();
+        v.count = 1;
+      }
+    });
+    reference_.for_each([&](const VoxelHash::Voxel& r) {
+      if (!small || current_.find(r.code)) return;
+      removed_.push_back(r.code);
+      small = added_.size() + removed_.size() < limit;
+    });
+    return small && added_.size() + removed_.size() < limit;
+  }
+
+  void OctreeEncoder::write(std::vector<std::pair<uint64_t, uint8_t>>& voxels,
+                            std::vector<uint8_t>& occupancy,
+                            std::vector<uint8_t>& intensity) {
+    // only the voxels to send are sorted, codes are unique
+    morton::radix_sort(
+        voxels, scratch_, 3 * depth_,
+        [](const std::pair<uint64_t, uint8_t>& v) { return v.first; });
+    codes_.clear();
+    intensity.clear();
+    for (const auto& [code, i] : voxels) {
+      codes_.push_back(code);
+      intensity.push_back(i);
+    }
+    encode_occupancy(codes_, depth_, occupancy);
+  }
+
+  // *****************
+  // * OctreeDecoder *
+  // *****************
+  bool OctreeDecoder::decode(const OctreeFrame& frame, float max_intensity,
+                             std::vector<Point>& out) {
+    std::vector<uint64_t> added, removed;
+    if (!decode_occupancy(frame.occupancy, frame.depth, added)
+        || added.size() != frame.intensity.size()) {
+      valid_ = false;
+      return false;
+    }
+
+    if (frame.keyframe) {
+      voxels_.clear();
+      for (size_t i = 0; i < added.size(); i++) {
+        voxels_.emplace_back(added[i], frame.intensity[i]);
+      }
+      key_ = voxels_;
+      key_index_ = frame.frame_index;
+      key_valid_ = true;
+    } else {
+      // a difference needs its reference frame
+      const std::vector<std::pair<uint64_t, uint8_t>>* base = nullptr;
+      if (valid_ && frame.reference == frame_index_) {
+        base = &voxels_;
+      } else if (key_valid_ && frame.reference == key_index_) {
+        base = &key_;
+      }
+      if (!base || !decode_occupancy(frame.removed, frame.depth, removed)) {
+        valid_ = false;
+        return false;
+      }
+      auto& merged = merged_;
+      merged.clear();
+      merged.reserve(base->size() + added.size());
+      const auto& prev = *base;
+      size_t i = 0, a = 0, r = 0;
+      while (i < prev.size() || a < added.size()) {
+        // added voxels are new or replace the intensity of a kept one
+        if (i == prev.size()
+            || (a < added.size() && added[a] <= prev[i].first)) {
+          if (i < prev.size() && added[a] == prev[i].first) i++;
+          merged.emplace_back(added[a], frame.intensity[a]);
+          a++;
+          continue;
+        }
+        auto code = prev[i].first;
+        while (r < removed.size() && removed[r] < code) r++;
+        if (r == removed.size() || removed[r] != code) {
+          merged.push_back(prev[i]);
+        }
+        i++;
+      }
+      voxels_.swap(merged);
+    }
+    frame_index_ = frame.frame_index;
+    valid_ = true;
+
+    out.clear();
+    out.reserve(voxels_.size());
+    auto scale = max_intensity / 255.f;
+    for (const auto& [code, i] : voxels_) {
+      Point p;
+      p.x = frame.origin[0]
+            + (morton::compact_by_3(code) + 0.5f) * frame.resolution;
+      p.y = frame.origin[1]
+            + (morton::compact_by_3(code >> 1) + 0.5f) * frame.resolution;
+      p.z = frame.origin[2]
+            + (morton::compact_by_3(code >> 2) + 0.5f) * frame.resolution;
+      p.intensity = i * scale;
+      out.push_back(p);
+    }
+    return true;
+  }
+}  // namespace tskpub
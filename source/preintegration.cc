@@ -0,0 +1,94 @@
+#include "TSKPub/preintegration.hh"
+
+#include "so3.hh"
+
+namespace {
+  using namespace tskpub::so3;
+  using Mat9 = std::array<double, 81>;
+
+  /// @brief Copy a 3x3 block into a 9x9 matrix at block row i, column j
+  void set_block(Mat9& m, int i, int j, const Mat3& b) {
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) m[(i * 3 + r) * 9 + j * 3 + c] = b[r * 3 + c];
+    }
+  }
+}  // namespace
+
+namespace tskpub {
+  void Preintegrator::reset(uint64_t start) {
+    delta_ = ImuDelta{};
+    delta_.start = start;
+    delta_.end = start;
+    rot_ = Identity;
+  }
+
+  void Preintegrator::integrate(const double acc[3], const double gyr[3],
+                                uint64_t stamp) {
+    if (stamp <= delta_.end) return;
+    double dt = (stamp - delta_.end) * 1e-9;
+    Vec3 phi{gyr[0] * dt, gyr[1] * dt, gyr[2] * dt};
+    Vec3 half{phi[0] / 2, phi[1] / 2, phi[2] / 2};
+    auto step = exp_so3(phi);
+    // the specific force is rotated at the middle of the step, exact to the
+    // second order for a constant rate
+    auto mid = mul(rot_, exp_so3(half));
+    auto a = mul(mid, acc);
+
+    // error propagation of [rotation, velocity, position]
+    Mat9 f{};
+    set_block(f, 0, 0, transpose(step));
+    auto ra = mul(mid, skew(acc));
+    Mat3 vr, pr, dt_i{};
+    for (int i = 0; i < 9; i++) {
+      vr[i] = -ra[i] * dt;
+      pr[i] = -0.5 * ra[i] * dt * dt;
+      dt_i[i] = Identity[i] * dt;
+    }
+    set_block(f, 1, 0, vr);
+    set_block(f, 2, 0, pr);
+    set_block(f, 1, 1, Identity);
+    set_block(f, 2, 1, dt_i);
+    set_block(f, 2, 2, Identity);
+
+    auto& cov = delta_.covariance;
+    Mat9 fc{};
+    for (int i = 0; i < 9; i++) {
+      for (int k = 0; k < 9; k++) {
+        double v = f[i * 9 + k];
+        if (v == 0) continue;
+        for (int j = 0; j < 9; j++) fc[i * 9 + j] += v * cov[k * 9 + j];
+      }
+    }
+    for (int i = 0; i < 9; i++) {
+      for (int j = 0; j < 9; j++) {
+        double v = 0;
+        for (int k = 0; k < 9; k++) v += fc[i * 9 + k] * f[j * 9 + k];
+        cov[i * 9 + j] = v;
+      }
+    }
+
+    // white noise over the step, the discrete density is sigma^2 / dt
+    auto jr = right_jacobian(phi);
+    auto jj = mul(jr, transpose(jr));
+    double g2 = noise_.gyro * noise_.gyro * dt;
+    double a2 = noise_.acc * noise_.acc;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) cov[r * 9 + c] += jj[r * 3 + c] * g2;
+      cov[(3 + r) * 9 + 3 + r] += a2 * dt;
+      cov[(3 + r) * 9 + 6 + r] += 0.5 * a2 * dt * dt;
+      cov[(6 + r) * 9 + 3 + r] += 0.5 * a2 * dt * dt;
+      cov[(6 + r) * 9 + 6 + r] += 0.25 * a2 * dt * dt * dt;
+    }
+
+    auto& v = delta_.velocity;
+    auto& p = delta_.position;
+    for (int i = 0; i < 3; i++) {
+      p[i] += v[i] * dt + 0.5 * a[i] * dt * dt;
+      v[i] += a[i] * dt;
+    }
+    rot_ = mul(rot_, step);
+    delta_.rotation = to_quaternion(rot_);
+    delta_.end = stamp;
+    delta_.samples++;
+  }
+}  // namespace tskpub
@@ -0,0 +1,165 @@
+#include "TSKPub/queue.hh"
+
+#include <chrono>
+
+namespace tskpub {
+  MessageQueue::MessageQueue(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+  void MessageQueue::add_topic(const std::string& name,
+                               const TopicParams& params) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    topic(name).params = params;
+  }
+
+  size_t MessageQueue::push(const std::string& name, MsgConstPtr msg,
+                            uint8_t level) {
+    if (!msg) return 0;
+    // the message keeps its whole allocation alive, not just its size
+    size_t n = msg->capacity();
+    std::unique_lock<std::mutex> lock(mtx_);
+    auto& t = topic(name);
+    t.stats.pushed_msgs++;
+
+    auto reject = [&](size_t dropped) {
+      t.stats.dropped_msgs++;
+      t.stats.dropped_bytes += n;
+      return dropped + 1;
+    };
+    // a message over a limit on its own would wait or evict forever
+    if (closed_ || t.params.max_msgs == 0
+        || (t.params.max_bytes && n > t.params.max_bytes)
+        || (max_bytes_ && n > max_bytes_)) {
+      return reject(0);
+    }
+
+    // refinements of earlier messages go first, the finest ones first
+    size_t dropped = 0;
+    while (!fits(t, n) && drop_refinement(t, level)) dropped++;
+    // a refinement is only worth sending while there is room for it
+    if (level > 0 && !fits(t, n)) return reject(dropped);
+
+    switch (t.params.policy) {
+      case Policy::DropOldest:
+        while (!fits(t, n) && !t.queue.empty()) {
+          drop_head(t);
+          dropped++;
+        }
+        // the ceiling is taken by other topics
+        if (!fits(t, n)) return reject(dropped);
+        break;
+      case Policy::DropNewest:
+        if (!fits(t, n)) return reject(dropped);
+        break;
+      case Policy::Block: {
+        if (fits(t, n)) break;
+        auto start = std::chrono::steady_clock::now();
+        auto room = [&] { return closed_ || fits(t, n); };
+        if (t.params.max_wait.count() > 0) {
+          room_.wait_for(lock, t.params.max_wait, room);
+        } else {
+          room_.wait(lock, room);
+        }
+        std::chrono::nanoseconds waited
+            = std::chrono::steady_clock::now() - start;
+        t.stats.blocked_ns += waited.count();
+        if (closed_ || !fits(t, n)) return reject(dropped);
+        break;
+      }
+    }
+
+    t.queue.push_back({seq_++, std::move(msg), n, level});
+    t.bytes += n;
+    bytes_ += n;
+    size_++;
+    return dropped;
+  }
+
+  MsgConstPtr MessageQueue::pop(std::string* name, uint8_t* level) {
+    MsgConstPtr msg{nullptr};
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      // the oldest head over all topics keeps the arrival order
+      Topic* best = nullptr;
+      for (auto& t : topics_) {
+        if (t.queue.empty()) continue;
+        if (!best || t.queue.front().seq < best->queue.front().seq) best = &t;
+      }
+      if (!best) return nullptr;
+
+      auto& e = best->queue.front();
+      msg = std::move(e.msg);
+      best->bytes -= e.bytes;
+      bytes_ -= e.bytes;
+      size_--;
+      best->queue.pop_front();
+      if (name) *name = best->name;
+      if (level) *level = e.level;
+    }
+    room_.notify_all();
+    return msg;
+  }
+
+  void MessageQueue::close() {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      closed_ = true;
+    }
+    room_.notify_all();
+  }
+
+  MessageQueue::TopicStats MessageQueue::stats(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = index_.find(name);
+    if (it == index_.end()) return {};
+    return topics_[it->second].stats;
+  }
+
+  size_t MessageQueue::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return size_;
+  }
+
+  size_t MessageQueue::bytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return bytes_;
+  }
+
+  MessageQueue::Topic& MessageQueue::topic(const std::string& name) {
+    auto it = index_.find(name);
+    if (it != index_.end()) return topics_[it->second];
+    index_[name] = topics_.size();
+    topics_.emplace_back();
+    topics_.back().name = name;
+    return topics_.back();
+  }
+
+  bool MessageQueue::fits(const Topic& t, size_t n) const {
+    return t.queue.size() < t.params.max_msgs
+           && (!t.params.max_bytes || t.bytes + n <= t.params.max_bytes)
+           && (!max_bytes_ || bytes_ + n <= max_bytes_);
+  }
+
+  void MessageQueue::drop_head(Topic& t) { drop(t, t.queue.begin()); }
+
+  bool MessageQueue::drop_refinement(Topic& t, uint8_t level) {
+    auto victim = t.queue.end();
+    for (auto it = t.queue.begin(); it != t.queue.end(); ++it) {
+      if (it->level > level
+          && (victim == t.queue.end() || it->level > victim->level)) {
+        victim = it;
+      }
+    }
+    if (victim == t.queue.end()) return false;
+    drop(t, victim);
+    return true;
+  }
+
+  void MessageQueue::drop(Topic& t, std::deque<Entry>::iterator it) {
+    t.stats.dropped_msgs++;
+    t.stats.dropped_bytes += it->bytes;
+    t.bytes -= it->bytes;
+    bytes_ -= it->bytes;
+    size_--;
+    t.queue.erase(it);
+  }
+}  // namespace tskpub
@@ -0,0 +1,22 @@
+#include "TSKPub/range_image.hh"
+
+namespace tskpub {
+  void shuffle_depth(const std::vector<uint16_t>& depth, Msg& out) {
+    const auto n = depth.size();
+    out.resize(2 * n);
+    for (size_t i = 0; i < n; i++) {
+      out[i] = depth[i] & 0xff;
+      out[n + i] = depth[i] >> 8;
+    }
+  }
+
+  bool unshuffle_depth(const Msg& planes, std::vector<uint16_t>& out) {
+    if (planes.size() % 2) return false;
+    const auto n = planes.size() / 2;
+    out.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      out[i] = planes[i] | planes[n + i] << 8;
+    }
+    return true;
+  }
+}  // namespace tskpub
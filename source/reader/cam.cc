@@ -2,18 +2,92 @@
 
 #include <Camera/cam.hh>
 #include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
 #include <thread>
 
+#include "TSKPub/clock.hh"
 #include "TSKPub/msg/Image.capnp.h"
+#include "TSKPub/scene.hh"
 #include "reader/reader.hh"
 
+namespace {
+  // elements of the still branch in the camera pipeline
+  constexpr const char* StillValve = "v";
+  constexpr const char* StillSink = "snap";
+
+  /// @brief Full resolution stills of a camera, requested by its snapshot
+  ///        reader and handed over by the camera thread
+  struct Stills {
+    /// @brief Stills of a camera, created on first use and never removed
+    /// @param camera Sensor name of the camera
+    static Stills& get(const std::string& camera) {
+      static std::mutex mtx;
+      static std::map<std::string, Stills> stills;
+      std::lock_guard<std::mutex> lock(mtx);
+      return stills[camera];
+    }
+
+    /// @brief Ask the camera for a still, a paused camera runs until it
+    ///        took it
+    void request() {
+      requested = true;
+      std::lock_guard<std::mutex> lock(mtx);
+      if (wake) wake();
+    }
+
+    // set by the snapshot reader, taken by the camera thread
+    std::atomic<bool> requested{false};
+    std::mutex mtx;
+    camera::Image::ConstPtr image{nullptr};
+    // wakes the thread of a paused camera, set by the camera reader
+    std::function<void()> wake;
+  };
+
+  /// @brief Fill everything of an Image message but the header
+  void fill_image(Image::Builder& msg, const camera::Image& img) {
+    msg.setWidth(img.width);
+    msg.setHeight(img.height);
+    msg.setEncoding(img.encoding);
+    msg.setFps(img.fps);
+    // set data with zero copy
+    kj::ArrayPtr<const kj::byte> data_ptr{
+        reinterpret_cast<const kj::byte*>(img.data.data()), img.data.size()};
+    msg.setData(data_ptr);
+  }
+}  // namespace
+
 namespace tskpub {
   struct CameraReader::Impl {
-    // camera pipeline for GStreamer
-    std::string pipeline;
+    // pipeline settings, may change at runtime
+    std::string port;
+    // source element, v4l2src on port if empty
+    std::string src_pipeline;
+    int width;
+    int height;
+    int fps;
+    std::string enc_pipeline;
+    // jpegenc quality replacing enc_pipeline, 0 keeps enc_pipeline
+    int quality{0};
+
+    // capture size and quality of the still branch, the preview is scaled
+    // down to width x height. 0 width disables the branch
+    int still_width{0};
+    int still_height{0};
+    int still_quality{95};
+    // handed to the snapshot reader, nullptr without still branch
+    Stills* stills{nullptr};
+    // the valve of the still branch is open, only touched by the read
+    // thread
+    bool still_open{false};
+
+    // camera object, only touched by the read thread after construction
+    std::unique_ptr<camera::Camera> cam;
 
-    // camera object
-    camera::Camera cam;
+    // skips frames of an unchanged scene, nullptr publishes every frame.
+    // Only touched by the read thread
+    std::unique_ptr<SceneGate> gate{nullptr};
 
     // thread to read image
     std::thread job;
@@ -25,61 +99,301 @@ namespace tskpub {
     // flag to control the thread
     std::atomic<bool> is_running{true};
 
+    // paused by the reader, the thread stops the pipeline
+    std::atomic<bool> paused{false};
+    // set when the settings changed, the thread restarts the pipeline
+    bool restart{false};
+    std::mutex pmtx;
+    std::condition_variable pcv;
+
     // max image size
-    size_t max_sz;
-    Impl() = delete;
-    Impl(const std::string& pipeline) : pipeline(pipeline), cam(pipeline) {}
+    std::atomic<size_t> max_sz;
+
+    // called for every captured image, marks the reader ready.
+    // replaced is true if the previous image was never read
+    std::function<void(bool replaced)> on_image;
+
+    /// @brief GStreamer pipeline from the current settings, holds pmtx
+    std::string pipeline() const;
     void read_cb();
+
+    /// @brief Open the still branch on request and hand the still over.
+    ///        Only called by the read thread
+    void poll_still();
+
+    /// @brief A still is requested or being taken, the pipeline runs even
+    ///        while the preview is paused
+    bool still_pending() const {
+      return stills && (still_open || stills->requested);
+    }
+
+    /// @brief Forget the state of a torn down pipeline, a pending still is
+    ///        requested again
+    void reset_still() {
+      if (still_open && stills) stills->requested = true;
+      still_open = false;
+    }
   };
 
+  std::string CameraReader::Impl::pipeline() const {
+    std::stringstream ss;
+    auto enc = quality > 0 ? "jpegenc quality=" + std::to_string(quality) + " !"
+                           : enc_pipeline;
+    auto src = src_pipeline.empty() ? "v4l2src device=" + port : src_pipeline;
+    if (still_width == 0) {
+      // clang-format off
+      ss << src << " !"
+         << " video/x-raw, width=" << width << ", height=" << height << " !"
+         << " videoconvert ! " << enc
+         << " videorate ! image/jpeg framerate=" << fps << "/1 !"
+         << " jpegparse ! appsink name=s";
+      // clang-format on
+      return ss.str();
+    }
+    // captured at the still size, the preview is scaled down. The still
+    // branch drops every frame before the encoder until a still is
+    // requested, and its sink does not hold up the state changes
+    // clang-format off
+    ss << src << " !"
+       << " video/x-raw, width=" << still_width
+       << ", height=" << still_height << " !"
+       << " videoconvert ! tee name=t"
+       << " t. ! queue leaky=downstream max-size-buffers=2 ! videoscale !"
+       << " video/x-raw, width=" << width << ", height=" << height << " ! "
+       << enc
+       << " videorate ! image/jpeg framerate=" << fps << "/1 !"
+       << " jpegparse ! appsink name=s"
+       << " t. ! queue leaky=downstream max-size-buffers=1 !"
+       << " valve name=" << StillValve << " drop=true !"
+       << " jpegenc quality=" << still_quality << " !"
+       << " appsink name=" << StillSink
+       << " max-buffers=1 drop=true sync=false async=false";
+    // clang-format on
+    return ss.str();
+  }
+
+  void CameraReader::Impl::poll_still() {
+    if (!still_open) {
+      if (!stills->requested.exchange(false)) return;
+      // a frame encoded while the valve was closing is stale
+      while (cam->try_capture(StillSink, 0)) {
+      }
+      still_open = cam->set_property(StillValve, "drop", false);
+      if (!still_open) stills->requested = true;
+      return;
+    }
+    auto img = cam->try_capture(StillSink, 0);
+    if (!img) return;
+    cam->set_property(StillValve, "drop", true);
+    still_open = false;
+    std::lock_guard<std::mutex> lock(stills->mtx);
+    stills->image = std::move(img);
+  }
+
   void CameraReader::Impl::read_cb() {
+    // connect() and disconnect() only happen on this thread, so capture()
+    // never runs on a torn down pipeline
+    bool connected = true;
     while (is_running) {
-      auto tmp = cam.capture();
-      if (!tmp) {
+      {
+        std::unique_lock<std::mutex> lock(pmtx);
+        if (restart) {
+          // new settings need a new pipeline
+          if (connected) cam->disconnect();
+          if (gate) gate->reset();
+          reset_still();
+          cam = std::make_unique<camera::Camera>(pipeline());
+          connected = false;
+          restart = false;
+          Log::info("Camera pipeline: " + pipeline());
+        }
+        if (paused && !still_pending()) {
+          if (connected) {
+            // disconnect() forgets the pipeline description, a new camera
+            // is connected on resume
+            cam->disconnect();
+            cam = std::make_unique<camera::Camera>(pipeline());
+            connected = false;
+            reset_still();
+            Log::debug("Camera pipeline stopped");
+          }
+          // the first frame after resume is published
+          if (gate) gate->reset();
+          pcv.wait(lock, [this] {
+            return !paused || restart || !is_running || still_pending();
+          });
+          continue;
+        }
+      }
+      if (!connected) {
+        cam->connect();
+        connected = true;
+        Log::debug("Camera pipeline started");
+      }
+      auto tmp = cam->capture();
+      // the still lags a preview frame at most
+      if (stills) poll_still();
+      // a frame captured while pausing is stale by the time of resume
+      if (!tmp || paused) {
         continue;
       }
-      std::lock_guard<std::mutex> lock(imtx);
-      image.swap(tmp);
+      // the scene did not change, the subscribers keep the last frame
+      if (gate
+          && !gate->check(tmp->data.data(), tmp->data.size(), tmp->stamp)) {
+        continue;
+      }
+      {
+        std::lock_guard<std::mutex> lock(imtx);
+        image.swap(tmp);
+      }
+      // read() takes the image, so tmp is an unread one
+      on_image(tmp != nullptr);
     }
   }
 
-  CameraReader::CameraReader(std::string sensor_name) : Reader(sensor_name) {
+  CameraReader::CameraReader(std::string sensor_name)
+      : Reader(sensor_name), impl_(std::make_unique<Impl>()) {
     auto params = GlobalParams::get_instance().yml[sensor_name_];
-    std::stringstream ss;
-    auto width = params["width"].get_value<int>();
-    auto height = params["height"].get_value<int>();
+    impl_->port = params["port"].get_value<std::string>();
+    if (params.contains("src_pipeline")) {
+      impl_->src_pipeline = params["src_pipeline"].get_value<std::string>();
+    }
+    impl_->width = params["width"].get_value<int>();
+    impl_->height = params["height"].get_value<int>();
+    impl_->fps = params["fps"].get_value<int>();
+    impl_->enc_pipeline = params["enc_pipeline"].get_value<std::string>();
+    if (params.contains("quality")) {
+      impl_->quality = params["quality"].get_value<int>();
+    }
+    if (params.contains("scene_gate")) {
+      const auto& gcfg = params["scene_gate"];
+      SceneGate::Params gp;
+      if (gcfg.contains("block_threshold"))
+        gp.block_threshold = gcfg["block_threshold"].get_value<double>();
+      if (gcfg.contains("threshold"))
+        gp.threshold = gcfg["threshold"].get_value<double>();
+      if (gcfg.contains("keepalive"))
+        gp.keepalive = gcfg["keepalive"].get_value<double>();
+      if (gp.threshold < 0 || gp.threshold > 1 || gp.keepalive < 0) {
+        Log::critical("Invalid scene_gate for " + sensor_name_);
+        throw std::runtime_error("Invalid scene_gate for " + sensor_name_);
+      }
+      impl_->gate = std::make_unique<SceneGate>(gp);
+    }
+    // optional still branch, published by a Snapshot sensor
+    if (params.contains("snapshot")) {
+      const auto& scfg = params["snapshot"];
+      auto& impl = *impl_;
+      impl.still_width = scfg["width"].get_value<int>();
+      impl.still_height = scfg["height"].get_value<int>();
+      if (scfg.contains("quality"))
+        impl.still_quality = scfg["quality"].get_value<int>();
+      if (impl.still_width <= 0 || impl.still_height <= 0
+          || impl.still_quality < 1 || impl.still_quality > 100) {
+        Log::critical("Invalid snapshot for " + sensor_name_);
+        throw std::runtime_error("Invalid snapshot for " + sensor_name_);
+      }
+      impl.stills = &Stills::get(sensor_name_);
+      std::lock_guard<std::mutex> lock(impl.stills->mtx);
+      impl.stills->wake = [&impl] {
+        { std::lock_guard<std::mutex> lock(impl.pmtx); }
+        impl.pcv.notify_all();
+      };
+    }
+    impl_->max_sz = impl_->width * impl_->height * 3;
+    impl_->on_image = [this](bool replaced) {
+      mark_ready();
+      if (replaced) drop(DropStage::Overwrite);
+    };
+  }
 
-    // create camera pipeline
-    // clang-format off
-    ss << "v4l2src device=" << params["port"].get_value<std::string>() << " !"
-       << " video/x-raw, width=" << width << ", height=" << height << " !"
-       << " videoconvert ! " << params["enc_pipeline"].get_value<std::string>()
-       << " videorate ! image/jpeg framerate=" << params["fps"].get_value<int>() << "/1 !"
-       << " jpegparse ! appsink name=s";
-    // clang-format on
-    Log::info("Camera pipeline: " + ss.str());
+  void CameraReader::on_open() {
+    // create camera pipeline, set_params() may have changed the settings
+    std::string pipeline;
+    {
+      std::lock_guard<std::mutex> lock(impl_->pmtx);
+      pipeline = impl_->pipeline();
+      impl_->restart = false;
+    }
+    Log::info("Camera pipeline: " + pipeline);
 
     // create camera object
-    impl_ = std::make_unique<Impl>(ss.str());
-    impl_->max_sz = width * height * 3;
-    if (!impl_->cam.connect()) {
+    auto cam = std::make_unique<camera::Camera>(pipeline);
+    if (!cam->connect()) {
       Log::critical("Failed to connect to camera");
       throw std::runtime_error("Failed to connect to camera");
     }
+    startup_phase("connected");
+    impl_->cam = std::move(cam);
 
     // launch thread to read image
     impl_->job = std::thread(&Impl::read_cb, impl_.get());
   }
 
   CameraReader::~CameraReader() {
+    if (impl_->stills) {
+      std::lock_guard<std::mutex> lock(impl_->stills->mtx);
+      impl_->stills->wake = nullptr;
+    }
     // stop the read thread
-    impl_->is_running = false;
+    {
+      std::lock_guard<std::mutex> lock(impl_->pmtx);
+      impl_->is_running = false;
+    }
+    impl_->pcv.notify_all();
     if (impl_->job.joinable()) {
       impl_->job.join();
     }
   }
 
+  void CameraReader::on_pause() {
+    {
+      std::lock_guard<std::mutex> lock(impl_->pmtx);
+      impl_->paused = true;
+    }
+    // drop the last image so that it is not sent after resume
+    std::lock_guard<std::mutex> lock(impl_->imtx);
+    impl_->image.reset();
+  }
+
+  void CameraReader::on_resume() {
+    {
+      std::lock_guard<std::mutex> lock(impl_->pmtx);
+      impl_->paused = false;
+    }
+    impl_->pcv.notify_all();
+  }
+
+  bool CameraReader::set_params(const Params& params) {
+    std::unique_lock<std::mutex> lock(impl_->pmtx);
+    auto quality = impl_->quality;
+    auto width = impl_->width;
+    auto height = impl_->height;
+    for (const auto& [key, value] : params) {
+      if (key == "quality" && value >= 0 && value <= 100) {
+        quality = value;
+      } else if (key == "width" && value > 0) {
+        width = value;
+      } else if (key == "height" && value > 0) {
+        height = value;
+      } else {
+        Log::warn("Invalid camera param: " + key);
+        return false;
+      }
+    }
+    impl_->quality = quality;
+    impl_->width = width;
+    impl_->height = height;
+    impl_->max_sz = width * height * 3;
+    impl_->restart = true;
+    lock.unlock();
+    impl_->pcv.notify_all();
+    return true;
+  }
+
   MsgConstPtr CameraReader::read() {
+    if (!opened()) open();
+    if (paused_) return nullptr;
     camera::Image::ConstPtr img{nullptr};
 
     // get image from Impl::image
@@ -98,17 +412,77 @@ namespace tskpub {
     auto builder
         = capnp::MallocMessageBuilder(img->size + sizeof(camera::Image));
     auto image = builder.initRoot<Image>();
-    image.setTopic(topic_);
-    image.setTimestamp(nano_now());
-    image.setWidth(img->width);
-    image.setHeight(img->height);
-    image.setEncoding(img->encoding);
-    image.setFps(img->fps);
-    // set data with zero copy
-    kj::ArrayPtr<const kj::byte> data_ptr{
-        reinterpret_cast<const kj::byte*>(img->data.data()), img->data.size()};
-    image.setData(data_ptr);
-    return to_msg(builder, impl_->max_sz);
+    // captured by the pipeline, not packed, on the system clock
+    auto stamp = Clock::from_system(img->stamp);
+    fill_header(image, stamp);
+    fill_image(image, *img);
+    return to_msg(builder, impl_->max_sz, stamp);
   }
 
+  // ******************
+  // * SnapshotReader *
+  // ******************
+  struct SnapshotReader::Impl {
+    Stills* stills;
+    size_t max_sz;
+  };
+
+  SnapshotReader::SnapshotReader(std::string sensor_name)
+      : Reader(sensor_name), impl_(std::make_unique<Impl>()) {
+    const auto& yml = GlobalParams::get_instance().yml;
+    auto camera = yml[sensor_name_]["camera"].get_value<std::string>();
+    if (!yml.contains(camera) || !yml[camera].contains("snapshot")) {
+      Log::critical("No snapshot branch in " + camera + " for "
+                    + sensor_name_);
+      throw std::runtime_error("No snapshot branch for " + sensor_name_);
+    }
+    const auto& scfg = yml[camera]["snapshot"];
+    impl_->stills = &Stills::get(camera);
+    impl_->max_sz = scfg["width"].get_value<size_t>()
+                    * scfg["height"].get_value<size_t>() * 3;
+    schema_ = Schema::Image;
+  }
+
+  SnapshotReader::~SnapshotReader() {}
+
+  void SnapshotReader::on_open() {
+    // nothing to open, the camera captures the stills
+    mark_ready();
+  }
+
+  void SnapshotReader::on_pause() {
+    // a still taken for nobody is not sent after resume
+    std::lock_guard<std::mutex> lock(impl_->stills->mtx);
+    impl_->stills->image.reset();
+  }
+
+  bool SnapshotReader::set_params(const Params& params) {
+    for (const auto& [key, value] : params) {
+      if (key != "snapshot" || value == 0) {
+        Log::warn("Invalid snapshot param: " + key);
+        return false;
+      }
+    }
+    if (!params.empty()) impl_->stills->request();
+    return true;
+  }
+
+  MsgConstPtr SnapshotReader::read() {
+    if (!opened()) open();
+    if (paused_) return nullptr;
+    camera::Image::ConstPtr img{nullptr};
+    {
+      std::lock_guard<std::mutex> lock(impl_->stills->mtx);
+      img.swap(impl_->stills->image);
+    }
+    if (!img) return nullptr;
+
+    auto builder
+        = capnp::MallocMessageBuilder(img->size + sizeof(camera::Image));
+    auto image = builder.initRoot<Image>();
+    auto stamp = Clock::from_system(img->stamp);
+    fill_header(image, stamp);
+    fill_image(image, *img);
+    return to_msg(builder, impl_->max_sz, stamp);
+  }
 }  // namespace tskpub
\ No newline at end of file
@@ -1,7 +1,24 @@
 #include <capnp/serialize-packed.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <termios.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <optional>
+
+#include "TSKPub/clock.hh"
+#include "TSKPub/imu_history.hh"
 #include "TSKPub/msg/Imu.capnp.h"
+#include "TSKPub/msg/ImuDelta.capnp.h"
 #include "reader/reader.hh"
+#include "reader/serial_hub.hh"
 
 extern "C" {
 #include <imu/hipnuc_dec.h>
@@ -10,96 +27,535 @@ extern "C" {
 
 namespace {
   constexpr static double Gravity = 9.8;
+  // tag of the 0x91 packet, other packets are ignored
+  constexpr static uint8_t HI91 = 0x91;
+  constexpr static double DegToRad = M_PI / 180;
+
+  /// @brief Serial settings besides the baud rate to connect with
+  struct SerialSetup {
+    // written to the device by AT commands, 0 or empty keeps its setting
+    uint64_t baud_rate{0};
+    int odr{0};
+    std::string packets;
+    // ASYNC_LOW_LATENCY, USB adapters stop batching bytes for their timer
+    bool low_latency{false};
+    // bytes that wake the hub thread, 0 wakes it on every byte
+    uint8_t vmin{0};
+
+    bool device() const { return baud_rate || odr || !packets.empty(); }
+  };
+
+  /// @brief Sample kept for preintegration, in SI units
+  struct Sample {
+    // sample time in nanoseconds
+    uint64_t stamp;
+    double acc[3];
+    double gyr[3];
+  };
+
+  // samples between two reads, about 1 s at 400 Hz
+  constexpr static size_t RingSize = 512;
+
+  // Series channels in the order of the Imu message
+  const std::vector<std::string> Channels{
+      "orientation.w", "orientation.x", "orientation.y", "orientation.z",
+      "angularVelocity.x", "angularVelocity.y", "angularVelocity.z",
+      "linearAcceleration.x", "linearAcceleration.y", "linearAcceleration.z"};
 
   struct IMU {
-    using Ptr = std::shared_ptr<IMU>;
+    using Ptr = std::unique_ptr<IMU>;
+
+    using DropCallback = std::function<void(tskpub::DropStage)>;
 
-    IMU(std::string port, uint64_t baud_rate) : fd(-1) {
+    IMU(std::string port, uint64_t baud_rate, const SerialSetup& setup,
+        bool keep_all, tskpub::ImuHistory& history,
+        std::unique_ptr<tskpub::StampFilter> stamps, DropCallback on_drop)
+        : fd(-1),
+          on_drop(std::move(on_drop)),
+          stamps(std::move(stamps)),
+          keep_all(keep_all),
+          history(history) {
       if ((fd = serial_port_open(port.c_str())) < 0
           || serial_port_configure(fd, baud_rate) < 0) {
+        if (fd >= 0) serial_port_close(fd);
         throw std::runtime_error("Failed to open or configure port " + port
                                  + " with " + std::to_string(baud_rate));
       }
 
+      try {
+        configure_device(port, baud_rate, setup);
+      } catch (...) {
+        serial_port_close(fd);
+        throw;
+      }
+
       // Enable data output
-      serial_send_then_recv_str(fd, "AT+EOUT=1\r\n", "OK\r\n", buffer.data(),
-                                buffer.size(), 200);
+      command("AT+EOUT=1");
+      // the answers are read, select() would wait for vmin bytes from now on
+      tune(port, setup);
+
+      // the shared hub thread decodes from now on
+      if (!tskpub::SerialHub::instance().add(
+              fd,
+              [this](const uint8_t* data, size_t size) { input(data, size); },
+              [this] {
+                std::lock_guard<std::mutex> lock(mtx);
+                hung_up = true;
+                cv.notify_one();
+              })) {
+        serial_port_close(fd);
+        throw std::runtime_error("Failed to poll port " + port);
+      }
     }
 
     ~IMU() {
       if (fd >= 0) {
+        tskpub::SerialHub::instance().remove(fd);
         serial_port_close(fd);
       }
     }
 
-    std::vector<double> read() {
-      hipnuc_raw_t hipnuc_raw{0};
-      // Read data from serial port
-      int len = serial_port_read(fd, buffer.data(), buffer.size());
-      if (len <= 0) {
-        return {};
+    /// @brief Send an AT command
+    /// @param cmd Command without line end
+    /// @return false if the device did not answer OK
+    bool command(const std::string& cmd) {
+      auto line = cmd + "\r\n";
+      std::array<uint8_t, 256> buffer;
+      int n = serial_send_then_recv(
+          fd, reinterpret_cast<const uint8_t*>(line.data()), line.size(),
+          buffer.data(), buffer.size(), 100);
+      if (n <= 0) return false;
+      // the answer may follow binary packets still being streamed
+      const char ok[] = "OK";
+      auto end = buffer.begin() + n;
+      return std::search(buffer.begin(), end, ok, ok + 2) != end;
+    }
+
+    /// @brief Write the output rate, the packets and the baud rate of setup
+    ///        to the device. The baud rate goes last, the device answers it
+    ///        at the old rate
+    void configure_device(const std::string& port, uint64_t baud_rate,
+                          const SerialSetup& setup) {
+      if (!setup.device()) return;
+      // stop the output so that the answers are not buried in packets
+      if (!command("AT+EOUT=0")) {
+        // the device still runs at the rate of an earlier start
+        bool switched = setup.baud_rate && setup.baud_rate != baud_rate
+                        && serial_port_configure(fd, setup.baud_rate) == 0
+                        && command("AT+EOUT=0");
+        if (!switched) {
+          serial_port_configure(fd, baud_rate);
+          tskpub::Log::warn("IMU on " + port + " does not answer AT commands");
+          return;
+        }
+        baud_rate = setup.baud_rate;
+      }
+
+      if (setup.odr && !command("AT+ODR=" + std::to_string(setup.odr))) {
+        tskpub::Log::warn("IMU on " + port + " rejected output rate "
+                          + std::to_string(setup.odr));
+      }
+      if (!setup.packets.empty() && !command("AT+SETPTL=" + setup.packets)) {
+        tskpub::Log::warn("IMU on " + port + " rejected packets "
+                          + setup.packets);
       }
+      if (!setup.baud_rate || setup.baud_rate == baud_rate) return;
+      if (!command("AT+BAUD=" + std::to_string(setup.baud_rate))) {
+        tskpub::Log::warn("IMU on " + port + " rejected baud rate "
+                          + std::to_string(setup.baud_rate));
+        return;
+      }
+      if (serial_port_configure(fd, setup.baud_rate) < 0) {
+        throw std::runtime_error("Failed to configure port " + port + " with "
+                                 + std::to_string(setup.baud_rate));
+      }
+      tskpub::Log::info("IMU on " + port + " switched to "
+                        + std::to_string(setup.baud_rate));
+    }
 
-      for (int i = 0; i < len; i++) {
-        if (hipnuc_input(&hipnuc_raw, buffer[i]) <= 0) {
+    /// @brief Host side latency settings of the port
+    void tune(const std::string& port, const SerialSetup& setup) {
+      termios tio;
+      if (tcgetattr(fd, &tio) == 0) {
+        // reads never block, vmin only decides when epoll reports the port
+        tio.c_cc[VMIN] = setup.vmin;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+      }
+      if (!setup.low_latency) return;
+      serial_struct ss;
+      bool ok = ioctl(fd, TIOCGSERIAL, &ss) == 0;
+      if (ok) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        ok = ioctl(fd, TIOCSSERIAL, &ss) == 0;
+      }
+      // ptys and some adapters have no serial driver
+      if (!ok) {
+        tskpub::Log::warn("No low latency mode on " + port + ": "
+                          + std::strerror(errno));
+      }
+    }
+
+    /// @brief Decode bytes from the port, runs on the hub thread. The decoder
+    ///        keeps partial frames between calls
+    void input(const uint8_t* data, size_t size) {
+      for (size_t i = 0; i < size; i++) {
+        auto ret = hipnuc_input(&raw, data[i]);
+        // bad length or checksum
+        if (ret < 0) on_drop(tskpub::DropStage::Decode);
+        if (ret <= 0 || raw.hi91.tag != HI91) continue;
+        const auto& hi91 = raw.hi91;
+        auto stamp = sample_time(hi91);
+        // angular rates for the other readers, e.g. lidar deskew
+        const float gyr[3] = {float(hi91.gyr[0] * DegToRad),
+                              float(hi91.gyr[1] * DegToRad),
+                              float(hi91.gyr[2] * DegToRad)};
+        history.push(stamp, gyr);
+        std::lock_guard<std::mutex> lock(mtx);
+        if (keep_all) {
+          push(hi91, stamp);
           continue;
         }
-        break;
+        // the port is faster than the reader
+        if (fresh) on_drop(tskpub::DropStage::Overwrite);
+        sample_stamp = stamp;
+        sample = {hi91.acc[0] * Gravity,  // 0
+                  hi91.acc[1] * Gravity,
+                  hi91.acc[2] * Gravity,
+                  hi91.gyr[0],  // 3
+                  hi91.gyr[1],
+                  hi91.gyr[2],
+                  hi91.mag[0],  // 6
+                  hi91.mag[1],
+                  hi91.mag[2],
+                  hi91.roll,  // 9
+                  hi91.pitch,
+                  hi91.yaw,
+                  hi91.quat[0],  // 12
+                  hi91.quat[1],
+                  hi91.quat[2],
+                  hi91.quat[3],
+                  hi91.air_pressure};
+        fresh = true;
+        cv.notify_one();
       }
+    }
 
-      auto& hi91 = hipnuc_raw.hi91;
-      return {hi91.acc[0] * Gravity,  // 0
-              hi91.acc[1] * Gravity,
-              hi91.acc[2] * Gravity,
-              hi91.gyr[0],  // 3
-              hi91.gyr[1],
-              hi91.gyr[2],
-              hi91.mag[0],  // 6
-              hi91.mag[1],
-              hi91.mag[2],
-              hi91.roll,  // 9
-              hi91.pitch,
-              hi91.yaw,
-              hi91.quat[0],  // 12
-              hi91.quat[1],
-              hi91.quat[2],
-              hi91.quat[3],
-              hi91.air_pressure};
-    };
+    /// @brief Sample time of a packet that just arrived, on the hub thread
+    uint64_t sample_time(const hi91_t& hi91) {
+      auto mono = tskpub::Clock::mono_now();
+      if (stamps) {
+        // the device counts milliseconds in 32 bits
+        ticks += uint32_t(hi91.system_time - tick);
+        tick = hi91.system_time;
+        mono = stamps->update(mono, ticks * 1000000);
+      }
+      return tskpub::Clock::to_wall(mono);
+    }
 
-    int fd;
-    std::array<char, 1024> buffer;
-  };
+    /// @brief Append a sample to the ring, mtx is held
+    void push(const hi91_t& hi91, uint64_t stamp) {
+      // the reader is too slow, the oldest sample is lost
+      if (count == ring.size()) {
+        on_drop(tskpub::DropStage::Overwrite);
+        head = (head + 1) % ring.size();
+        count--;
+      }
+      auto& s = ring[(head + count++) % ring.size()];
+      s.stamp = stamp;
+      for (int i = 0; i < 3; i++) {
+        s.acc[i] = hi91.acc[i] * Gravity;
+        s.gyr[i] = hi91.gyr[i] * DegToRad;
+      }
+      cv.notify_one();
+    }
 
-  IMU::Ptr imu{nullptr};
+    /// @brief Take the oldest samples of the ring, in keep_all mode
+    /// @param out Output
+    /// @param max Size of out
+    /// @param timeout Maximum time to wait for a sample
+    /// @return Number of samples, 0 on timeout or after a hang-up
+    size_t take(Sample* out, size_t max, std::chrono::milliseconds timeout) {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (!cv.wait_for(lock, timeout,
+                       [this] { return count > 0 || hung_up; })) {
+        return 0;
+      }
+      size_t n = std::min(max, count);
+      for (size_t i = 0; i < n; i++) out[i] = ring[(head + i) % ring.size()];
+      head = (head + n) % ring.size();
+      count -= n;
+      return n;
+    }
 
+    /// @brief Latest sample not read yet
+    /// @param timeout Maximum time to wait for a new sample
+    /// @param stamp Sample time in nanoseconds
+    /// @return Empty on timeout or after a hang-up
+    std::vector<double> read(std::chrono::milliseconds timeout,
+                             uint64_t& stamp) {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (!cv.wait_for(lock, timeout, [this] { return fresh || hung_up; })
+          || !fresh) {
+        return {};
+      }
+      fresh = false;
+      stamp = sample_stamp;
+      return sample;
+    }
+
+    /// @brief Whether the port hung up
+    bool lost() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return hung_up;
+    }
+
+    int fd;
+    // counts discarded samples, called on the hub thread
+    DropCallback on_drop;
+    // decoder state, only touched by the hub thread
+    hipnuc_raw_t raw{};
+    // sample times from the device clock, nullptr keeps the arrival times
+    std::unique_ptr<tskpub::StampFilter> stamps;
+    uint32_t tick{0};
+    uint64_t ticks{0};
+
+    // latest decoded sample
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<double> sample;
+    uint64_t sample_stamp{0};
+    bool fresh{false};
+    // the port hung up and is no longer polled, the device must be reopened
+    bool hung_up{false};
+    // every sample goes to the ring instead, for preintegration
+    const bool keep_all;
+    std::array<Sample, RingSize> ring;
+    size_t head{0}, count{0};
+    // recent angular rates, written without the lock
+    tskpub::ImuHistory& history;
+  };
 }  // namespace
 
 namespace tskpub {
-  IMUReader::IMUReader(std::string sensor_name) : Reader(sensor_name) {}
+  struct IMUReader::Impl {
+    // device, only opened and closed on the reading thread after open()
+    IMU::Ptr imu{nullptr};
+    // wait at most one period for a new sample
+    std::chrono::milliseconds timeout{10};
+    // device and latency settings
+    SerialSetup setup;
+    // sample time estimation, empty keeps the arrival times
+    std::optional<StampFilter::Params> stamps{StampFilter::Params{}};
+
+    // preintegration, nullptr publishes the latest sample instead
+    std::unique_ptr<Preintegrator> pre{nullptr};
+    // longest delta in nanoseconds
+    uint64_t interval{100000000};
+    // capture times of the anchor sensor, nullptr for a fixed period
+    const ReadCounter* anchor{nullptr};
+    // channel values of a Series sample, reused at the sample rate
+    std::vector<double> values;
+    // samples not integrated yet, they may lie after the next anchor
+    std::array<Sample, RingSize> pending;
+    size_t npending{0};
+
+    /// @brief Integrate the pending samples up to the end of the delta: the
+    ///        next anchor, or the longest delta without one
+    /// @return true if pre holds a finished delta
+    bool integrate();
+  };
+
+  bool IMUReader::Impl::integrate() {
+    npending += imu->take(pending.data() + npending,
+                          pending.size() - npending, timeout);
+    if (npending == 0) return false;
+    size_t i = 0;
+    // the first sample only starts the delta
+    if (pre->delta().start == 0) pre->reset(pending[i++].stamp);
+    const auto& d = pre->delta();
+    auto newest = pending[npending - 1].stamp;
+    bool full = npending == pending.size();
+    auto end = d.start + interval;
+    if (anchor) {
+      auto a = anchor->stamp.load(std::memory_order_relaxed);
+      if (a > d.end && a < end) {
+        end = a;
+      } else if (newest < end && !full) {
+        // the next anchor may still come before the pending samples
+        std::copy(pending.begin() + i, pending.begin() + npending,
+                  pending.begin());
+        npending -= i;
+        return false;
+      }
+    }
+    // the reader fell behind, close the delta early
+    if (full) end = std::min(end, newest);
 
-  IMUReader::~IMUReader() {
-    if (imu) imu.reset();
+    bool done = false;
+    for (; i < npending; i++) {
+      const auto& s = pending[i];
+      if (s.stamp >= end) {
+        // split at the end, the rest goes to the next delta
+        pre->integrate(s.acc, s.gyr, end);
+        done = true;
+        break;
+      }
+      pre->integrate(s.acc, s.gyr, s.stamp);
+    }
+    std::copy(pending.begin() + i, pending.begin() + npending,
+              pending.begin());
+    npending -= i;
+    return done;
   }
 
+  IMUReader::IMUReader(std::string sensor_name)
+      : Reader(sensor_name), impl_(std::make_unique<Impl>()) {
+    auto& params = GlobalParams::get_instance().yml[sensor_name_];
+    if (params.contains("rate")) {
+      impl_->timeout = std::chrono::milliseconds(
+          std::max(1, int(1e3 / params["rate"].get_value<double>())));
+    }
+
+    auto& setup = impl_->setup;
+    if (params.contains("device")) {
+      const auto& dcfg = params["device"];
+      if (dcfg.contains("baud_rate"))
+        setup.baud_rate = dcfg["baud_rate"].get_value<uint64_t>();
+      if (dcfg.contains("odr")) setup.odr = dcfg["odr"].get_value<int>();
+      if (dcfg.contains("packets"))
+        setup.packets = dcfg["packets"].get_value<std::string>();
+    }
+    if (params.contains("low_latency"))
+      setup.low_latency = params["low_latency"].get_value<bool>();
+    if (params.contains("vmin")) {
+      auto vmin = params["vmin"].get_value<int>();
+      if (vmin < 0 || vmin > 255) {
+        Log::critical("Invalid vmin for " + sensor_name_);
+        throw std::runtime_error("Invalid vmin for " + sensor_name_);
+      }
+      setup.vmin = vmin;
+    }
+
+    if (params.contains("stamp_filter")) {
+      const auto& scfg = params["stamp_filter"];
+      if (scfg.is_boolean()) {
+        if (!scfg.get_value<bool>()) impl_->stamps.reset();
+      } else {
+        auto& sp = *impl_->stamps;
+        if (scfg.contains("window")) {
+          auto window = scfg["window"].get_value<int>();
+          if (window < 2) {
+            Log::critical("Invalid stamp filter window for " + sensor_name_);
+            throw std::runtime_error("Invalid stamp filter window for "
+                                     + sensor_name_);
+          }
+          sp.window = window;
+          sp.warmup = std::min(sp.warmup, sp.window);
+        }
+        if (scfg.contains("max_delay")) {
+          sp.max_delay
+              = uint64_t(scfg["max_delay"].get_value<double>() * 1e9);
+        }
+      }
+    }
+
+    if (params.contains("preintegration")) {
+      const auto& pcfg = params["preintegration"];
+      ImuNoise noise;
+      if (pcfg.contains("gyro_noise"))
+        noise.gyro = pcfg["gyro_noise"].get_value<double>();
+      if (pcfg.contains("acc_noise"))
+        noise.acc = pcfg["acc_noise"].get_value<double>();
+      double interval = 0.1;
+      if (pcfg.contains("anchor")) {
+        impl_->anchor
+            = &ReadStats::counter(pcfg["anchor"].get_value<std::string>());
+        // only a fallback for a silent anchor sensor
+        interval = 1;
+      }
+      if (pcfg.contains("interval"))
+        interval = pcfg["interval"].get_value<double>();
+      // the pending samples must cover the longest delta
+      if (interval <= 0 || interval > 1) {
+        Log::critical("Invalid preintegration interval for " + sensor_name_);
+        throw std::runtime_error("Invalid preintegration interval for "
+                                 + sensor_name_);
+      }
+      impl_->interval = uint64_t(interval * 1e9);
+      impl_->pre = std::make_unique<Preintegrator>(noise);
+      schema_ = Schema::ImuDelta;
+    }
+
+    init_series();
+    if (series_ && impl_->pre) {
+      Log::critical("Gorilla encoding and preintegration for " + sensor_name_);
+      throw std::runtime_error("Gorilla encoding and preintegration for "
+                               + sensor_name_);
+    }
+  }
+
+  IMUReader::~IMUReader() {}
+
   void IMUReader::open_device() {
     auto params = GlobalParams::get_instance().yml[sensor_name_];
-    imu = std::make_shared<IMU>(params["port"].get_value<std::string>(),
-                                params["baud_rate"].get_value<uint64_t>());
+    impl_->imu = std::make_unique<IMU>(
+        params["port"].get_value<std::string>(),
+        params["baud_rate"].get_value<uint64_t>(), impl_->setup,
+        impl_->pre != nullptr, ImuHistory::get(sensor_name_),
+        impl_->stamps ? std::make_unique<StampFilter>(*impl_->stamps) : nullptr,
+        [this](DropStage stage) { drop(stage); });
   }
 
+  void IMUReader::on_open() { open_device(); }
+
   MsgConstPtr IMUReader::read() {
-    if (!imu) open_device();
-    auto data = imu->read();
-    return data.empty() ? nullptr : package_data(data);
+    if (!opened()) open();
+    if (paused_) {
+      // close the port on the reading thread, reopened on the next read
+      impl_->imu.reset();
+      // the next delta starts after the gap
+      if (impl_->pre) impl_->pre->reset(0);
+      impl_->npending = 0;
+      return nullptr;
+    }
+    if (impl_->imu && impl_->imu->lost()) {
+      Log::warn("Reopen " + sensor_name_ + " after the port hung up");
+      impl_->imu.reset();
+      if (impl_->pre) impl_->pre->reset(0);
+      impl_->npending = 0;
+    }
+    if (!impl_->imu) open_device();
+    if (impl_->pre) {
+      if (!impl_->integrate()) return nullptr;
+      mark_ready();
+      auto msg = package_delta(impl_->pre->delta());
+      impl_->pre->reset(impl_->pre->delta().end);
+      return msg;
+    }
+    uint64_t stamp;
+    auto data = impl_->imu->read(impl_->timeout, stamp);
+    if (data.empty()) return nullptr;
+    mark_ready();
+    if (series_) {
+      if (!stamp) stamp = nano_now();
+      // rounded like the Imu fields, the low mantissa bits stay zero
+      auto& values = impl_->values;
+      values.clear();
+      for (auto i : {12, 13, 14, 15, 3, 4, 5, 0, 1, 2})
+        values.push_back(float(data[i]));
+      return package_series(Channels, values, stamp);
+    }
+    return package_data(data, stamp);
   }
 
-  MsgPtr IMUReader::package_data(const std::vector<double>& data) {
+  MsgPtr IMUReader::package_data(const std::vector<double>& data,
+                                 uint64_t stamp) {
     // build capnp message
     capnp::MallocMessageBuilder message{1024};
     auto imu = message.initRoot<Imu>();
-    imu.setTopic(topic_);
-    imu.setTimestamp(nano_now());
+    if (!stamp) stamp = nano_now();
+    fill_header(imu, stamp);
     auto linear_acceleration = imu.initLinearAcceleration();
     linear_acceleration.setX(data[0]);
     linear_acceleration.setY(data[1]);
@@ -113,6 +569,36 @@ namespace tskpub {
     orientation.setX(data[13]);
     orientation.setY(data[14]);
     orientation.setZ(data[15]);
-    return to_msg(message, 1024);
+    return to_msg(message, 1024, stamp);
+  }
+
+  MsgPtr IMUReader::package_delta(const ImuDelta& delta) {
+    capnp::MallocMessageBuilder message{1024};
+    auto msg = message.initRoot<::ImuDelta>();
+    // stamped at the end, the anchor time
+    fill_header(msg, delta.end);
+    msg.setStartTime(delta.start);
+    msg.setSamples(delta.samples);
+    auto rotation = msg.initRotation();
+    rotation.setW(delta.rotation[0]);
+    rotation.setX(delta.rotation[1]);
+    rotation.setY(delta.rotation[2]);
+    rotation.setZ(delta.rotation[3]);
+    auto velocity = msg.initVelocity();
+    velocity.setX(delta.velocity[0]);
+    velocity.setY(delta.velocity[1]);
+    velocity.setZ(delta.velocity[2]);
+    auto position = msg.initPosition();
+    position.setX(delta.position[0]);
+    position.setY(delta.position[1]);
+    position.setZ(delta.position[2]);
+    // upper triangle, row by row
+    auto covariance = msg.initCovariance(45);
+    unsigned k = 0;
+    for (int i = 0; i < 9; i++) {
+      for (int j = i; j < 9; j++)
+        covariance.set(k++, delta.covariance[i * 9 + j]);
+    }
+    return to_msg(message, 1024, delta.end);
   }
 }  // namespace tskpub
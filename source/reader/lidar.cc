@@ -1,18 +1,173 @@
+#include <TSKPub/msg/OctreeCloud.capnp.h>
+#include <TSKPub/clock.hh>
+#include <TSKPub/crop.hh>
+#include <TSKPub/deskew.hh>
+#include <TSKPub/executor.hh>
+#include <TSKPub/lod.hh>
 #include <TSKPub/msg/PointCloud.capnp.h>
+#include <TSKPub/msg/RangeImage.capnp.h>
+#include <TSKPub/octree.hh>
+#include <TSKPub/range_image.hh>
 #include <capnp/serialize-packed.h>
 #include <pcl/filters/random_sample.h>
+#include <pcl/filters/voxel_grid.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
 #include <xtsdk/utils.h>
 #include <xtsdk/xtsdk.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
+#include "reader/pipeline.hh"
 #include "reader/reader.hh"
 
 namespace {
   using PointT = pcl::PointXYZI;
   using Cld = pcl::PointCloud<PointT>;
+  using CldStage = tskpub::Stage<Cld::Ptr>;
+  using CldStageFactory = tskpub::StageFactory<Cld::Ptr>;
+
+  /// @brief Keep a fixed number of random points
+  class RandomSampleStage final : public CldStage {
+  public:
+    explicit RandomSampleStage(size_t size) { sampler_.setSample(size); }
+
+    bool process(Cld::Ptr &cld) override {
+      Cld::Ptr ret(new Cld);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ret->reserve(sampler_.getSample());
+        sampler_.setInputCloud(cld);
+        sampler_.filter(*ret);
+      }
+      ret->header = cld->header;
+      cld.swap(ret);
+      return true;
+    }
+
+    bool accepts(const std::string &key, double value) const override {
+      return key == "cloud_size" && value > 0;
+    }
+
+    void set_param(const std::string &, double value) override {
+      std::lock_guard<std::mutex> lock(mtx_);
+      sampler_.setSample(value);
+    }
+
+  private:
+    pcl::RandomSample<PointT> sampler_;
+    std::mutex mtx_;
+  };
+
+  /// @brief Keep the centroid of the points in every voxel
+  class VoxelGridStage final : public CldStage {
+  public:
+    explicit VoxelGridStage(float leaf) { set_leaf(leaf); }
+
+    bool process(Cld::Ptr &cld) override {
+      Cld::Ptr ret(new Cld);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        grid_.setInputCloud(cld);
+        grid_.filter(*ret);
+      }
+      ret->header = cld->header;
+      cld.swap(ret);
+      return true;
+    }
+
+    bool accepts(const std::string &key, double value) const override {
+      return key == "voxel_leaf" && value > 0;
+    }
+
+    void set_param(const std::string &, double value) override {
+      std::lock_guard<std::mutex> lock(mtx_);
+      set_leaf(value);
+    }
+
+  private:
+    void set_leaf(float leaf) { grid_.setLeafSize(leaf, leaf, leaf); }
+
+    pcl::VoxelGrid<PointT> grid_;
+    std::mutex mtx_;
+  };
+
+  /// @brief Undo the rotation of the sensor while the frame is captured,
+  ///        with the angular rates of an IMU. The capture time of a point
+  ///        over the window ending at the frame time comes from the position
+  ///        the crop stored in it, so the stage goes before the ones that
+  ///        merge points
+  class DeskewStage final : public CldStage {
+  public:
+    DeskewStage(const std::string &imu, double window, size_t slices)
+        : history_(tskpub::ImuHistory::get(imu)),
+          window_(window * 1e9),
+          slices_(slices),
+          rotations_(slices * 9) {}
+
+    bool process(Cld::Ptr &cld) override {
+      if (cld->empty()) return true;
+      const uint64_t end = cld->header.stamp, start = end - window_;
+      auto n = history_.copy(start, end, rates_.data(), rates_.size());
+      if (n == 0) {
+        // published as it is, e.g. the lidar clock is not the host clock
+        if (!warned_) {
+          tskpub::Log::warn("No IMU rates for the lidar frame, not deskewed");
+          warned_ = true;
+        }
+        return true;
+      }
+      tskpub::deskew_rotations(rates_.data(), n, start, end, slices_,
+                               rotations_.data());
+      tskpub::rotate_points(cld->points.data(), cld->size(),
+                            rotations_.data(), slices_);
+      return true;
+    }
+
+  private:
+    const tskpub::ImuHistory &history_;
+    // capture window in nanoseconds
+    const uint64_t window_;
+    const size_t slices_;
+    // only touched by process(), one frame at a time
+    std::array<tskpub::RateSample, tskpub::ImuHistory::Capacity> rates_;
+    std::vector<float> rotations_;
+    bool warned_{false};
+  };
+
+  // stages for the pipeline of the lidar config
+  const bool stages_registed
+      = CldStageFactory::regist(
+            "random_sample",
+            [](const fkyaml::node &cfg) -> CldStage::Ptr {
+              auto size = cfg["size"].get_value<size_t>();
+              if (size == 0) throw std::runtime_error("Invalid sample size");
+              return std::make_unique<RandomSampleStage>(size);
+            })
+        && CldStageFactory::regist(
+            "voxel_grid", [](const fkyaml::node &cfg) -> CldStage::Ptr {
+              auto leaf = cfg["leaf"].get_value<float>();
+              if (leaf <= 0) throw std::runtime_error("Invalid voxel leaf");
+              return std::make_unique<VoxelGridStage>(leaf);
+            })
+        && CldStageFactory::regist(
+            "deskew", [](const fkyaml::node &cfg) -> CldStage::Ptr {
+              auto window = cfg["window"].get_value<double>();
+              size_t slices = 32;
+              if (cfg.contains("slices"))
+                slices = cfg["slices"].get_value<size_t>();
+              if (window <= 0 || slices == 0)
+                throw std::runtime_error("Invalid deskew window");
+              return std::make_unique<DeskewStage>(
+                  cfg["imu"].get_value<std::string>(), window, slices);
+            });
 
   // config struct from xtsdk
   struct DeviceParams {
@@ -49,6 +204,26 @@ namespace {
     DeviceParams device;
     FilterParams filter;
   };
+
+  /// @brief Fill the points of a PointCloud message
+  void fill_points(PointCloud::Builder &msg, const PointT *pts, size_t n) {
+    auto points = msg.initPoints(n);
+    for (size_t i = 0; i < n; i++) {
+      points[i].setX(pts[i].x);
+      points[i].setY(pts[i].y);
+      points[i].setZ(pts[i].z);
+      points[i].setI(pts[i].intensity);
+    }
+  }
+
+  /// @brief Packed size of a message around n bytes of data without zero
+  ///        bytes, e.g. octree occupancy or compressed images: every run of
+  ///        up to 256 such words costs 2 bytes, plus the struct and
+  ///        pointer words
+  size_t packed_bound(size_t n) {
+    const size_t words = n / sizeof(capnp::word) + 32;
+    return words * sizeof(capnp::word) + (words / 255 + 1) * 2;
+  }
 }  // namespace
 
 namespace tskpub {
@@ -63,11 +238,48 @@ namespace tskpub {
     // port to connect
     std::string port;
 
+    // guards xtsdk creation against pause and resume from other threads
+    std::mutex smtx;
+    std::atomic<bool> paused{false};
+
     // lidar params
     Params params;
 
-    // downsample filter
-    pcl::RandomSample<PointT> sampler;
+    // NaN, range and intensity filter
+    CropParams crop;
+
+    // stages between the crop and the encoding
+    std::unique_ptr<Pipeline<Cld::Ptr>> pipeline{nullptr};
+
+    // octree coding of the full cloud instead of downsampling
+    std::unique_ptr<OctreeEncoder> octree{nullptr};
+    OctreeParams octree_params;
+    OctreeFrame frame;
+
+    // startup phases and the first frame, forwarded to the reader
+    std::function<void(const std::string &)> on_phase;
+    std::function<void()> on_frame;
+    // discarded frames, forwarded to the reader counters
+    std::function<void(DropStage)> on_drop;
+
+    // level of detail layers of the full cloud instead of downsampling,
+    // the messages of the layers after the first wait for refinements().
+    // Only touched by read() and refinements(), which are not concurrent
+    std::unique_ptr<LodSplitter> lod{nullptr};
+    Cld::VectorType layered;
+    uint32_t lod_frame{0};
+    std::vector<MsgConstPtr> layers;
+
+    // organized range image instead of a point list
+    std::unique_ptr<RangeImage> range{nullptr};
+    Compressor::Ptr range_compressor{nullptr};
+    Msg planes;
+
+    // latest frame waiting for the executor, at most one task per lidar
+    std::shared_ptr<XinTan::Frame> pending{nullptr};
+    bool processing{false};
+    std::mutex fmtx;
+    std::condition_variable idle;
 
     ~Impl() {
       // stop xtsdk
@@ -76,27 +288,41 @@ namespace tskpub {
         xtsdk->setCallback();
         xtsdk->shutdown();
       }
+      // the task refers to this object
+      std::unique_lock<std::mutex> lock(fmtx);
+      idle.wait(lock, [this] { return !processing; });
+      // async stages call back into the members below
+      pipeline.reset();
     }
 
     // copy from sdk_example.cpp
     void eventCallback(const std::shared_ptr<XinTan::CBEventData> &event);
 
-    // downsample and filter point cloud
+    // hand the frame over to the shared executor
     void imgCallback(const std::shared_ptr<XinTan::Frame> &imgframe);
 
+    // process the pending frames, runs on the executor
+    void process_pending();
+
+    // convert and crop point cloud, then run the pipeline
+    void process(const std::shared_ptr<XinTan::Frame> &imgframe);
+
+    // output of the pipeline, replaces the unread cloud
+    void store(Cld::Ptr &&ret);
+
     // init xtsdk
     void init();
 
-    // read point cloud
+    // set the sdk filters of flt, the sdk filters run on the host so no
+    // reconnection is needed
+    void apply_filter(const FilterParams &flt);
+
+    // take the latest cloud, nullptr until the next frame
     Cld::ConstPtr read() {
-      if (!xtsdk) init();
-      static Cld::Ptr prev_cld = nullptr;
-      if (cld == prev_cld) {
-        return nullptr;
-      }
       std::lock_guard<std::mutex> lock(cmtx);
-      prev_cld.swap(cld);
-      return cld;
+      Cld::Ptr ret{nullptr};
+      ret.swap(cld);
+      return ret;
     }
   };
 
@@ -114,6 +340,7 @@ namespace tskpub {
         Log::debug(devinfo.fwVersion.c_str());
         Log::debug(devinfo.sn.c_str() + devinfo.chipidStr);
         Log::debug("DEV SN=" + devinfo.sn);
+        on_phase("handshake");
 
         xtsdk->setModFreq(
             (XinTan::ModulationFreq)params.device.frequency_modulation);
@@ -123,7 +350,8 @@ namespace tskpub {
         xtsdk->setMinAmplitude(params.device.minLSB);
         xtsdk->setMaxFps(params.device.maxfps);
         xtsdk->setCutCorner(params.device.cut_corner);
-        xtsdk->start((XinTan::ImageType)params.device.imgType);
+        // a paused reader starts streaming on resume
+        if (!paused) xtsdk->start((XinTan::ImageType)params.device.imgType);
       }
       Log::debug("sdkstate= " + xtsdk->getStateStr());
     } else if (event->eventstr == "devState") {
@@ -142,35 +370,89 @@ namespace tskpub {
 
   void LidarReader::Impl::imgCallback(
       const std::shared_ptr<XinTan::Frame> &imgframe) {
+    // the sdk thread only queues, filtering runs on an idle core
+    {
+      std::lock_guard<std::mutex> lock(fmtx);
+      if (pending) on_drop(DropStage::Overwrite);
+      pending = imgframe;
+      if (processing) return;
+      processing = true;
+    }
+    Executor::shared().submit([this] { process_pending(); });
+  }
+
+  void LidarReader::Impl::process_pending() {
+    while (true) {
+      std::shared_ptr<XinTan::Frame> frame{nullptr};
+      {
+        std::lock_guard<std::mutex> lock(fmtx);
+        if (!pending) {
+          processing = false;
+          idle.notify_all();
+          return;
+        }
+        frame.swap(pending);
+      }
+      // an escaping exception would leave processing set forever
+      try {
+        process(frame);
+      } catch (const std::exception &e) {
+        on_drop(DropStage::Read);
+        Log::error(std::string("Lidar frame failed: ") + e.what());
+      }
+    }
+  }
+
+  void LidarReader::Impl::process(
+      const std::shared_ptr<XinTan::Frame> &imgframe) {
     if (imgframe->points.empty()) {
+      std::lock_guard<std::mutex> lock(cmtx);
+      if (cld) on_drop(DropStage::Overwrite);
       cld.reset();
       return;
     }
 
-    // filter out nan points
+    const auto &pts = imgframe->points;
+    // sdk stamps are taken as system clock times
+    const auto stamp = Clock::from_system(imgframe->timeStampS * 1000000000ull
+                                          + imgframe->timeStampNS);
+    if (range) {
+      // keep the frame organized, NaN marks pixels without return
+      Cld::Ptr ret(new Cld(imgframe->width, imgframe->height));
+      if (ret->size() != pts.size()) {
+        Log::warn("Lidar frame size mismatch, dropped");
+        on_drop(DropStage::Decode);
+        return;
+      }
+      for (size_t i = 0; i < pts.size(); i++) {
+        auto &p = ret->points[i];
+        p.x = pts[i].x;
+        p.y = pts[i].y;
+        p.z = pts[i].z;
+        p.intensity = pts[i].intensity;
+      }
+      ret->header.stamp = stamp;
+      store(std::move(ret));
+      return;
+    }
+
+    // filter and convert in one pass
     Cld::Ptr filtered{new Cld};
-    filtered->reserve(imgframe->points.size());
-    std::for_each(imgframe->points.begin(), imgframe->points.end(),
-                  [&filtered](const XinTan::XtPointXYZI &p) {
-                    if (std::isnan(p.x) || std::isnan(p.y) || std::isnan(p.z))
-                      return;
-                    PointT pt;
-                    pt.x = p.x;
-                    pt.y = p.y;
-                    pt.z = p.z;
-                    pt.intensity = p.intensity;
-                    filtered->push_back(pt);
-                  });
-
-    // downsample
-    Cld::Ptr ret(new Cld);
-    ret->resize(sampler.getSample());
-    ret->header.stamp = imgframe->timeStampS * 1e9 + imgframe->timeStampNS;
-    sampler.setInputCloud(filtered);
-    sampler.filter(*ret);
-
-    std::lock_guard<std::mutex> lock(cmtx);
-    cld.swap(ret);
+    filtered->resize(pts.size());
+    filtered->resize(
+        crop_points(pts.data(), pts.size(), crop, filtered->points.data()));
+    filtered->header.stamp = stamp;
+    pipeline->push(std::move(filtered));
+  }
+
+  void LidarReader::Impl::store(Cld::Ptr &&ret) {
+    {
+      std::lock_guard<std::mutex> lock(cmtx);
+      cld.swap(ret);
+    }
+    // read() takes the cloud, so ret is an unread one
+    if (ret) on_drop(DropStage::Overwrite);
+    on_frame();
   }
 
   void LidarReader::Impl::init() {
@@ -187,6 +469,11 @@ namespace tskpub {
         static_cast<XinTan::ClOUDCOORD_TYPE>(dev.cloud_coord));
     xtsdk->setCallback([this](auto event) { eventCallback(event); },
                        [this](auto frame) { imgCallback(frame); });
+    apply_filter(flt);
+    xtsdk->startup();
+  }
+
+  void LidarReader::Impl::apply_filter(const FilterParams &flt) {
     if (flt.edgeEnable) xtsdk->setSdkEdgeFilter(flt.edgeThreshold);
     if (flt.kalmanEnable)  // 卡尔曼滤波
       xtsdk->setSdkKalmanFilter(flt.kalmanFactor * 1000, flt.kalmanThreshold,
@@ -195,7 +482,6 @@ namespace tskpub {
       xtsdk->setSdkMedianFilter(flt.medianSize);
     if (flt.dustEnable)  // 尘点滤波
       xtsdk->setSdkDustFilter(flt.dustThreshold, flt.dustFrames);
-    xtsdk->startup();
   }
 
   LidarReader::LidarReader(std::string sensor_name)
@@ -232,13 +518,218 @@ namespace tskpub {
 
     auto &cfg = GlobalParams::get_instance().yml[sensor_name];
     impl_->port = cfg["port"].get_value<std::string>();
-    // the size of the downsampled cloud
-    impl_->sampler.setSample(cfg["cloud_size"].get_value<size_t>());
+    impl_->on_phase = [this](const std::string &p) { startup_phase(p); };
+    impl_->on_frame = [this] { mark_ready(); };
+    impl_->on_drop = [this](DropStage stage) { drop(stage); };
+
+    // optional crop box, range shell and intensity thresholds
+    if (cfg.contains("crop")) {
+      const auto &ccfg = cfg["crop"];
+      auto &crop = impl_->crop;
+      auto get = [&ccfg](const char *key, float &v) {
+        if (ccfg.contains(key)) v = ccfg[key].get_value<float>();
+      };
+      get("min_range", crop.min_range);
+      get("max_range", crop.max_range);
+      get("min_intensity", crop.min_intensity);
+      get("max_intensity", crop.max_intensity);
+      // box corners as [x, y, z]
+      for (size_t i = 0; i < 3; i++) {
+        if (ccfg.contains("min"))
+          crop.min[i] = ccfg["min"][i].get_value<float>();
+        if (ccfg.contains("max"))
+          crop.max[i] = ccfg["max"][i].get_value<float>();
+      }
+    }
+
+    auto encoding = cfg.contains("encoding")
+                        ? cfg["encoding"].get_value<std::string>()
+                        : std::string("points");
+    // optional octree encoding
+    if (encoding == "octree") {
+      auto &op = impl_->octree_params;
+      bool valid = true;
+      if (cfg.contains("octree")) {
+        const auto &ocfg = cfg["octree"];
+        if (ocfg.contains("resolution"))
+          op.resolution = ocfg["resolution"].get_value<float>();
+        if (ocfg.contains("range"))
+          op.range = ocfg["range"].get_value<float>();
+        if (ocfg.contains("max_intensity"))
+          op.max_intensity = ocfg["max_intensity"].get_value<float>();
+        if (ocfg.contains("keyframe_interval"))
+          op.keyframe_interval = ocfg["keyframe_interval"].get_value<int>();
+        if (ocfg.contains("intensity_threshold"))
+          op.intensity_threshold = ocfg["intensity_threshold"].get_value<int>();
+        if (ocfg.contains("reference")) {
+          auto ref = ocfg["reference"].get_value<std::string>();
+          if (ref == "keyframe") {
+            op.reference = OctreeParams::Reference::Keyframe;
+          } else {
+            valid = ref == "previous";
+          }
+        }
+      }
+      if (!valid || op.resolution <= 0 || op.range <= 0
+          || op.max_intensity <= 0) {
+        Log::critical("Invalid octree params for " + sensor_name);
+        throw std::runtime_error("Invalid octree params for " + sensor_name);
+      }
+      impl_->octree = std::make_unique<OctreeEncoder>(op);
+      schema_ = Schema::OctreeCloud;
+    }
+
+    // optional range image encoding
+    if (encoding == "range_image") {
+      impl_->range = std::make_unique<RangeImage>();
+      schema_ = Schema::RangeImage;
+      auto &img = *impl_->range;
+      CompressParams cp;
+      cp.algo = "zstd";
+      cp.level = 1;
+      if (cfg.contains("range_image")) {
+        const auto &rcfg = cfg["range_image"];
+        auto get = [&rcfg](const char *key, float &v) {
+          if (rcfg.contains(key)) v = rcfg[key].get_value<float>();
+        };
+        // intrinsics are fitted from the first frame if not given
+        get("fx", img.intrinsics.fx);
+        get("fy", img.intrinsics.fy);
+        get("cx", img.intrinsics.cx);
+        get("cy", img.intrinsics.cy);
+        get("depth_scale", img.depth_scale);
+        get("max_intensity", img.max_intensity);
+        if (rcfg.contains("algo"))
+          cp.algo = rcfg["algo"].get_value<std::string>();
+        if (rcfg.contains("level")) cp.level = rcfg["level"].get_value<int>();
+      }
+      impl_->range_compressor = CompressorFactory::create(cp);
+      if (!impl_->range_compressor || img.depth_scale <= 0
+          || img.max_intensity <= 0) {
+        Log::critical("Invalid range image params for " + sensor_name);
+        throw std::runtime_error("Invalid range image params for "
+                                 + sensor_name);
+      }
+    }
+
+    // optional level of detail layers
+    if (encoding == "lod") {
+      LodParams lp;
+      int layers = lp.layers;
+      if (cfg.contains("lod")) {
+        const auto &lcfg = cfg["lod"];
+        if (lcfg.contains("layers")) layers = lcfg["layers"].get_value<int>();
+        if (lcfg.contains("stride"))
+          lp.stride = lcfg["stride"].get_value<uint32_t>();
+      }
+      if (layers < 1 || layers > 8 || lp.stride < 2) {
+        Log::critical("Invalid lod params for " + sensor_name);
+        throw std::runtime_error("Invalid lod params for " + sensor_name);
+      }
+      lp.layers = layers;
+      impl_->lod = std::make_unique<LodSplitter>(lp);
+    }
+
+    // stages between the crop and the encoding, the range image keeps the
+    // organized frame and skips them
+    auto &impl = *impl_;
+    impl.pipeline = std::make_unique<Pipeline<Cld::Ptr>>(
+        [&impl](Cld::Ptr &&ret) { impl.store(std::move(ret)); },
+        [&impl](DropStage stage) { impl.on_drop(stage); });
+    if (cfg.contains("pipeline")) {
+      try {
+        impl.pipeline->load(cfg["pipeline"]);
+      } catch (const std::exception &e) {
+        Log::critical("Invalid pipeline for " + sensor_name + ": " + e.what());
+        throw std::runtime_error("Invalid pipeline for " + sensor_name);
+      }
+    } else if (!impl.octree && !impl.lod) {
+      // the octree and the layers keep the density, the point list is
+      // downsampled
+      size_t size = 5000;
+      if (cfg.contains("cloud_size")) {
+        size = cfg["cloud_size"].get_value<size_t>();
+      }
+      impl.pipeline->add(std::make_unique<RandomSampleStage>(size));
+    }
   }
 
   LidarReader::~LidarReader() {}
 
+  void LidarReader::on_open() {
+    // the handshake and the first frame follow in the sdk callbacks
+    std::lock_guard<std::mutex> lock(impl_->smtx);
+    if (!impl_->xtsdk) impl_->init();
+  }
+
+  void LidarReader::on_pause() {
+    std::lock_guard<std::mutex> lock(impl_->smtx);
+    impl_->paused = true;
+    // keep the connection, only stop streaming
+    if (impl_->xtsdk && impl_->xtsdk->isconnect()) impl_->xtsdk->stop();
+  }
+
+  void LidarReader::on_resume() {
+    std::lock_guard<std::mutex> lock(impl_->smtx);
+    impl_->paused = false;
+    if (impl_->xtsdk && impl_->xtsdk->isconnect()) {
+      impl_->xtsdk->start(
+          static_cast<XinTan::ImageType>(impl_->params.device.imgType));
+    }
+  }
+
+  bool LidarReader::set_params(const Params &params) {
+    std::lock_guard<std::mutex> lock(impl_->smtx);
+    // validate everything on a copy first
+    auto flt = impl_->params.filter;
+    // applied to the pipeline stages after the whole set is checked
+    Params stage_params;
+    for (const auto &[key, value] : params) {
+      if (impl_->pipeline->accepts(key, value)) {
+        stage_params[key] = value;
+      } else if (key == "cloud_size" && value > 0) {
+        // accepted before the pipeline, the octree and the layers keep the
+        // density and a configured pipeline may not sample
+        Log::warn("No random_sample stage in " + sensor_name_
+                  + ", cloud_size ignored");
+      } else if (key == "medianSize" && value >= 0) {
+        flt.medianSize = value;
+      } else if (key == "kalmanEnable") {
+        flt.kalmanEnable = value != 0;
+      } else if (key == "kalmanFactor" && value >= 0) {
+        flt.kalmanFactor = value;
+      } else if (key == "kalmanThreshold" && value >= 0) {
+        flt.kalmanThreshold = value;
+      } else if (key == "edgeEnable") {
+        flt.edgeEnable = value != 0;
+      } else if (key == "edgeThreshold" && value >= 0) {
+        flt.edgeThreshold = value;
+      } else if (key == "dustEnable") {
+        flt.dustEnable = value != 0;
+      } else if (key == "dustThreshold" && value >= 0) {
+        flt.dustThreshold = value;
+      } else if (key == "dustFrames" && value >= 0) {
+        flt.dustFrames = value;
+      } else {
+        Log::warn("Invalid lidar param: " + key);
+        return false;
+      }
+    }
+
+    for (const auto &[key, value] : stage_params) {
+      impl_->pipeline->set_param(key, value);
+    }
+    impl_->params.filter = flt;
+    if (impl_->xtsdk) {
+      impl_->xtsdk->clearAllSdkFilter();
+      impl_->apply_filter(flt);
+    }
+    return true;
+  }
+
   MsgConstPtr LidarReader::read() {
+    if (!opened()) open();
+    if (paused_) return nullptr;
     auto cld = impl_->read();
     if (!cld) {
       return nullptr;
@@ -246,19 +737,113 @@ namespace tskpub {
     return package_data(reinterpret_cast<const void *>(cld.get()));
   }
 
+  std::vector<MsgConstPtr> LidarReader::refinements() {
+    std::vector<MsgConstPtr> ret;
+    ret.swap(impl_->layers);
+    return ret;
+  }
+
   MsgPtr LidarReader::package_data(const void *cld_ptr) {
     auto cld = reinterpret_cast<const Cld *>(cld_ptr);
+    if (impl_->range) return package_range_image(cld);
+    if (impl_->lod) return package_layers(cld);
+    if (impl_->octree) {
+      auto &frame = impl_->frame;
+      impl_->octree->encode(cld->points.data(), cld->size(), frame);
+      auto size = packed_bound(frame.bytes());
+      auto builder = capnp::MallocMessageBuilder(size / sizeof(capnp::word));
+      auto msg = builder.initRoot<OctreeCloud>();
+      fill_header(msg, cld->header.stamp);
+      msg.setFrameIndex(frame.frame_index);
+      msg.setReference(frame.reference);
+      msg.setKeyframe(frame.keyframe);
+      msg.setResolution(frame.resolution);
+      msg.setOriginX(frame.origin[0]);
+      msg.setOriginY(frame.origin[1]);
+      msg.setOriginZ(frame.origin[2]);
+      msg.setDepth(frame.depth);
+      msg.setMaxIntensity(impl_->octree_params.max_intensity);
+      msg.setOccupancy(capnp::Data::Reader(frame.occupancy.data(),
+                                           frame.occupancy.size()));
+      msg.setIntensity(capnp::Data::Reader(frame.intensity.data(),
+                                           frame.intensity.size()));
+      msg.setRemoved(
+          capnp::Data::Reader(frame.removed.data(), frame.removed.size()));
+      return to_msg(builder, size, cld->header.stamp);
+    }
+
     auto builder = capnp::MallocMessageBuilder(cld->size() * sizeof(PointT));
     auto msg = builder.initRoot<PointCloud>();
-    msg.setTopic(topic_);
-    msg.setTimestamp(cld->header.stamp);
-    auto points = msg.initPoints(cld->size());
-    for (size_t i = 0; i < cld->size(); i++) {
-      points[i].setX(cld->points[i].x);
-      points[i].setY(cld->points[i].y);
-      points[i].setZ(cld->points[i].z);
-      points[i].setI(cld->points[i].intensity);
+    fill_header(msg, cld->header.stamp);
+    fill_points(msg, cld->points.data(), cld->size());
+    return to_msg(builder, cld->size() * sizeof(PointT) + 500,
+                  cld->header.stamp);
+  }
+
+  MsgPtr LidarReader::package_layers(const void *cld_ptr) {
+    auto cld = reinterpret_cast<const Cld *>(cld_ptr);
+    auto &lod = *impl_->lod;
+    auto &pts = impl_->layered;
+    lod.split(cld->points.data(), cld->size(), pts);
+    const auto stamp = cld->header.stamp;
+    const auto frame = impl_->lod_frame++;
+    // refinements of a frame that were never taken are stale
+    impl_->layers.clear();
+    MsgPtr ret{nullptr};
+    for (uint8_t l = 0; l < lod.layers(); l++) {
+      const auto n = lod.offset(l + 1) - lod.offset(l);
+      auto builder = capnp::MallocMessageBuilder(n * sizeof(PointT));
+      auto msg = builder.initRoot<PointCloud>();
+      fill_header(msg, stamp);
+      msg.setFrameIndex(frame);
+      msg.setLayer(l);
+      msg.setLayers(lod.layers());
+      fill_points(msg, pts.data() + lod.offset(l), n);
+      auto layer = to_msg(builder, n * sizeof(PointT) + 500, stamp);
+      if (l == 0) {
+        ret = std::move(layer);
+      } else {
+        impl_->layers.push_back(std::move(layer));
+      }
+    }
+    return ret;
+  }
+
+  MsgPtr LidarReader::package_range_image(const void *cld_ptr) {
+    auto cld = reinterpret_cast<const Cld *>(cld_ptr);
+    auto &img = *impl_->range;
+    if (!img.intrinsics.valid()) {
+      if (!fit_intrinsics(cld->points.data(), cld->width, cld->height,
+                          img.intrinsics)) {
+        Log::warn("Not enough points to fit lidar intrinsics, dropped");
+        drop(DropStage::Read);
+        return nullptr;
+      }
+      const auto &k = img.intrinsics;
+      Log::info("Lidar intrinsics fx: " + std::to_string(k.fx)
+                + " fy: " + std::to_string(k.fy) + " cx: "
+                + std::to_string(k.cx) + " cy: " + std::to_string(k.cy));
     }
-    return to_msg(builder, cld->size() * sizeof(PointT) + 500);
+    img.from_points(cld->points.data(), cld->width, cld->height);
+    shuffle_depth(img.depth, impl_->planes);
+    auto &c = *impl_->range_compressor;
+    auto depth = compress(c, impl_->planes.data(), impl_->planes.size());
+    auto intensity = compress(c, img.intensity.data(), img.intensity.size());
+
+    auto size = packed_bound(depth->size() + intensity->size());
+    auto builder = capnp::MallocMessageBuilder(size / sizeof(capnp::word));
+    auto msg = builder.initRoot<::RangeImage>();
+    fill_header(msg, cld->header.stamp);
+    msg.setWidth(img.width);
+    msg.setHeight(img.height);
+    msg.setFx(img.intrinsics.fx);
+    msg.setFy(img.intrinsics.fy);
+    msg.setCx(img.intrinsics.cx);
+    msg.setCy(img.intrinsics.cy);
+    msg.setDepthScale(img.depth_scale);
+    msg.setMaxIntensity(img.max_intensity);
+    msg.setDepth(capnp::Data::Reader(depth->data(), depth->size()));
+    msg.setIntensity(capnp::Data::Reader(intensity->data(), intensity->size()));
+    return to_msg(builder, size, cld->header.stamp);
   }
 }  // namespace tskpub
\ No newline at end of file
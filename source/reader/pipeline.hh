@@ -0,0 +1,245 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "TSKPub/executor.hh"
+#include "common.hh"
+
+namespace tskpub {
+  /// @brief Processing step of a reader between capture and packing, e.g.
+  ///        a point cloud filter. The data is changed in place or replaced,
+  ///        the pipeline only moves it
+  /// @tparam T Data type, cheap to move
+  template <typename T> class Stage {
+  public:
+    using Ptr = std::unique_ptr<Stage>;
+    virtual ~Stage() = default;
+
+    /// @brief Process the data
+    /// @param data Input, replaced by the output
+    /// @return false to discard the data
+    virtual bool process(T& data) = 0;
+
+    /// @brief Whether a runtime parameter belongs to this stage and is valid
+    /// @param key Parameter name
+    /// @param value New value
+    virtual bool accepts(const std::string& key, double value) const {
+      (void)key;
+      (void)value;
+      return false;
+    }
+
+    /// @brief Apply a parameter checked by accepts(). Thread safe, may be
+    ///        called while another thread is in process()
+    /// @param key Parameter name
+    /// @param value New value
+    virtual void set_param(const std::string& key, double value) {
+      (void)key;
+      (void)value;
+    }
+  };
+
+  /// @brief Factory class for creating stages from the config file
+  /// @tparam T Data type of the stages
+  template <typename T> class StageFactory {
+  public:
+    /// @brief Creator function type, gets the config entry of the stage
+    using Creator
+        = std::function<typename Stage<T>::Ptr(const fkyaml::node& cfg)>;
+
+    /// @brief Create a stage
+    /// @param name Stage name
+    /// @param cfg Config entry of the stage
+    /// @return Stage, nullptr if the name is unknown
+    static typename Stage<T>::Ptr create(const std::string& name,
+                                         const fkyaml::node& cfg) {
+      const auto& map = creaters();
+      auto it = map.find(name);
+      if (it == map.end()) {
+        Log::critical("No creater for stage: " + name);
+        return nullptr;
+      }
+      return it->second(cfg);
+    }
+
+    /// @brief Register a creator function
+    /// @param name Stage name in the config file
+    /// @param creator Creator function for the stage
+    /// @return false if the name already exists
+    static bool regist(std::string name, Creator creator) {
+      auto& map = creaters();
+      if (map.count(name)) {
+        Log::critical("Creater for stage: " + name + " already exists");
+        return false;
+      }
+      map[name] = creator;
+      return true;
+    }
+
+    /// @brief Get all registered creators, constructed on first use
+    /// @return name -> Creator map
+    static std::unordered_map<std::string, Creator>& creaters() {
+      static std::unordered_map<std::string, Creator> creaters;
+      return creaters;
+    }
+
+  private:
+    StageFactory() = delete;
+  };
+
+  /// @brief Chain of stages ending in a sink, built from the config file.
+  ///        The stages run inline in push() until a stage marked async,
+  ///        which starts a segment running as a task on the shared
+  ///        executor. A busy segment keeps only the latest data
+  /// @tparam T Data type, cheap to move
+  template <typename T> class Pipeline {
+  public:
+    /// @brief Receives the output of the last stage
+    using Sink = std::function<void(T&&)>;
+    /// @brief Discarded data: Read by a stage, Overwrite at an async segment
+    using DropCallback = std::function<void(DropStage)>;
+
+    /// @brief Create an empty pipeline, data goes straight to the sink
+    /// @param sink Output
+    /// @param on_drop Optional drop counter
+    explicit Pipeline(Sink sink, DropCallback on_drop = nullptr)
+        : sink_(std::move(sink)), on_drop_(std::move(on_drop)) {
+      segments_.push_back(std::make_unique<Segment>());
+    }
+
+    /// @brief Wait for the running segments
+    ~Pipeline() {
+      std::unique_lock<std::mutex> lock(mtx_);
+      idle_.wait(lock, [this] { return busy_ == 0; });
+    }
+
+    /// @brief Append the stages of a config list, entries are
+    ///        {stage: name, async: bool, ...stage params}
+    /// @param list Config list
+    void load(const fkyaml::node& list) {
+      for (size_t i = 0; i < list.size(); i++) {
+        const auto& cfg = list[i];
+        auto name = cfg["stage"].get_value<std::string>();
+        auto stage = StageFactory<T>::create(name, cfg);
+        if (!stage) throw std::runtime_error("Unknown stage: " + name);
+        add(std::move(stage),
+            cfg.contains("async") && cfg["async"].get_value<bool>());
+      }
+    }
+
+    /// @brief Append a stage, before the first push()
+    /// @param stage Stage
+    /// @param async Run this and the following stages on the executor
+    void add(typename Stage<T>::Ptr stage, bool async = false) {
+      if (async) segments_.push_back(std::make_unique<Segment>());
+      segments_.back()->stages.push_back(std::move(stage));
+    }
+
+    /// @brief Process data, returns when the inline stages are done
+    /// @param data Input
+    void push(T data) { run(0, std::move(data)); }
+
+    /// @brief Whether a stage takes the runtime parameter
+    bool accepts(const std::string& key, double value) const {
+      for (const auto& seg : segments_) {
+        for (const auto& stage : seg->stages) {
+          if (stage->accepts(key, value)) return true;
+        }
+      }
+      return false;
+    }
+
+    /// @brief Apply a parameter to every stage that accepts it
+    void set_param(const std::string& key, double value) {
+      for (auto& seg : segments_) {
+        for (auto& stage : seg->stages) {
+          if (stage->accepts(key, value)) stage->set_param(key, value);
+        }
+      }
+    }
+
+    /// @brief Number of stages
+    size_t size() const {
+      size_t n = 0;
+      for (const auto& seg : segments_) n += seg->stages.size();
+      return n;
+    }
+
+  private:
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    struct Segment {
+      std::vector<typename Stage<T>::Ptr> stages;
+      // latest data waiting for the task, guarded by mtx_
+      std::optional<T> pending;
+      bool busy{false};
+    };
+
+    void drop(DropStage stage) {
+      if (on_drop_) on_drop_(stage);
+    }
+
+    /// @brief Run a segment, then hand the data over to the next one
+    void run(size_t index, T data) {
+      for (auto& stage : segments_[index]->stages) {
+        if (!stage->process(data)) return drop(DropStage::Read);
+      }
+      if (index + 1 == segments_.size()) return sink_(std::move(data));
+
+      auto& next = *segments_[index + 1];
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (next.pending) drop(DropStage::Overwrite);
+        next.pending = std::move(data);
+        if (next.busy) return;
+        next.busy = true;
+        busy_++;
+      }
+      Executor::shared().submit([this, index] { drain(index + 1); });
+    }
+
+    /// @brief Task of an async segment, runs until nothing is pending
+    void drain(size_t index) {
+      auto& seg = *segments_[index];
+      while (true) {
+        std::optional<T> data;
+        {
+          std::lock_guard<std::mutex> lock(mtx_);
+          if (!seg.pending) {
+            seg.busy = false;
+            busy_--;
+            idle_.notify_all();
+            return;
+          }
+          data.swap(seg.pending);
+        }
+        // an escaping exception would leave the segment busy forever
+        try {
+          run(index, std::move(*data));
+        } catch (const std::exception& e) {
+          drop(DropStage::Read);
+          Log::error(std::string("Pipeline stage failed: ") + e.what());
+        }
+      }
+    }
+
+    Sink sink_;
+    DropCallback on_drop_;
+    // the first segment runs inline
+    std::vector<std::unique_ptr<Segment>> segments_;
+    std::mutex mtx_;
+    std::condition_variable idle_;
+    // number of busy segments
+    size_t busy_{0};
+  };
+}  // namespace tskpub
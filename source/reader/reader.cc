@@ -3,12 +3,55 @@
 #include <capnp/common.h>
 #include <capnp/serialize-packed.h>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iomanip>
+#include <iterator>
 
+#include "TSKPub/msg/Series.capnp.h"
 #include "TSKPub/msg/Status.capnp.h"
 
+namespace {
+  /// @brief Packed output behind the prefix of a message. Starts with the
+  ///        reserved size and grows past it instead of failing: packing
+  ///        adds words to data without zero bytes, e.g. compressed bodies
+  class MsgOutputStream final : public kj::BufferedOutputStream {
+  public:
+    MsgOutputStream(tskpub::Msg& msg, size_t reserve)
+        : msg_(msg), used_(msg.size()) {
+      msg_.resize(used_ + std::max<size_t>(reserve, 64));
+    }
+
+    kj::ArrayPtr<kj::byte> getWriteBuffer() override {
+      if (used_ == msg_.size()) msg_.resize(2 * msg_.size());
+      return {msg_.data() + used_, msg_.size() - used_};
+    }
+
+    void write(const void* src, size_t size) override {
+      // data outside the write buffer is copied in
+      if (src != msg_.data() + used_) {
+        if (used_ + size > msg_.size()) {
+          msg_.resize(std::max(used_ + size, 2 * msg_.size()));
+        }
+        std::memcpy(msg_.data() + used_, src, size);
+      }
+      used_ += size;
+    }
+
+    /// @brief Drop the unused reserve
+    void finish() { msg_.resize(used_); }
+
+  private:
+    tskpub::Msg& msg_;
+    size_t used_;
+  };
+}  // namespace
+
 namespace tskpub {
-  Reader::Reader(std::string sensor_name) : sensor_name_(sensor_name) {
+  Reader::Reader(std::string sensor_name)
+      : sensor_name_(sensor_name),
+        counter_(&ReadStats::counter(sensor_name)) {
     // get params of sensor_name from config file
     auto& params = GlobalParams::get_instance().yml[sensor_name];
     if (params.empty()) {
@@ -19,27 +62,201 @@ namespace tskpub {
     // get topic and message type
     params["topic"].get_value_inplace(topic_);
     params["type"].get_value_inplace(msg_type_);
+    schema_ = schema_from_type(msg_type_);
+
+    // framing is shared by all sensors, topic ids follow the sensor list
+    const auto& yml = GlobalParams::get_instance().yml;
+    framed_ = yml["app"].contains("framing")
+              && yml["app"]["framing"].get_value<std::string>() == "header";
+    auto sensors = yml["sensors"].get_value<std::vector<std::string>>();
+    for (size_t i = 0; i < sensors.size(); i++) {
+      if (sensors[i] == sensor_name) topic_id_ = i + 1;
+    }
+
+    // optional compression after packing
+    if (params.contains("compress")) {
+      const auto& cfg = params["compress"];
+      CompressParams cp;
+      cp.algo = cfg["algo"].get_value<std::string>();
+      cp.level = cfg["level"].get_value<int>();
+      if (cfg.contains("dict")) {
+        auto dict_file = cfg["dict"].get_value<std::string>();
+        std::ifstream ifs(dict_file, std::ios::binary);
+        if (!ifs) {
+          Log::critical("Failed to open dictionary: " + dict_file);
+          throw std::runtime_error("Failed to open dictionary: " + dict_file);
+        }
+        cp.dict.assign(std::istreambuf_iterator<char>(ifs), {});
+        // the header has one byte for it and 0 means no dictionary
+        auto dict_id = cfg["dict_id"].get_value<int>();
+        if (dict_id < 1 || dict_id > 255) {
+          Log::critical("Invalid dictionary id for " + sensor_name);
+          throw std::runtime_error("Invalid dictionary id for " + sensor_name);
+        }
+        cp.dict_id = uint8_t(dict_id);
+      }
+      compressor_ = CompressorFactory::create(cp);
+      if (cfg.contains("record")) {
+        record_dir_ = cfg["record"].get_value<std::string>();
+      }
+    }
   }
 
-  MsgPtr Reader::to_msg(capnp::MallocMessageBuilder& builder, size_t max_sz) {
-    // sensor_name is a prefix of msg
-    size_t prefix_len = sensor_name_.size();
-    size_t capacity = prefix_len + max_sz;
+  void Reader::open() {
+    std::call_once(open_flag_, [this] {
+      startup_phase("open");
+      on_open();
+      opened_ = true;
+      startup_phase("opened");
+    });
+  }
+
+  void Reader::startup_phase(const std::string& phase) {
+    Startup::record(sensor_name_, phase);
+  }
 
-    // write sensor name
-    auto ret = std::make_shared<Msg>(capacity);
-    ret->insert(ret->begin(), sensor_name_.begin(), sensor_name_.end());
+  void Reader::mark_ready() {
+    if (!ready_.exchange(true)) startup_phase("ready");
+  }
+
+  void Reader::pause() {
+    if (!paused_.exchange(true)) {
+      Log::info("Pause " + sensor_name_);
+      on_pause();
+    }
+  }
+
+  void Reader::resume() {
+    if (paused_.exchange(false)) {
+      Log::info("Resume " + sensor_name_);
+      // the coder runs on the reading thread, it restarts from there
+      series_restart_ = true;
+      on_resume();
+    }
+  }
+
+  bool Reader::set_params(const Params& params) {
+    if (params.empty()) return true;
+    Log::warn(sensor_name_ + " has no runtime params");
+    return false;
+  }
+
+  MsgPtr Reader::to_msg(capnp::MallocMessageBuilder& builder, size_t reserve,
+                        uint64_t stamp) {
+    // sensor_name or the frame header is a prefix of msg
+    std::string prefix = sensor_name_;
+    // every captured message takes a number, framed or not, the body of an
+    // unframed one took it in fill_header()
+    uint32_t seq = seq_taken_
+                       ? seq_
+                       : counter_->seq.fetch_add(1, std::memory_order_relaxed);
+    seq_taken_ = false;
+    // other readers anchor on the capture times, e.g. IMU preintegration
+    counter_->stamp.store(stamp, std::memory_order_relaxed);
+    if (framed_) {
+      FrameHeader hdr;
+      hdr.flags = compressor_ ? FrameHeader::Compressed : 0;
+      hdr.schema = schema_;
+      hdr.topic_id = topic_id_;
+      hdr.seq = seq;
+      hdr.stamp = stamp;
+      prefix.resize(FrameHeader::Size);
+      hdr.encode(reinterpret_cast<uint8_t*>(prefix.data()));
+    }
+    size_t prefix_len = prefix.size();
+
+    // write the prefix
+    auto ret = std::make_shared<Msg>(prefix.begin(), prefix.end());
 
     // write message body
-    kj::ArrayPtr<kj::byte> array(&ret->at(prefix_len),
-                                 ret->size() - prefix_len);
-    kj::ArrayOutputStream out(array);
-    capnp::writePackedMessage(out, builder);
-    auto pkgsz = out.getArray().size();
-    ret->resize(prefix_len + pkgsz);
+    {
+      MsgOutputStream out(*ret, reserve);
+      capnp::writePackedMessage(out, builder);
+      out.finish();
+    }
+    auto pkgsz = ret->size() - prefix_len;
+    if (!record_dir_.empty()) record(ret->data() + prefix_len, pkgsz);
+    // replace the packed body with [header][compressed body]
+    if (compressor_) {
+      ret = compress(*compressor_, ret->data() + prefix_len, pkgsz, prefix);
+    }
+
+    // queued messages keep their allocation, and the reservation is the
+    // worst case, e.g. w * h * 3 bytes for a camera frame packing to a jpeg
+    if (ret->capacity() > 2 * ret->size()) ret->shrink_to_fit();
     return ret;
   }
 
+  void Reader::drop(DropStage stage, uint64_t n) {
+    counter_->dropped[size_t(stage)].fetch_add(n, std::memory_order_relaxed);
+    // captured data had a number, later stages drop numbered messages
+    if (stage == DropStage::Overwrite || stage == DropStage::Read) {
+      counter_->seq.fetch_add(n, std::memory_order_relaxed);
+    }
+  }
+
+  void Reader::record(const uint8_t* data, size_t size) {
+    // enough samples for zstd --train
+    constexpr size_t max_records = 10000;
+    if (record_cnt_ >= max_records) return;
+    std::ofstream ofs(record_dir_ + "/" + sensor_name_ + "_"
+                          + std::to_string(record_cnt_++) + ".bin",
+                      std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(data), size);
+  }
+
+  void Reader::init_series() {
+    auto& params = GlobalParams::get_instance().yml[sensor_name_];
+    if (!params.contains("encoding")
+        || params["encoding"].get_value<std::string>() != "gorilla") {
+      return;
+    }
+    // a key every 100 samples unless configured
+    int64_t interval = 100;
+    if (params.contains("gorilla")
+        && params["gorilla"].contains("key_interval")) {
+      interval = params["gorilla"]["key_interval"].get_value<int64_t>();
+    }
+    if (interval < 1 || interval > UINT32_MAX) {
+      Log::critical("Invalid gorilla key interval for " + sensor_name_);
+      throw std::runtime_error("Invalid gorilla key interval for "
+                               + sensor_name_);
+    }
+    series_ = std::make_unique<GorillaEncoder>(uint32_t(interval));
+    schema_ = Schema::Series;
+  }
+
+  MsgPtr Reader::package_series(const std::vector<std::string>& names,
+                                const std::vector<double>& values,
+                                uint64_t stamp) {
+    // subscribers are likely new after a pause and the previous sample is
+    // old, so the first one is a key
+    if (series_restart_.exchange(false)) series_->reset();
+    // the names go with keys only, a new set must not wait for the next one
+    if (names != series_names_) {
+      series_->reset();
+      series_names_ = names;
+    }
+    auto index = series_->encode(stamp, values.data(), values.size(),
+                                 series_data_);
+    capnp::MallocMessageBuilder message{1024};
+    auto series = message.initRoot<Series>();
+    // the coded stamp of the other samples is smaller
+    fill_header(series, index ? 0 : stamp);
+    series.setIndex(index);
+    size_t size = 1024 + series_data_.size();
+    if (index == 0) {
+      auto list = series.initNames(names.size());
+      for (size_t i = 0; i < names.size(); i++) {
+        list.set(i, names[i]);
+        size += names[i].size() + 16;
+      }
+    }
+    series.setData(
+        kj::ArrayPtr<const kj::byte>(series_data_.data(), series_data_.size()));
+    return to_msg(message, size, stamp);
+  }
+
   // *****************
   // * ReaderFactory *
   // *****************
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "TSKPub/compress.hh"
+#include "TSKPub/frame.hh"
+#include "TSKPub/gorilla.hh"
+#include "TSKPub/preintegration.hh"
 #include "common.hh"
 
 namespace capnp {
@@ -16,6 +23,8 @@ namespace tskpub {
   public:
     using Ptr = std::shared_ptr<Reader>;
     using ConstPtr = std::shared_ptr<const Reader>;
+    /// @brief Runtime parameters, key as in the config file
+    using Params = std::unordered_map<std::string, double>;
     Reader() = delete;
     Reader(Reader&) = delete;
     Reader(const Reader&) = delete;
@@ -23,23 +32,162 @@ namespace tskpub {
     Reader(std::string sensor_name);
     virtual ~Reader() = default;
 
-    /// @brief Read data from sensor
-    /// @return Byte vector
+    /// @brief Read data from sensor, opens the device first if open() was
+    ///        not called
+    /// @return Byte vector, nullptr while paused
     virtual MsgConstPtr read() = 0;
 
+    /// @brief Take the messages that refine the one last returned by
+    ///        read(), coarsest first. They are dropped before it under
+    ///        backpressure
+    /// @return Refinements, empty for readers that send whole messages
+    virtual std::vector<MsgConstPtr> refinements() { return {}; }
+
+    /// @brief Open the device and start capturing.
+    ///        Only the first call opens, concurrent callers wait for it. If
+    ///        opening throws, the next call tries again
+    void open();
+
+    /// @brief Whether open() finished
+    bool opened() const { return opened_; }
+
+    /// @brief Whether the device delivered its first data
+    bool ready() const { return ready_; }
+
+    /// @brief Sensor name in the config file
+    const std::string& sensor_name() const { return sensor_name_; }
+
+    /// @brief Topic name
+    const std::string& topic() const { return topic_; }
+
+    /// @brief Topic id in the frame header
+    uint16_t topic_id() const { return topic_id_; }
+
+    /// @brief Schema of the messages
+    Schema schema() const { return schema_; }
+
+    /// @brief Stop capturing until resume() is called.
+    ///        Thread safe, may be called while another thread is in read()
+    void pause();
+
+    /// @brief Start capturing again after pause()
+    void resume();
+
+    /// @brief Whether the reader is paused
+    bool paused() const { return paused_; }
+
+    /// @brief Change parameters of a running reader without reopening the
+    ///        device. Either all parameters are applied or none
+    /// @param params key -> value
+    /// @return false if a key is unknown or a value is invalid
+    virtual bool set_params(const Params& params);
+
   protected:
+    /// @brief pause state
+    std::atomic<bool> paused_{false};
+
+    /// @brief Open the device, called once by open()
+    virtual void on_open() {}
+
+    /// @brief Record a startup phase of the device
+    /// @param phase Phase name
+    void startup_phase(const std::string& phase);
+
+    /// @brief Mark the first data, records the "ready" phase once
+    void mark_ready();
+
+    /// @brief Release the device, called once by pause()
+    virtual void on_pause() {}
+
+    /// @brief Reacquire the device, called once by resume()
+    virtual void on_resume() {}
+
     /// @brief topic name
     std::string topic_;
     /// @brief sensor name
     std::string sensor_name_;
     /// @brief message type in capnp
     std::string msg_type_;
+    /// @brief optional compression stage after packing
+    Compressor::Ptr compressor_;
+    /// @brief directory to record packed messages for dictionary training
+    std::string record_dir_;
+    /// @brief number of recorded messages
+    size_t record_cnt_{0};
+    /// @brief put a FrameHeader in front of messages instead of the sensor
+    ///        name, the topic text and timestamp are left out of the body
+    bool framed_{false};
+    /// @brief schema in the frame header
+    Schema schema_{Schema::Unknown};
+    /// @brief topic id in the frame header
+    uint16_t topic_id_{0};
+    /// @brief sequence number and drop counters, shared by all readers of
+    ///        the sensor so that the numbers survive a new reader
+    ReadCounter* counter_;
+    /// @brief sequence number taken by fill_header() for the next message
+    uint32_t seq_{0};
+    bool seq_taken_{false};
+
+    /// @brief Count discarded data. Overwrite and Read also consume
+    ///        sequence numbers so that subscribers see the gap.
+    ///        Thread safe, may be called from capture threads
+    /// @param stage Stage that discarded the data
+    /// @param n Number of messages
+    void drop(DropStage stage, uint64_t n = 1);
+
+    /// @brief Set the topic, timestamp and sequence number of a message
+    ///        unless the frame header carries them. The number is taken
+    ///        here and used by the next to_msg()
+    /// @param msg Message builder with topic, timestamp and seq fields
+    /// @param stamp Capture time in nanoseconds
+    template <typename B> void fill_header(B& msg, uint64_t stamp) {
+      if (framed_) return;
+      msg.setTopic(topic_);
+      msg.setTimestamp(stamp);
+      seq_ = counter_->seq.fetch_add(1, std::memory_order_relaxed);
+      seq_taken_ = true;
+      msg.setSeq(seq_);
+    }
 
-    /// @brief Package data into a message
+    /// @brief Package data into a message, [sensor name][body] or
+    ///        [FrameHeader][body]
     /// @param builder Message builder
-    /// @param max_sz Maximum size of the message
+    /// @param reserve Expected size of the packed body, the message grows
+    ///        beyond it if packing takes more
+    /// @param stamp Capture time in nanoseconds
     /// @return Byte vector
-    MsgPtr to_msg(capnp::MallocMessageBuilder& builder, size_t max_sz);
+    MsgPtr to_msg(capnp::MallocMessageBuilder& builder, size_t reserve,
+                  uint64_t stamp);
+
+    /// @brief Gorilla coder of the samples, nullptr unless the config sets
+    ///        encoding: gorilla
+    std::unique_ptr<GorillaEncoder> series_;
+
+    /// @brief Set up series_ and the Series schema from the config
+    void init_series();
+
+    /// @brief Pack a sample as a Series message. The next message of the
+    ///        topic is coded against it
+    /// @param names Channel names, a change starts a key
+    /// @param values Channel values
+    /// @param stamp Capture time in nanoseconds
+    MsgPtr package_series(const std::vector<std::string>& names,
+                          const std::vector<double>& values, uint64_t stamp);
+
+    /// @brief Save a packed message body into record_dir_
+    /// @param data Packed message body
+    /// @param size Size of the body
+    void record(const uint8_t* data, size_t size);
+
+  private:
+    // channel names of the last Series key and the reused coded sample
+    std::vector<std::string> series_names_;
+    std::vector<uint8_t> series_data_;
+    // set by resume(), the next sample is a key
+    std::atomic<bool> series_restart_{false};
+    std::once_flag open_flag_;
+    std::atomic<bool> opened_{false};
+    std::atomic<bool> ready_{false};
   };
 
   /// @brief Factory class for creating readers
@@ -122,7 +270,16 @@ namespace tskpub {
     MsgConstPtr read() override;
     static const char* msg_type() noexcept { return "Status"; }
 
+  protected:
+    void on_open() override;
+
   private:
+    /// @brief Pack the numbers of a status as a Series message
+    /// @param results Fields of the status command
+    /// @param stamp Capture time in nanoseconds
+    MsgPtr package_channels(const std::vector<std::string>& results,
+                            uint64_t stamp);
+
     struct Impl;
     std::unique_ptr<Impl> impl_;
   };
@@ -139,8 +296,20 @@ namespace tskpub {
     virtual ~IMUReader();
     void open_device();
     MsgConstPtr read() override;
-    MsgPtr package_data(const std::vector<double>& data);
+    /// @brief Pack a sample as an Imu message
+    /// @param data Sample
+    /// @param stamp Sample time in nanoseconds, 0 stamps it now
+    MsgPtr package_data(const std::vector<double>& data, uint64_t stamp = 0);
+    /// @brief Pack a preintegrated delta as an ImuDelta message
+    MsgPtr package_delta(const ImuDelta& delta);
     static const char* msg_type() noexcept { return "Imu"; }
+
+  protected:
+    void on_open() override;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
   };
 
   class CameraReader final : public Reader,
@@ -158,6 +327,13 @@ namespace tskpub {
     MsgPtr package_data(const void* data);
     static const char* msg_type() noexcept { return "Image"; }
 
+    bool set_params(const Params& params) override;
+
+  protected:
+    void on_open() override;
+    void on_pause() override;
+    void on_resume() override;
+
     // Use the PIMPL pattern to hide implementation details in the
     // implementation file of the class
   private:
@@ -165,6 +341,33 @@ namespace tskpub {
     std::unique_ptr<Impl> impl_;
   };
 
+  /// @brief Full resolution stills of a camera with a snapshot branch,
+  ///        one for every request through set_params({{"snapshot", 1}})
+  class SnapshotReader final : public Reader,
+                               public ReaderRegistor<SnapshotReader> {
+  public:
+    using Ptr = std::shared_ptr<SnapshotReader>;
+    using ConstPtr = std::shared_ptr<const SnapshotReader>;
+    SnapshotReader() = delete;
+    SnapshotReader(SnapshotReader&) = delete;
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(SnapshotReader&) = delete;
+    SnapshotReader(std::string sensor_name);
+    virtual ~SnapshotReader();
+    MsgConstPtr read() override;
+    static const char* msg_type() noexcept { return "Snapshot"; }
+
+    bool set_params(const Params& params) override;
+
+  protected:
+    void on_open() override;
+    void on_pause() override;
+
+  private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+  };
+
   class LidarReader final : public Reader, public ReaderRegistor<LidarReader> {
   public:
     using Ptr = std::shared_ptr<LidarReader>;
@@ -176,10 +379,24 @@ namespace tskpub {
     LidarReader(std::string sensor_name);
     virtual ~LidarReader();
     MsgConstPtr read() override;
+    std::vector<MsgConstPtr> refinements() override;
     MsgPtr package_data(const void* data);
     static const char* msg_type() noexcept { return "PointCloud"; }
+    bool set_params(const Params& params) override;
+
+  protected:
+    void on_open() override;
+    void on_pause() override;
+    void on_resume() override;
 
   private:
+    /// @brief Build a RangeImage message from an organized cloud
+    MsgPtr package_range_image(const void* data);
+
+    /// @brief Build a PointCloud message of each level of detail layer,
+    ///        layer 0 is returned and the others kept for refinements()
+    MsgPtr package_layers(const void* data);
+
     struct Impl;
     std::unique_ptr<Impl> impl_;
   };
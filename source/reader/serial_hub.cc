@@ -0,0 +1,93 @@
+#include "reader/serial_hub.hh"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "common.hh"
+
+namespace tskpub {
+  SerialHub& SerialHub::instance() {
+    // never destroyed, readers may still remove their ports during static
+    // destruction
+    static SerialHub* hub = new SerialHub;
+    return *hub;
+  }
+
+  SerialHub::SerialHub() : epfd_(epoll_create1(EPOLL_CLOEXEC)) {
+    if (epfd_ < 0) {
+      Log::critical("Failed to create epoll: "
+                    + std::string(std::strerror(errno)));
+      throw std::runtime_error("Failed to create epoll: "
+                               + std::string(std::strerror(errno)));
+    }
+    std::thread(&SerialHub::run, this).detach();
+  }
+
+  bool SerialHub::add(int fd, Callback callback, HangUp hangup) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      Log::error("Failed to poll fd " + std::to_string(fd) + ": "
+                 + std::strerror(errno));
+      return false;
+    }
+    ports_[fd] = Port{std::move(callback), std::move(hangup)};
+    return true;
+  }
+
+  void SerialHub::remove(int fd) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (ports_.erase(fd)) epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+  }
+
+  size_t SerialHub::size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return ports_.size();
+  }
+
+  void SerialHub::run() {
+    std::array<epoll_event, 16> events;
+    std::array<uint8_t, 1024> buffer;
+    while (true) {
+      int n = epoll_wait(epfd_, events.data(), events.size(), -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        Log::critical("epoll_wait failed: "
+                      + std::string(std::strerror(errno)));
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(mtx_);
+      for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        auto it = ports_.find(fd);
+        // removed while waiting
+        if (it == ports_.end()) continue;
+
+        // drain the port, the descriptors are non-blocking
+        ssize_t len;
+        while ((len = ::read(fd, buffer.data(), buffer.size())) > 0) {
+          it->second.callback(buffer.data(), len);
+        }
+        if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+          // a hung up port would wake the thread forever, the owner still
+          // holds fd and closes it, so the number is not reused meanwhile
+          Log::error("Serial port hung up, fd " + std::to_string(fd));
+          epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+          auto hangup = std::move(it->second.hangup);
+          ports_.erase(it);
+          if (hangup) hangup();
+        }
+      }
+    }
+  }
+}  // namespace tskpub
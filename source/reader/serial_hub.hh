@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace tskpub {
+  /// @brief One epoll thread reading every registered serial port.
+  ///        Devices decode their bytes in the callback, so N ports cost one
+  ///        thread instead of N readers polling their own port
+  class SerialHub {
+  public:
+    /// @brief Called on the hub thread with the bytes read from a port
+    using Callback = std::function<void(const uint8_t* data, size_t size)>;
+    /// @brief Called on the hub thread once the port hung up or failed, the
+    ///        port is no longer polled. It must not call add() or remove()
+    using HangUp = std::function<void()>;
+
+    /// @brief Get the hub, the thread starts on first use
+    static SerialHub& instance();
+
+    /// @brief Start polling a non-blocking file descriptor
+    /// @param fd File descriptor
+    /// @param callback Called with the bytes read from fd
+    /// @param hangup Called when fd hangs up, e.g. an unplugged device,
+    ///        so that the owner can reopen it
+    /// @return false if epoll refused the descriptor
+    bool add(int fd, Callback callback, HangUp hangup = nullptr);
+
+    /// @brief Stop polling a file descriptor. When this returns the callback
+    ///        is not running and will not be called again
+    /// @param fd File descriptor
+    void remove(int fd);
+
+    /// @brief Number of polled file descriptors
+    size_t size() const;
+
+  private:
+    SerialHub();
+    ~SerialHub() = delete;
+    SerialHub(const SerialHub&) = delete;
+    SerialHub& operator=(const SerialHub&) = delete;
+
+    /// @brief Hub thread
+    void run();
+
+    struct Port {
+      Callback callback;
+      HangUp hangup;
+    };
+
+    int epfd_;
+    // guards ports_ and every callback call
+    mutable std::mutex mtx_;
+    std::unordered_map<int, Port> ports_;
+  };
+}  // namespace tskpub
@@ -37,38 +37,108 @@ namespace tskpub {
   struct StatusReader::Impl {
     // command to get the status of the system
     std::string cmd;
-    // total read bytes
-    std::atomic<uint64_t>* total_read_bytes;
   };
 
   StatusReader::StatusReader(std::string sensor_name)
       : Reader(sensor_name), impl_(std::make_unique<Impl>()) {
     auto params = GlobalParams::get_instance().yml[sensor_name_];
     impl_->cmd = params["cmd"].get_value<std::string>();
-    impl_->total_read_bytes = &GlobalParams::get_instance().total_read_bytes;
+    init_series();
   }
 
   StatusReader::~StatusReader() {}
 
+  void StatusReader::on_open() {
+    // no device to wait for, ready as soon as the command works
+    if (split(exec(impl_->cmd.c_str()), ';').size() != 6) {
+      Log::critical("Invalid output of status command: " + impl_->cmd);
+      throw std::runtime_error("Invalid output of status command: "
+                               + impl_->cmd);
+    }
+    mark_ready();
+  }
+
   MsgConstPtr StatusReader::read() {
-    capnp::MallocMessageBuilder message{1024};
-    auto status = message.initRoot<Status>();
-    status.setTopic(topic_);
-    status.setTimestamp(nano_now());
+    if (!opened()) open();
+    if (paused_) return nullptr;
+    auto stamp = nano_now();
 
     // get the status of the system
     auto results = split(exec(impl_->cmd.c_str()), ';');
     if (results.size() != 6) {
+      drop(DropStage::Read);
       return nullptr;
     }
+    if (series_) return package_channels(results, stamp);
+
+    capnp::MallocMessageBuilder message{1024};
+    auto status = message.initRoot<Status>();
+    fill_header(status, stamp);
     status.setCpuUsage(std::stod(results[0]));
     status.setCpuTemp(std::stod(results[1]));
     status.setMemUsage(std::stod(results[2]));
     status.setBatteryVoltage(std::stod(results[3]));
     status.setBatteryCurrent(std::stod(results[4]));
     status.setIp(results[5]);
-    status.setTotalReadBytes(impl_->total_read_bytes->load());
-    impl_->total_read_bytes->store(0);
-    return to_msg(message, 1024);
+    status.setTotalReadBytes(ReadStats::take_total());
+
+    // a few entries per sensor, sent every time for late subscribers
+    auto phases = Startup::phases();
+    auto startup = status.initStartup(phases.size());
+    size_t size = 1024;
+    for (size_t i = 0; i < phases.size(); i++) {
+      startup[i].setSensor(phases[i].sensor);
+      startup[i].setPhase(phases[i].phase);
+      startup[i].setMs(phases[i].ms);
+      size += phases[i].sensor.size() + phases[i].phase.size() + 32;
+    }
+
+    auto losses = ReadStats::losses();
+    auto loss = status.initLoss(losses.size());
+    for (size_t i = 0; i < losses.size(); i++) {
+      const auto& d = losses[i].dropped;
+      loss[i].setSensor(losses[i].sensor);
+      loss[i].setSeq(losses[i].seq);
+      loss[i].setDecode(d[size_t(DropStage::Decode)]);
+      loss[i].setOverwrite(d[size_t(DropStage::Overwrite)]);
+      loss[i].setRead(d[size_t(DropStage::Read)]);
+      loss[i].setQueue(d[size_t(DropStage::Queue)]);
+      loss[i].setShaper(d[size_t(DropStage::Shaper)]);
+      size += losses[i].sensor.size() + 64;
+    }
+    return to_msg(message, size, stamp);
+  }
+
+  MsgPtr StatusReader::package_channels(
+      const std::vector<std::string>& results, uint64_t stamp) {
+    std::vector<std::string> names;
+    std::vector<double> values;
+    // rounded like the Status fields, the low mantissa bits stay zero
+    auto add = [&](std::string name, double v) {
+      names.push_back(std::move(name));
+      values.push_back(v);
+    };
+    add("cpuUsage", float(std::stod(results[0])));
+    add("cpuTemp", float(std::stod(results[1])));
+    add("memUsage", float(std::stod(results[2])));
+    add("batteryVoltage", float(std::stod(results[3])));
+    add("batteryCurrent", float(std::stod(results[4])));
+    add("totalReadBytes", ReadStats::take_total());
+
+    // the ip text has no channel, new phases and sensors start a key
+    for (const auto& p : Startup::phases()) {
+      add("startup." + p.sensor + "." + p.phase, float(p.ms));
+    }
+    for (const auto& l : ReadStats::losses()) {
+      const auto& d = l.dropped;
+      const auto prefix = "loss." + l.sensor + ".";
+      add(prefix + "seq", l.seq);
+      add(prefix + "decode", d[size_t(DropStage::Decode)]);
+      add(prefix + "overwrite", d[size_t(DropStage::Overwrite)]);
+      add(prefix + "read", d[size_t(DropStage::Read)]);
+      add(prefix + "queue", d[size_t(DropStage::Queue)]);
+      add(prefix + "shaper", d[size_t(DropStage::Shaper)]);
+    }
+    return package_series(names, values, stamp);
   }
-}  // namespace tskpub
\ No newline at end of file
+}  // namespace tskpub
@@ -0,0 +1,162 @@
+#include "TSKPub/scene.hh"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <vector>
+
+#include "TSKPub/simd.hh"
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace {
+  /// @brief libjpeg error handler that jumps back instead of exiting
+  struct ErrorManager {
+    jpeg_error_mgr pub;
+    std::jmp_buf jump;
+  };
+
+  void on_error(j_common_ptr cinfo) {
+    std::longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->jump, 1);
+  }
+
+  // warnings are counted in num_warnings, not printed
+  void on_message(j_common_ptr) {}
+
+  /// @brief Sum of the lanes first to first + 8
+  uint32_t sum8(const tskpub::simd::u16x16& v, int first) {
+    uint32_t s = 0;
+    for (int i = first; i < first + 8; i++) s += v[i];
+    return s;
+  }
+}  // namespace
+
+namespace tskpub {
+  void block_sad(const uint8_t* a, const uint8_t* b, size_t width,
+                 size_t height, uint32_t* out) {
+    using namespace simd;
+    const size_t bw = width / SceneBlock, bh = height / SceneBlock;
+    for (size_t by = 0; by < bh; by++) {
+      const size_t row = by * SceneBlock * width;
+      uint32_t* o = out + by * bw;
+      size_t bx = 0;
+      // two blocks side by side, 8 rows of at most 255 fit 16 bits
+      for (; bx + 2 <= bw; bx += 2) {
+        u16x16 acc{};
+        for (size_t y = 0; y < SceneBlock; y++) {
+          const size_t i = row + y * width + bx * SceneBlock;
+          auto d = absdiff(load_u8(a + i), load_u8(b + i));
+          acc += __builtin_convertvector(d, u16x16);
+        }
+        o[bx] = sum8(acc, 0);
+        o[bx + 1] = sum8(acc, 8);
+      }
+      // an odd block at the right
+      for (; bx < bw; bx++) {
+        uint32_t s = 0;
+        for (size_t y = 0; y < SceneBlock; y++) {
+          const size_t i = row + y * width + bx * SceneBlock;
+          for (size_t x = 0; x < SceneBlock; x++) {
+            s += a[i + x] > b[i + x] ? a[i + x] - b[i + x]
+                                     : b[i + x] - a[i + x];
+          }
+        }
+        o[bx] = s;
+      }
+    }
+  }
+
+  struct SceneGate::Impl {
+    Params params;
+    jpeg_decompress_struct cinfo;
+    ErrorManager err;
+
+    // luma of the checked frame and of the last frame that passed
+    std::vector<uint8_t> luma, ref;
+    size_t width{0}, height{0};
+    size_t ref_width{0}, ref_height{0};
+    uint64_t ref_stamp{0};
+    bool has_ref{false};
+    std::vector<uint32_t> sad;
+    double change{1};
+
+    explicit Impl(const Params& params) : params(params) {
+      cinfo.err = jpeg_std_error(&err.pub);
+      err.pub.error_exit = on_error;
+      err.pub.output_message = on_message;
+      jpeg_create_decompress(&cinfo);
+    }
+
+    ~Impl() { jpeg_destroy_decompress(&cinfo); }
+
+    /// @brief Decode the luma of a frame at 1/8 scale into luma
+    /// @return false if the data is not a complete JPEG
+    bool decode(const uint8_t* data, size_t size);
+  };
+
+  bool SceneGate::Impl::decode(const uint8_t* data, size_t size) {
+    if (setjmp(err.jump)) {
+      jpeg_abort_decompress(&cinfo);
+      return false;
+    }
+    err.pub.num_warnings = 0;
+    jpeg_mem_src(&cinfo, const_cast<uint8_t*>(data), size);
+    jpeg_read_header(&cinfo, TRUE);
+    // only the DC coefficient of every 8x8 block, the chroma is skipped
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 8;
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    luma.resize(width * height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      JSAMPROW row = luma.data() + cinfo.output_scanline * width;
+      jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    // a truncated frame is filled up with gray
+    return err.pub.num_warnings == 0;
+  }
+
+  SceneGate::SceneGate(const Params& params)
+      : impl_(std::make_unique<Impl>(params)) {}
+
+  SceneGate::~SceneGate() {}
+
+  bool SceneGate::check(const uint8_t* jpeg, size_t size, uint64_t stamp) {
+    auto& d = *impl_;
+    d.change = 1;
+    if (!d.decode(jpeg, size)) return true;
+
+    const size_t n = (d.width / SceneBlock) * (d.height / SceneBlock);
+    bool pass = !d.has_ref || d.width != d.ref_width
+                || d.height != d.ref_height || n == 0;
+    if (!pass) {
+      d.sad.resize(n);
+      block_sad(d.luma.data(), d.ref.data(), d.width, d.height, d.sad.data());
+      const auto limit = d.params.block_threshold * SceneBlock * SceneBlock;
+      auto changed = std::count_if(d.sad.begin(), d.sad.end(),
+                                   [limit](uint32_t s) { return s > limit; });
+      d.change = double(changed) / n;
+      pass = d.change >= d.params.threshold
+             || (d.params.keepalive > 0
+                 && stamp - d.ref_stamp >= d.params.keepalive * 1e9);
+    }
+    if (!pass) return false;
+    d.ref.swap(d.luma);
+    d.ref_width = d.width;
+    d.ref_height = d.height;
+    d.ref_stamp = stamp;
+    d.has_ref = true;
+    return true;
+  }
+
+  double SceneGate::change() const { return impl_->change; }
+
+  void SceneGate::reset() { impl_->has_ref = false; }
+}  // namespace tskpub
@@ -0,0 +1,219 @@
+#include "TSKPub/shaper.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tskpub {
+  // ***************
+  // * TokenBucket *
+  // ***************
+  TokenBucket::TokenBucket(double rate, double burst)
+      : rate(rate), burst(burst), tokens(burst), last(0) {}
+
+  void TokenBucket::refill(uint64_t now) {
+    if (rate <= 0) return;
+    // first refill only records the time, the bucket starts full
+    if (last == 0 || now <= last) {
+      last = std::max(last, now);
+      return;
+    }
+    tokens = std::min(burst, tokens + rate * (now - last) * 1e-9);
+    last = now;
+  }
+
+  bool TokenBucket::conform(size_t n) const {
+    if (rate <= 0) return true;
+    // a message larger than the bucket passes once the bucket is full,
+    // tokens go negative and the following messages pay the debt
+    return tokens >= std::min(static_cast<double>(n), burst);
+  }
+
+  void TokenBucket::consume(size_t n) {
+    if (rate > 0) tokens -= n;
+  }
+
+  uint64_t TokenBucket::wait_time(size_t n) const {
+    if (conform(n)) return 0;
+    auto need = std::min(static_cast<double>(n), burst) - tokens;
+    return static_cast<uint64_t>(std::ceil(need / rate * 1e9));
+  }
+
+  // **********
+  // * Shaper *
+  // **********
+  Shaper::Shaper(double rate, double burst) : link_(rate, burst) {}
+
+  void Shaper::add_topic(const std::string& name, const TopicParams& params) {
+    auto p = params;
+    p.weight = p.weight > 0 ? p.weight : 1.0;
+    p.queue_size = std::max<size_t>(p.queue_size, 1);
+
+    Topic t;
+    t.name = name;
+    t.params = p;
+    t.bucket = TokenBucket(p.rate, p.burst);
+    auto it = index_.find(name);
+    if (it != index_.end()) {
+      // keep queued messages and counters of an existing topic
+      auto& old = topics_[it->second];
+      t.queue.swap(old.queue);
+      t.vtime = old.vtime;
+      t.stats = old.stats;
+      topics_.erase(topics_.begin() + it->second);
+    }
+    topics_.push_back(std::move(t));
+
+    // keep topics ordered by priority so that pop() scans levels in order
+    std::stable_sort(topics_.begin(), topics_.end(),
+                     [](const Topic& a, const Topic& b) {
+                       return a.params.priority > b.params.priority;
+                     });
+    index_.clear();
+    for (size_t i = 0; i < topics_.size(); i++) {
+      index_[topics_[i].name] = i;
+    }
+  }
+
+  Shaper::Topic& Shaper::topic(const std::string& name) {
+    auto it = index_.find(name);
+    if (it == index_.end()) {
+      add_topic(name, TopicParams{});
+      it = index_.find(name);
+    }
+    return topics_[it->second];
+  }
+
+  void Shaper::refill(uint64_t now) {
+    link_.refill(now);
+    for (auto& t : topics_) {
+      t.bucket.refill(now);
+    }
+  }
+
+  bool Shaper::push(const std::string& name, MsgConstPtr msg, uint64_t now,
+                    uint8_t level) {
+    if (!msg) return false;
+    auto& t = topic(name);
+    t.bucket.refill(now);
+
+    // policing: the topic budget is checked on arrival
+    if (t.params.policy == Policy::Drop) {
+      if (!t.bucket.conform(msg->size())) {
+        t.stats.dropped_msgs++;
+        t.stats.dropped_bytes += msg->size();
+        return false;
+      }
+      t.bucket.consume(msg->size());
+    }
+
+    // a topic becoming active must not use credit saved while it was idle
+    if (t.queue.empty()) {
+      t.vtime = std::max(t.vtime, level_vtime_[t.params.priority]);
+    }
+    t.queue.push_back({std::move(msg), level});
+
+    // sensors only care about fresh data, so drop the oldest. Refinements
+    // go first, the finest ones first
+    if (t.queue.size() > t.params.queue_size) {
+      auto victim = t.queue.begin();
+      for (auto it = t.queue.begin(); it != t.queue.end(); ++it) {
+        if (it->level > victim->level) victim = it;
+      }
+      t.stats.dropped_msgs++;
+      t.stats.dropped_bytes += victim->msg->size();
+      bool self = victim == t.queue.end() - 1;
+      t.queue.erase(victim);
+      return !self;
+    }
+    return true;
+  }
+
+  Shaper::Topic* Shaper::select(size_t begin, size_t& end) {
+    const auto prio = topics_[begin].params.priority;
+    Topic* best = nullptr;
+    for (end = begin; end < topics_.size(); end++) {
+      auto& t = topics_[end];
+      if (t.params.priority != prio) break;
+      if (t.queue.empty() || !eligible(t)) continue;
+      if (!best || t.vtime < best->vtime) best = &t;
+    }
+    return best;
+  }
+
+  bool Shaper::eligible(const Topic& t) const {
+    // a topic over its own budget waits without blocking the others
+    return t.params.policy != Policy::Delay
+           || t.bucket.conform(t.queue.front().msg->size());
+  }
+
+  MsgConstPtr Shaper::pop(uint64_t now, std::string* name) {
+    refill(now);
+
+    size_t i = 0;
+    while (i < topics_.size()) {
+      // [i, end) is one priority level
+      size_t end;
+      auto best = select(i, end);
+      i = end;
+      if (!best) continue;
+
+      auto sz = best->queue.front().msg->size();
+      // the link is reserved for this level, lower levels have to wait
+      if (!link_.conform(sz)) return nullptr;
+
+      auto prio = best->params.priority;
+      auto msg = std::move(best->queue.front().msg);
+      best->queue.pop_front();
+      link_.consume(sz);
+      if (best->params.policy == Policy::Delay) best->bucket.consume(sz);
+      level_vtime_[prio] = best->vtime;
+      best->vtime += sz / best->params.weight;
+      best->stats.sent_msgs++;
+      best->stats.sent_bytes += sz;
+      if (name) *name = best->name;
+      return msg;
+    }
+    return nullptr;
+  }
+
+  uint64_t Shaper::next_ready(uint64_t now) {
+    refill(now);
+    auto ret = std::numeric_limits<uint64_t>::max();
+    // walk the levels the way pop() does, lower levels than the one
+    // holding the link reservation cannot go first
+    size_t i = 0;
+    while (i < topics_.size()) {
+      size_t end;
+      auto best = select(i, end);
+      // topics waiting for their own budget may take the turn once it
+      // allows them
+      for (size_t k = i; k < end; k++) {
+        const auto& t = topics_[k];
+        if (t.queue.empty() || eligible(t)) continue;
+        auto sz = t.queue.front().msg->size();
+        ret = std::min(ret, std::max(t.bucket.wait_time(sz),
+                                     link_.wait_time(sz)));
+      }
+      if (best) {
+        auto sz = best->queue.front().msg->size();
+        return std::min(ret, link_.wait_time(sz));
+      }
+      i = end;
+    }
+    return ret;
+  }
+
+  Shaper::TopicStats Shaper::stats(const std::string& name) const {
+    auto it = index_.find(name);
+    return it == index_.end() ? TopicStats{} : topics_[it->second].stats;
+  }
+
+  size_t Shaper::queued() const {
+    size_t n = 0;
+    for (const auto& t : topics_) {
+      n += t.queue.size();
+    }
+    return n;
+  }
+}  // namespace tskpub
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+
+namespace tskpub {
+  /// @brief Small rotation helpers, 3x3 matrices are row major
+  namespace so3 {
+    using Mat3 = std::array<double, 9>;
+    using Vec3 = std::array<double, 3>;
+
+    constexpr Mat3 Identity{1, 0, 0, 0, 1, 0, 0, 0, 1};
+
+    inline Mat3 mul(const Mat3& a, const Mat3& b) {
+      Mat3 r{};
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          for (int k = 0; k < 3; k++)
+            r[i * 3 + j] += a[i * 3 + k] * b[k * 3 + j];
+        }
+      }
+      return r;
+    }
+
+    inline Vec3 mul(const Mat3& a, const double* v) {
+      return {a[0] * v[0] + a[1] * v[1] + a[2] * v[2],
+              a[3] * v[0] + a[4] * v[1] + a[5] * v[2],
+              a[6] * v[0] + a[7] * v[1] + a[8] * v[2]};
+    }
+
+    inline Mat3 transpose(const Mat3& a) {
+      return {a[0], a[3], a[6], a[1], a[4], a[7], a[2], a[5], a[8]};
+    }
+
+    inline Mat3 skew(const double* v) {
+      return {0, -v[2], v[1], v[2], 0, -v[0], -v[1], v[0], 0};
+    }
+
+    /// @brief I + a * K + b * K^2 with K the skew matrix of phi
+    inline Mat3 series(const Vec3& phi, double a, double b) {
+      auto k = skew(phi.data());
+      auto k2 = mul(k, k);
+      Mat3 r;
+      for (int i = 0; i < 9; i++) r[i] = Identity[i] + a * k[i] + b * k2[i];
+      return r;
+    }
+
+    /// @brief Rotation matrix of a rotation vector (Rodrigues)
+    inline Mat3 exp_so3(const Vec3& phi) {
+      double t2 = phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2];
+      if (t2 < 1e-12) return series(phi, 1 - t2 / 6, 0.5 - t2 / 24);
+      double t = std::sqrt(t2);
+      return series(phi, std::sin(t) / t, (1 - std::cos(t)) / t2);
+    }
+
+    /// @brief Right Jacobian of SO(3)
+    inline Mat3 right_jacobian(const Vec3& phi) {
+      double t2 = phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2];
+      if (t2 < 1e-12)
+        return series(phi, -(0.5 - t2 / 24), 1.0 / 6 - t2 / 120);
+      double t = std::sqrt(t2);
+      return series(phi, -(1 - std::cos(t)) / t2,
+                    (t - std::sin(t)) / (t2 * t));
+    }
+
+    /// @brief Quaternion w, x, y, z of a rotation matrix
+    inline std::array<double, 4> to_quaternion(const Mat3& r) {
+      std::array<double, 4> q;
+      double tr = r[0] + r[4] + r[8];
+      if (tr > 0) {
+        double s = std::sqrt(tr + 1) * 2;
+        q = {s / 4, (r[7] - r[5]) / s, (r[2] - r[6]) / s, (r[3] - r[1]) / s};
+      } else if (r[0] > r[4] && r[0] > r[8]) {
+        double s = std::sqrt(1 + r[0] - r[4] - r[8]) * 2;
+        q = {(r[7] - r[5]) / s, s / 4, (r[1] + r[3]) / s, (r[2] + r[6]) / s};
+      } else if (r[4] > r[8]) {
+        double s = std::sqrt(1 + r[4] - r[0] - r[8]) * 2;
+        q = {(r[2] - r[6]) / s, (r[1] + r[3]) / s, s / 4, (r[5] + r[7]) / s};
+      } else {
+        double s = std::sqrt(1 + r[8] - r[0] - r[4]) * 2;
+        q = {(r[3] - r[1]) / s, (r[2] + r[6]) / s, (r[5] + r[7]) / s, s / 4};
+      }
+      return q;
+    }
+  }  // namespace so3
+}  // namespace tskpub
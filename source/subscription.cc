@@ -0,0 +1,54 @@
+#include "TSKPub/subscription.hh"
+
+#include <algorithm>
+
+namespace {
+  /// @brief A subscription prefix matches every message of the topic, a
+  ///        longer prefix still needs the topic to be captured
+  bool matches(const std::string& prefix, const std::string& topic) {
+    auto n = std::min(prefix.size(), topic.size());
+    return prefix.compare(0, n, topic, 0, n) == 0;
+  }
+}  // namespace
+
+namespace tskpub {
+  SubscriptionTracker::SubscriptionTracker(std::vector<std::string> topics,
+                                           Callback callback)
+      : topics_(std::move(topics)),
+        wanted_(topics_.size(), false),
+        callback_(std::move(callback)) {}
+
+  bool SubscriptionTracker::update(const uint8_t* data, size_t size) {
+    if (size == 0 || data[0] > 1) return false;
+    std::string prefix(reinterpret_cast<const char*>(data) + 1, size - 1);
+    if (data[0] == 1) {
+      subscriptions_[prefix]++;
+    } else {
+      auto it = subscriptions_.find(prefix);
+      if (it == subscriptions_.end()) return true;
+      if (--it->second <= 0) subscriptions_.erase(it);
+    }
+
+    for (size_t i = 0; i < topics_.size(); i++) {
+      bool wanted = false;
+      for (const auto& [p, cnt] : subscriptions_) {
+        if (matches(p, topics_[i])) {
+          wanted = true;
+          break;
+        }
+      }
+      if (wanted != wanted_[i]) {
+        wanted_[i] = wanted;
+        if (callback_) callback_(topics_[i], wanted);
+      }
+    }
+    return true;
+  }
+
+  bool SubscriptionTracker::wanted(const std::string& topic) const {
+    for (size_t i = 0; i < topics_.size(); i++) {
+      if (topics_[i] == topic) return wanted_[i];
+    }
+    return false;
+  }
+}  // namespace tskpub
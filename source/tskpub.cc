@@ -1,56 +1,276 @@
 #include "TSKPub/tskpub.hh"
 
+#include <TSKPub/msg/TopicDictionary.capnp.h>
+#include <capnp/serialize-packed.h>
 #include <spdlog/spdlog.h>
 
+#include <atomic>
 #include <fkYAML/node.hpp>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
 
 #include "common.hh"
 #include "reader/reader.hh"
 
-namespace {
-  std::unordered_map<std::string, tskpub::Reader::Ptr> sensor_reader_map;
-}  // namespace
-
 namespace tskpub {
-  TSKPub::TSKPub(const std::string &config_file) {
-    // Load config file
-    GlobalParams::get_instance().load_params(config_file);
-    // Init logger
-    Log::init();
-
-    // Get all sensor names from config file
-    auto sensors = GlobalParams::get_instance()
+  namespace {
+    // live TSKPub objects, they share the config and the logger
+    std::mutex instances_mtx;
+    size_t instances = 0;
+
+    /// @brief Drop one object, the last one destroys the config and the
+    ///        logger
+    void release() {
+      std::lock_guard<std::mutex> lock(instances_mtx);
+      if (--instances > 0) return;
+      // Destroy global params
+      GlobalParams::get_instance().destroy();
+      // Destroy logger
+      Log::destory();
+    }
+  }  // namespace
+
+  struct TSKPub::Impl {
+    /// @brief Sensor entry, handles index into sensors
+    struct Sensor {
+      std::string name;
+      Reader::Ptr reader;
+      ReadCounter *counter;
+      // set by the open thread
+      std::unique_ptr<std::atomic<bool>> failed;
+    };
+
+    std::vector<Sensor> sensors;
+    // sensor name -> index, only used to resolve handles
+    std::unordered_map<std::string, size_t> sensor_index;
+    // threads opening the devices
+    std::vector<std::thread> open_threads;
+    // the app ready phase is only recorded once
+    std::atomic<bool> all_ready{false};
+    // sequence number of the dictionary messages
+    std::atomic<uint32_t> dictionary_seq{0};
+
+    /// @brief Find the sensor of a handle
+    /// @return nullptr and a log if the handle is invalid
+    Sensor *find(SensorHandle h) {
+      if (h.index() >= sensors.size()) {
+        Log::critical("Invalid sensor handle");
+        return nullptr;
+      }
+      return &sensors[h.index()];
+    }
+
+    /// @brief Find a sensor by name
+    /// @return nullptr if the sensor is unknown
+    Sensor *find(const std::string &sensor_name) {
+      auto it = sensor_index.find(sensor_name);
+      return it == sensor_index.end() ? nullptr : &sensors[it->second];
+    }
+  };
+
+  TSKPub::TSKPub(const std::string &config_file)
+      : impl_(std::make_unique<Impl>()) {
+    {
+      // the first object loads the config and creates the logger, the
+      // others share them
+      std::lock_guard<std::mutex> lock(instances_mtx);
+      if (instances == 0) {
+        Startup::reset();
+        // Load config file
+        GlobalParams::get_instance().load_params(config_file);
+        // Init logger
+        Log::init();
+      }
+      instances++;
+    }
+
+    // Create reader for each sensor
+    auto &sensors = impl_->sensors;
+    try {
+      // Get all sensor names from config file
+      auto names = GlobalParams::get_instance()
                        .yml["sensors"]
                        .get_value<std::vector<std::string>>();
+      for (auto &sensor_name : names) {
+        auto &params = tskpub::GlobalParams::get_instance().yml[sensor_name];
+        const auto &type = params["type"].get_value_ref<const std::string &>();
+        impl_->sensor_index[sensor_name] = sensors.size();
+        sensors.push_back({sensor_name,
+                           ReaderFactory::create(type, sensor_name),
+                           &ReadStats::counter(sensor_name),
+                           std::make_unique<std::atomic<bool>>(false)});
+      }
+    } catch (...) {
+      // no destructor runs for a failed constructor
+      sensors.clear();
+      release();
+      throw;
+    }
+    Startup::record("app", "created");
 
-    // Create reader for each sensor
-    for (auto &sensor_name : sensors) {
-      auto &params = tskpub::GlobalParams::get_instance().yml[sensor_name];
-      const auto &type = params["type"].get_value_ref<const std::string &>();
-      sensor_reader_map[sensor_name] = ReaderFactory::create(type, sensor_name);
+    // Open devices concurrently, the slowest one bounds the startup time.
+    // read() skips a sensor until its open finished, so a failed open
+    // stays here instead of throwing on the reading threads
+    for (const auto &s : sensors) {
+      impl_->open_threads.emplace_back(
+          [reader = s.reader, name = s.name, failed = s.failed.get()] {
+            try {
+              reader->open();
+            } catch (const std::exception &e) {
+              *failed = true;
+              Startup::record(name, "failed");
+              Log::critical("Failed to open " + name + ": " + e.what());
+            }
+          });
     }
   }
 
   TSKPub::~TSKPub() {
-    // Destroy global params
-    GlobalParams::get_instance().destroy();
-    // Destroy logger
-    Log::destory();
+    for (auto &t : impl_->open_threads) t.join();
+    // Close the devices
+    impl_.reset();
+    release();
   }
 
-  MsgConstPtr TSKPub::read(const std::string &sensor_name) const {
-    auto it = sensor_reader_map.find(sensor_name);
-    if (it == sensor_reader_map.end()) {
-      // if sensor_name is not found, return nullptr
+  SensorHandle TSKPub::handle(const std::string &sensor_name) const {
+    auto it = impl_->sensor_index.find(sensor_name);
+    if (it == impl_->sensor_index.end()) {
       Log::critical("No reader for sensor: " + sensor_name);
-      return nullptr;
+      return {};
     }
-    auto msg = it->second->read();
+    return SensorHandle(it->second);
+  }
+
+  MsgConstPtr TSKPub::read(const std::string &sensor_name) const {
+    auto h = handle(sensor_name);
+    return h.valid() ? read(h) : nullptr;
+  }
+
+  MsgConstPtr TSKPub::read(SensorHandle h) const {
+    auto s = impl_->find(h);
+    // opening in the background or failed
+    if (!s || !s->reader->opened()) return nullptr;
+    auto msg = s->reader->read();
 
-    // Update total read bytes
-    GlobalParams::get_instance().total_read_bytes += msg ? msg->size() : 0;
+    // Update read bytes of this sensor only, no cache line is shared
+    if (msg) {
+      s->counter->bytes.fetch_add(msg->size(), std::memory_order_relaxed);
+    }
     return msg;
   }
+
+  std::vector<MsgConstPtr> TSKPub::refinements(SensorHandle h) const {
+    auto s = impl_->find(h);
+    if (!s) return {};
+    auto msgs = s->reader->refinements();
+    for (const auto &msg : msgs) {
+      s->counter->bytes.fetch_add(msg->size(), std::memory_order_relaxed);
+    }
+    return msgs;
+  }
+
+  void TSKPub::pause(const std::string &sensor_name) {
+    auto h = handle(sensor_name);
+    if (h.valid()) impl_->sensors[h.index()].reader->pause();
+  }
+
+  void TSKPub::resume(const std::string &sensor_name) {
+    auto h = handle(sensor_name);
+    if (h.valid()) impl_->sensors[h.index()].reader->resume();
+  }
+
+  bool TSKPub::wait_ready(std::chrono::milliseconds timeout) const {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+      std::string missing;
+      for (const auto &s : impl_->sensors) {
+        if (s.reader->ready() || s.reader->paused()) continue;
+        missing += " " + s.name + (*s.failed ? " (failed)" : "");
+      }
+      if (missing.empty()) {
+        if (!impl_->all_ready.exchange(true)) Startup::record("app", "ready");
+        return true;
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        Log::debug("Sensors not ready:" + missing);
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+
+  bool TSKPub::ready(const std::string &sensor_name) const {
+    auto s = impl_->find(sensor_name);
+    return s && s->reader->ready();
+  }
+
+  bool TSKPub::failed(const std::string &sensor_name) const {
+    auto s = impl_->find(sensor_name);
+    return s && *s->failed;
+  }
+
+  bool TSKPub::failed(SensorHandle h) const {
+    const auto &sensors = impl_->sensors;
+    return h.index() < sensors.size() && *sensors[h.index()].failed;
+  }
+
+  bool TSKPub::paused(const std::string &sensor_name) const {
+    auto s = impl_->find(sensor_name);
+    return s && s->reader->paused();
+  }
+
+  bool TSKPub::paused(SensorHandle h) const {
+    const auto &sensors = impl_->sensors;
+    return h.index() < sensors.size() && sensors[h.index()].reader->paused();
+  }
+
+  void TSKPub::drop(SensorHandle h, DropStage stage, uint64_t n) const {
+    const auto &sensors = impl_->sensors;
+    if (h.index() >= sensors.size()) return;
+    sensors[h.index()].counter->dropped[size_t(stage)].fetch_add(
+        n, std::memory_order_relaxed);
+  }
+
+  MsgConstPtr TSKPub::dictionary() const {
+    const auto &yml = GlobalParams::get_instance().yml;
+    const auto &sensors = impl_->sensors;
+    auto stamp = nano_now();
+    capnp::MallocMessageBuilder builder;
+    auto dict = builder.initRoot<TopicDictionary>();
+    dict.setTimestamp(stamp);
+    auto entries = dict.initEntries(sensors.size());
+    for (size_t i = 0; i < sensors.size(); i++) {
+      const auto &r = *sensors[i].reader;
+      entries[i].setId(r.topic_id());
+      entries[i].setSensor(r.sensor_name());
+      entries[i].setTopic(r.topic());
+      if (yml[r.sensor_name()].contains("frame_id")) {
+        entries[i].setFrameId(
+            yml[r.sensor_name()]["frame_id"].get_value<std::string>());
+      }
+      entries[i].setSchema(static_cast<uint8_t>(r.schema()));
+    }
+
+    FrameHeader hdr;
+    hdr.schema = Schema::TopicDictionary;
+    hdr.topic_id = FrameHeader::DictionaryId;
+    hdr.seq = impl_->dictionary_seq++;
+    hdr.stamp = stamp;
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    auto body = out.getArray();
+    auto ret = std::make_shared<Msg>(FrameHeader::Size + body.size());
+    hdr.encode(ret->data());
+    std::copy(body.begin(), body.end(), ret->begin() + FrameHeader::Size);
+    return ret;
+  }
+
+  bool TSKPub::set_params(
+      const std::string &sensor_name,
+      const std::unordered_map<std::string, double> &params) {
+    auto h = handle(sensor_name);
+    return h.valid() && impl_->sensors[h.index()].reader->set_params(params);
+  }
 }  // namespace tskpub
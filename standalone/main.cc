@@ -1,9 +1,21 @@
 #define SPDLOG_ACTIVE_LEVEL SPDLOG_LEVEL_DEBUG
 #include <spdlog/spdlog.h>
 
+#include <TSKPub/bundle.hh>
+#include <TSKPub/executor.hh>
+#include <TSKPub/frame.hh>
+#include <TSKPub/msg/Control.capnp.h>
+#include <TSKPub/queue.hh>
+#include <TSKPub/shaper.hh>
+#include <TSKPub/socket.hh>
+#include <TSKPub/subscription.hh>
 #include <TSKPub/tskpub.hh>
+#include <capnp/serialize-packed.h>
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <csignal>
 #include <cxxopts.hpp>
 #include <deque>
@@ -32,12 +44,26 @@ namespace {
     using Ptr = std::unique_ptr<Publisher>;
     // ZMQ socket for publishing
     zmq::socket_t socket;
-    // ZMQ socket for inproc communication (message queue)
-    zmq::socket_t queue;
+    // Bounded queue from the reading threads
+    tskpub::MessageQueue queue;
     // Address to bind
     std::string address;
+    // Traffic shaper between the queue and the socket
+    tskpub::Shaper shaper;
+    // Subscriptions seen on the socket
+    tskpub::SubscriptionTracker tracker;
+    // messages start with the topic frame and a FrameHeader
+    bool framed;
+    // builds the topic dictionary, only used if framed
+    std::function<tskpub::MsgConstPtr()> dictionary;
+    // counts messages the shaper dropped, by sensor name
+    std::function<void(const std::string&, uint64_t)> on_drop;
+    // dictionary period in ns and the time of the next one
+    uint64_t dictionary_interval;
+    uint64_t next_dictionary;
     Publisher() = delete;
-    Publisher(const std::string& address, int max_msg_size);
+    Publisher(const std::string& address, int max_msg_size,
+              tskpub::SubscriptionTracker::Callback on_subscription);
     ~Publisher();
 
     /// @brief Recv message from queue and send it to socket
@@ -52,13 +78,31 @@ namespace {
         .count();
   }
 
+  /// @brief Get monotonic time in nanoseconds
+  /// @return ns in uint64_t
+  uint64_t steady_nano_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
   struct Rate {
     // sleep interval in ms
     int64_t interval;
     // start time of current round
     int64_t start;
 
-    Rate(int rate) : interval(int64_t(1e3 / rate)), start(milli_now()) {}
+    Rate(double rate) : interval(int64_t(1e3 / rate)), start(milli_now()) {}
+
+    /// @brief Start the next round
+    /// @return time in ms to run the next round at
+    int64_t advance();
+
+    /// @brief Time until the current round ends
+    /// @return ms, 0 if it is over
+    int64_t remaining() const {
+      return std::max<int64_t>(0, start + interval - milli_now());
+    }
 
     void sleep();
   };
@@ -79,6 +123,42 @@ namespace {
     void update();
   };
 
+  /// @brief Runtime state of a sensor, changed by the control channel and
+  ///        the subscriptions while the reader thread is running
+  struct SensorState {
+    // read rate in Hz
+    std::atomic<double> rate;
+    // enabled through the control channel
+    std::atomic<bool> enabled{true};
+    // has subscribers, always true if sensors are not lazy
+    std::atomic<bool> wanted{true};
+  };
+
+  /// @brief Periodic read of a sensor, run on the executor workers
+  struct SensorJob {
+    std::string name;
+    tskpub::SensorHandle handle;
+    tskpub::Executor::Priority priority;
+    // rate of r in Hz
+    double rate;
+    Rate r;
+    Freq f;
+    // time of the next read in ms, only changed by the running job
+    int64_t next;
+    // submitted and not finished yet
+    bool busy{false};
+
+    SensorJob(const std::string& name, tskpub::SensorHandle handle,
+              tskpub::Executor::Priority priority, double rate)
+        : name(name),
+          handle(handle),
+          priority(priority),
+          rate(rate),
+          r(rate),
+          f(name),
+          next(milli_now()) {}
+  };
+
   struct Impl {
     using Ptr = std::unique_ptr<Impl>;
 
@@ -88,11 +168,25 @@ namespace {
     // config file path
     std::string config_file_path;
 
-    // reader threads
+    // scheduler, control and startup report threads
     std::deque<std::thread> threads;
 
+    // wakes up the scheduler when a job finished
+    std::mutex sched_mtx;
+    std::condition_variable sched_cv;
+
     // Publisher object
     Publisher::Ptr socket;
+
+    // optional sensor bundles, fed by the reading jobs
+    std::unique_ptr<tskpub::Bundler> bundler;
+
+    // sensor name -> state, filled in init() and never changed after
+    std::unordered_map<std::string, std::unique_ptr<SensorState>> states;
+
+    // serializes update_pause() between the publisher thread (subscriptions)
+    // and the control thread, so the last state always wins
+    std::mutex pause_mtx;
     Impl() = delete;
     Impl(const std::string& config_path);
     ~Impl();
@@ -102,23 +196,131 @@ namespace {
 
     // Main loop
     void run();
+
+    // Submit the sensor reads to the executor at their rates until stop
+    void schedule(const std::vector<std::string>& sensors);
+
+    // Read a sensor once and hand the message over to the publisher
+    void read_once(SensorJob& job);
+
+    // Pause or resume a sensor from its state
+    void update_pause(const std::string& name);
+
+    // Serve control requests on a REP socket until stop
+    void control(const std::string& address);
+
+    // Handle one control request
+    void handle(const ControlRequest::Reader& req,
+                ControlResponse::Builder& resp);
   };
 }  // namespace
 
-Publisher::Publisher(const std::string& address, int max_msg_size)
-    : socket(*context, zmq::socket_type::pub),
-      queue(*context, zmq::socket_type::pull),
-      address(address) {
-  // always send the latest message
-  socket.set(zmq::sockopt::conflate, 1);
+/// @brief Whether the config selects the framed message layout
+/// @return true for framing: header, false for the legacy name prefix
+bool is_framed() {
+  return params["app"].contains("framing")
+         && params["app"]["framing"].get_value<std::string>() == "header";
+}
+
+/// @brief Topics seen by the subscription tracker, subscribers filter on the
+///        topic frames if the messages are framed
+/// @return Sensor names or topic frames
+std::vector<std::string> tracked_topics() {
+  auto names = params["sensors"].get_value<std::vector<std::string>>();
+  if (is_framed()) {
+    for (auto& name : names) name = tskpub::topic_frame(name);
+  }
+  return names;
+}
+
+/// @brief Set the per sensor limits of the queue from the config file
+/// @param queue Queue between the reading threads and the publisher
+void add_queue_topics(tskpub::MessageQueue& queue) {
+  for (const auto& name :
+       params["sensors"].get_value<std::vector<std::string>>()) {
+    tskpub::MessageQueue::TopicParams tp;
+    if (params[name].contains("queue")) {
+      const auto& cfg = params[name]["queue"];
+      tp.max_msgs = cfg["size"].get_value<size_t>();
+      tp.max_bytes = cfg["bytes"].get_value<size_t>();
+      auto policy = cfg["policy"].get_value<std::string>();
+      // drop_oldest keeps the freshest data, like the shaper does
+      if (policy == "block") {
+        tp.policy = tskpub::MessageQueue::Policy::Block;
+        // the reads run on the shared executor, a blocked worker would
+        // starve the other sensors, so it waits one period at most
+        tp.max_wait = std::chrono::nanoseconds(
+            int64_t(1e9 / params[name]["rate"].get_value<double>()));
+      } else if (policy == "drop_newest") {
+        tp.policy = tskpub::MessageQueue::Policy::DropNewest;
+      }
+    }
+    queue.add_topic(name, tp);
+  }
+}
+
+/// @brief Create the traffic shaper from the config file
+/// @return tskpub::Shaper
+tskpub::Shaper make_shaper() {
+  // no shaper section means an unlimited link
+  double rate = 0, burst = 0;
+  if (params["app"].contains("shaper")) {
+    const auto& cfg = params["app"]["shaper"];
+    rate = cfg["rate"].get_value<double>();
+    burst = cfg["burst"].get_value<double>();
+  }
+  tskpub::Shaper shaper(rate, burst);
+
+  for (const auto& name :
+       params["sensors"].get_value<std::vector<std::string>>()) {
+    tskpub::Shaper::TopicParams tp;
+    if (params[name].contains("shaper")) {
+      const auto& cfg = params[name]["shaper"];
+      tp.priority = cfg["priority"].get_value<int>();
+      tp.weight = cfg["weight"].get_value<double>();
+      tp.rate = cfg["rate"].get_value<double>();
+      tp.burst = cfg["burst"].get_value<double>();
+      tp.queue_size = cfg["queue"].get_value<size_t>();
+      tp.policy = cfg["policy"].get_value<std::string>() == "drop"
+                      ? tskpub::Shaper::Policy::Drop
+                      : tskpub::Shaper::Policy::Delay;
+    }
+    shaper.add_topic(name, tp);
+  }
+  INFO("Shaper: link rate {} B/s, burst {} B", rate, burst);
+  return shaper;
+}
+
+Publisher::Publisher(const std::string& address, int max_msg_size,
+                     tskpub::SubscriptionTracker::Callback on_subscription)
+    : socket(*context, zmq::socket_type::xpub),
+      // no ceiling means the per sensor limits only
+      queue(params["app"].contains("queue_memory")
+                ? params["app"]["queue_memory"].get_value<size_t>()
+                : 0),
+      address(address),
+      shaper(make_shaper()),
+      tracker(tracked_topics(), std::move(on_subscription)),
+      framed(is_framed()),
+      dictionary_interval(1e9),
+      next_dictionary(0) {
+  if (params["app"].contains("dictionary_interval")) {
+    dictionary_interval = uint64_t(
+        params["app"]["dictionary_interval"].get_value<double>() * 1e9);
+  }
+  // the shaper drops and delays, the socket keeps what it is given
+  int sndhwm = tskpub::SendHighWater;
+  if (params["app"].contains("send_hwm")) {
+    sndhwm = params["app"]["send_hwm"].get_value<int>();
+  }
+  tskpub::setup_publisher(socket, sndhwm);
   socket.bind(address);
 
-  // innner process communication
-  queue.bind("inproc://tinysk");
+  add_queue_topics(queue);
 }
 
 Publisher::~Publisher() {
-  // stop the queue first to stop message receiving
+  // release blocked reading threads
   queue.close();
   // close the socket
   socket.close();
@@ -128,18 +330,63 @@ void Publisher::work() {
   Freq f("Publisher");
   Rate r(params["app"]["checking_rate"].get_value<int>());
   while (is_running) {
-    zmq::message_t msg;
-    if (!queue.recv(msg, zmq::recv_flags::dontwait)) {
-      // no message in queue, sleep for a while
-      r.sleep();
-      continue;
+    auto now = steady_nano_now();
+
+    // subscription changes pause and resume the sensors
+    zmq::message_t sub;
+    while (socket.recv(sub, zmq::recv_flags::dontwait)) {
+      tracker.update(sub.data<uint8_t>(), sub.size());
+    }
+
+    // move everything in the queue into the shaper
+    std::string topic;
+    uint8_t level = 0;
+    while (auto msg = queue.pop(&topic, &level)) {
+      // a push drops either this message or a queued one
+      auto dropped = shaper.stats(topic).dropped_msgs;
+      shaper.push(topic, std::move(msg), now, level);
+      dropped = shaper.stats(topic).dropped_msgs - dropped;
+      if (dropped && on_drop) on_drop(topic, dropped);
+    }
+
+    // subscribers need the topic dictionary to map the topic ids
+    if (framed && dictionary && now >= next_dictionary) {
+      shaper.push(tskpub::dictionary_topic(), dictionary(), now);
+      next_dictionary = now + dictionary_interval;
+    }
+
+    // send whatever the link budget allows
+    bool sent = false;
+    // framed payloads carry no sensor name, the topic frame goes first so
+    // that subscribers can still filter on it
+    while (auto msg = shaper.pop(now, &topic)) {
+      tskpub::send_message(socket, topic, *msg, framed);
+      f.update();
+      sent = true;
+    }
+
+    // nothing to do, sleep for a while. A delayed message may become
+    // sendable before the next check, only sleep until then
+    if (!sent) {
+      auto wait = shaper.next_ready(steady_nano_now());
+      if (wait < uint64_t(r.remaining()) * 1000000) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+      } else {
+        r.sleep();
+      }
     }
-    socket.send(msg, zmq::send_flags::none);
-    f.update();
   }
 }
 
 void Rate::sleep() {
+  auto wake = advance();
+  auto now = milli_now();
+  if (wake > now) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(wake - now));
+  }
+}
+
+int64_t Rate::advance() {
   // expected end time = current round start time + sleep interval
   auto expected_end = start + interval;
   auto actual_end = milli_now();
@@ -160,11 +407,10 @@ void Rate::sleep() {
       // round = actual ending time
       start = actual_end;
     }
-  } else {
-    // Otherwise, sleep until the estimated end time
-    std::this_thread::sleep_for(
-        std::chrono::milliseconds(expected_end - actual_end));
+    return actual_end;
   }
+  // Otherwise, wait until the estimated end time
+  return expected_end;
 }
 
 Freq::Freq(const std::string& name)
@@ -194,13 +440,16 @@ Impl::Impl(const std::string& config_path)
 
 Impl::~Impl() {
   WARN("Destroying Impl");
-  // destroy Publisher first to stop the message sending
-  socket.reset();
+  // release the reading threads blocked on a full queue
+  if (socket) socket->queue.close();
 
-  // wait all threads to stop
+  // wait all threads to stop, they push into the queue of Publisher
   std::for_each(threads.begin(), threads.end(),
                 std::mem_fn(&std::thread::join));
 
+  // destroy Publisher after its producers
+  socket.reset();
+
   // unrefence the logger
   spdlog::drop(logger->name());
 
@@ -227,8 +476,48 @@ void Impl::init() {
   context = std::make_optional<zmq::context_t>(3);
   std::string address{"tcp://*:"};
   address += std::to_string(params["app"]["port"].get_value<int>());
+  // lazy sensors only capture while someone is subscribed to them
+  bool lazy = params["app"].contains("lazy")
+              && params["app"]["lazy"].get_value<bool>();
+  for (const auto& name :
+       params["sensors"].get_value<std::vector<std::string>>()) {
+    auto& st = states[name] = std::make_unique<SensorState>();
+    st->rate = params[name]["rate"].get_value<double>();
+    st->wanted = !lazy;
+    update_pause(name);
+  }
+  auto on_subscription = [this, lazy](std::string name, bool wanted) {
+    // framed topics end with the terminating zero of the topic frame
+    if (!name.empty() && name.back() == '\0') name.pop_back();
+    INFO("{} {} subscribers", name, wanted ? "has" : "lost all");
+    if (!lazy) return;
+    states.at(name)->wanted = wanted;
+    update_pause(name);
+  };
   socket = std::make_unique<Publisher>(
-      address, params["app"]["max_message_size"].get_value<int>());
+      address, params["app"]["max_message_size"].get_value<int>(),
+      on_subscription);
+  socket->dictionary = [this]() { return pub->dictionary(); };
+  socket->on_drop = [this](const std::string& name, uint64_t n) {
+    // the dictionary is sent again anyway, bundles have no reader
+    if (name == tskpub::dictionary_topic() || name == tskpub::bundle_topic())
+      return;
+    pub->drop(pub->handle(name), tskpub::DropStage::Shaper, n);
+  };
+  if (params["app"].contains("bundle")) {
+    // the bundles refer to the frame headers of the messages
+    if (!is_framed()) throw std::runtime_error("Bundles need framing: header");
+    const auto& cfg = params["app"]["bundle"];
+    tskpub::Bundler::Params bp;
+    bp.lidar = cfg["lidar"].get_value<std::string>();
+    if (cfg.contains("camera"))
+      bp.camera = cfg["camera"].get_value<std::string>();
+    if (cfg.contains("imu")) bp.imu = cfg["imu"].get_value<std::string>();
+    if (cfg.contains("max_delay"))
+      bp.max_delay = cfg["max_delay"].get_value<double>();
+    bundler = std::make_unique<tskpub::Bundler>(bp);
+    INFO("Bundling {} with {} and {}", bp.lidar, bp.camera, bp.imu);
+  }
   INFO("App Start");
 }
 
@@ -236,45 +525,230 @@ void Impl::run() {
   // get all sensor names from config file
   auto sensors = params["sensors"].get_value<std::vector<std::string>>();
 
-  // create read thread for each sensor
-  for (const auto& name : sensors) {
-    threads.emplace_back([&]() {
-      Rate r(params[name]["rate"].get_value<size_t>());
-      Freq f(name);
-
-      // create the zmq inproc socket to send message to Publisher
-      zmq::socket_t queue(*context, zmq::socket_type::push);
-      queue.connect("inproc://tinysk");
-
-      // keep running until stop
-      while (is_running) {
-        auto msg = pub->read(name);
-        if (!msg) {
-          DEBUG("Failed to read from {}", name);
-          continue;
-        }
-        DEBUG("Read {} bytes from {}", msg->size(), name);
-
-        // zero copy to transfer the message to Publisher
-        zmq::const_buffer buf(msg->data(), msg->size());
-        queue.send(buf, zmq::send_flags::none);
-
-        // update frequency
-        f.update();
-
-        // sleep for a while
-        r.sleep();
+  // optional control channel
+  if (params["app"].contains("control_port")) {
+    std::string address{"tcp://*:"};
+    address += std::to_string(params["app"]["control_port"].get_value<int>());
+    threads.emplace_back([this, address]() { control(address); });
+  }
+
+  // report the startup time, the devices are opened in the background
+  threads.emplace_back([this]() {
+    auto timeout = std::chrono::seconds(30);
+    if (params["app"].contains("startup_timeout")) {
+      timeout = std::chrono::seconds(
+          params["app"]["startup_timeout"].get_value<int>());
+    }
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (is_running && std::chrono::steady_clock::now() < deadline) {
+      if (pub->wait_ready(std::chrono::milliseconds(100))) {
+        INFO("All sensors ready");
+        return;
       }
+    }
+    if (is_running) WARN("Not all sensors ready after {} s", timeout.count());
+  });
 
-      // close the queue socket
-      queue.close();
-    });
-  }
+  // the sensors share the executor workers instead of a thread each
+  threads.emplace_back([this, sensors]() { schedule(sensors); });
 
   // start recv message from queue and send it to socket
   socket->work();
 }
 
+void Impl::schedule(const std::vector<std::string>& sensors) {
+  auto& executor = tskpub::Executor::shared();
+  INFO("Reading {} sensors on {} workers", sensors.size(), executor.size());
+  std::vector<std::unique_ptr<SensorJob>> jobs;
+  for (const auto& name : sensors) {
+    // IMU samples are small and latency sensitive, status is neither
+    auto type = params[name]["type"].get_value<std::string>();
+    auto priority = type == "Imu"      ? tskpub::Executor::Priority::High
+                    : type == "Status" ? tskpub::Executor::Priority::Low
+                                       : tskpub::Executor::Priority::Normal;
+    auto rate = states.at(name)->rate.load();
+    jobs.push_back(std::make_unique<SensorJob>(name, pub->handle(name),
+                                               priority, rate));
+  }
+
+  std::unique_lock<std::mutex> lock(sched_mtx);
+  while (is_running) {
+    auto now = milli_now();
+    auto wake = now + 100;
+    for (auto& job : jobs) {
+      if (job->busy) continue;
+      if (job->next <= now) {
+        job->busy = true;
+        executor.submit([this, &job = *job]() { read_once(job); },
+                        job->priority);
+        continue;
+      }
+      wake = std::min(wake, job->next);
+    }
+    // a finished job may be due before wake
+    sched_cv.wait_for(lock, std::chrono::milliseconds(wake - now));
+  }
+
+  // the jobs refer to the publisher queue
+  sched_cv.wait(lock, [&jobs]() {
+    return std::none_of(jobs.begin(), jobs.end(),
+                        [](const auto& job) { return job->busy; });
+  });
+}
+
+void Impl::read_once(SensorJob& job) {
+  // the rate may be changed by the control channel
+  auto& st = *states.at(job.name);
+  if (st.rate != job.rate) {
+    job.rate = st.rate;
+    job.r = Rate(job.rate);
+    INFO("{} rate changed to {} Hz", job.name, job.rate);
+  }
+
+  int64_t next;
+  // an escaping exception would leave the job busy forever: the scheduler
+  // would never run it again and shutdown would wait for it
+  try {
+    auto msg = pub->read(job.handle);
+    if (msg) {
+      DEBUG("Read {} bytes from {}", msg->size(), job.name);
+      // hand the message over to Publisher without copying, the sensor
+      // policy decides between dropping and waiting when it is full
+      auto dropped = socket->queue.push(job.name, msg);
+      // finer layers follow the message, a full queue drops them first
+      auto layers = pub->refinements(job.handle);
+      for (size_t i = 0; i < layers.size(); i++) {
+        dropped += socket->queue.push(job.name, layers[i], i + 1);
+      }
+      if (dropped) pub->drop(job.handle, tskpub::DropStage::Queue, dropped);
+      // the bundle only refers to the message, which is published on its own
+      if (bundler) {
+        if (auto bundle = bundler->add(job.name, *msg))
+          socket->queue.push(tskpub::bundle_topic(), bundle);
+      }
+      job.f.update();
+      next = job.r.advance();
+    } else {
+      DEBUG("Failed to read from {}", job.name);
+      // nobody is subscribed or the device failed to open: wait at the
+      // sensor rate, otherwise retry soon
+      next = pub->paused(job.handle) || pub->failed(job.handle)
+                 ? job.r.advance()
+                 : milli_now() + 1;
+    }
+  } catch (const std::exception& e) {
+    ERROR("Failed to read from {}: {}", job.name, e.what());
+    next = job.r.advance();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(sched_mtx);
+    job.next = next;
+    job.busy = false;
+  }
+  sched_cv.notify_one();
+}
+
+void Impl::update_pause(const std::string& name) {
+  std::lock_guard<std::mutex> lock(pause_mtx);
+  const auto& st = *states.at(name);
+  if (st.enabled && st.wanted) {
+    pub->resume(name);
+  } else {
+    pub->pause(name);
+  }
+}
+
+void Impl::control(const std::string& address) {
+  zmq::socket_t rep(*context, zmq::socket_type::rep);
+  // wake up regularly to check is_running
+  rep.set(zmq::sockopt::rcvtimeo, 100);
+  rep.bind(address);
+  INFO("Control channel on {}", address);
+
+  while (is_running) {
+    zmq::message_t req;
+    if (!rep.recv(req, zmq::recv_flags::none)) continue;
+
+    capnp::MallocMessageBuilder builder;
+    auto resp = builder.initRoot<ControlResponse>();
+    try {
+      kj::ArrayInputStream in(kj::ArrayPtr<const kj::byte>(
+          req.data<const kj::byte>(), req.size()));
+      capnp::PackedMessageReader reader(in);
+      handle(reader.getRoot<ControlRequest>(), resp);
+    } catch (const std::exception& e) {
+      resp.setOk(false);
+      resp.setError(e.what());
+    }
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    auto arr = out.getArray();
+    rep.send(zmq::buffer(arr.begin(), arr.size()), zmq::send_flags::none);
+  }
+  rep.close();
+}
+
+void Impl::handle(const ControlRequest::Reader& req,
+                  ControlResponse::Builder& resp) {
+  std::string name = req.getSensor();
+  std::vector<std::string> names;
+  if (name.empty()) {
+    names = params["sensors"].get_value<std::vector<std::string>>();
+  } else if (states.count(name)) {
+    names.push_back(name);
+  } else {
+    resp.setOk(false);
+    resp.setError("Unknown sensor: " + name);
+    return;
+  }
+
+  if (!name.empty()) {
+    // reader params first, they are the only part that can be rejected
+    std::unordered_map<std::string, double> rp;
+    if (req.getCloudSize()) rp["cloud_size"] = req.getCloudSize();
+    if (req.getQuality()) rp["quality"] = req.getQuality();
+    if (req.getWidth()) rp["width"] = req.getWidth();
+    if (req.getHeight()) rp["height"] = req.getHeight();
+    if (req.getSnapshot()) rp["snapshot"] = 1;
+    if (req.hasLidarFilter()) {
+      auto flt = req.getLidarFilter();
+      rp["medianSize"] = flt.getMedianSize();
+      rp["kalmanEnable"] = flt.getKalmanEnable();
+      rp["kalmanFactor"] = flt.getKalmanFactor();
+      rp["kalmanThreshold"] = flt.getKalmanThreshold();
+      rp["edgeEnable"] = flt.getEdgeEnable();
+      rp["edgeThreshold"] = flt.getEdgeThreshold();
+      rp["dustEnable"] = flt.getDustEnable();
+      rp["dustThreshold"] = flt.getDustThreshold();
+      rp["dustFrames"] = flt.getDustFrames();
+    }
+    if (!rp.empty() && !pub->set_params(name, rp)) {
+      resp.setOk(false);
+      resp.setError("Invalid parameters for " + name);
+      return;
+    }
+
+    auto& st = *states.at(name);
+    if (req.getRate() > 0) st.rate = req.getRate();
+    if (req.getEnabled() != ControlRequest::Enabled::KEEP) {
+      st.enabled = req.getEnabled() == ControlRequest::Enabled::ENABLE;
+      update_pause(name);
+    }
+    INFO("Control request applied to {}", name);
+  }
+
+  resp.setOk(true);
+  auto list = resp.initSensors(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    const auto& st = *states.at(names[i]);
+    list[i].setSensor(names[i]);
+    list[i].setRate(st.rate);
+    list[i].setEnabled(st.enabled);
+    list[i].setPaused(pub->paused(names[i]));
+  }
+}
+
 /// @brief Parse command line arguments
 /// @param argc
 /// @param argv
@@ -8,6 +8,7 @@
 #include <fkYAML/node.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <thread>
 
@@ -44,6 +45,13 @@ namespace {
     }
 
     size_t read_streamly(const std::string &sensor_name, size_t n) const {
+      // read() returns nothing until the background open finished
+      using clock = std::chrono::steady_clock;
+      auto deadline = clock::now() + std::chrono::seconds(10);
+      while (!pub.ready(sensor_name) && !pub.failed(sensor_name)
+             && clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
       size_t cnt = 0;
       Rate r(yml[sensor_name]["rate"].get_value<int>());
       for (size_t i = 0; i < n; i++) {
@@ -93,6 +101,14 @@ TEST_CASE("read<Status>") {
   CHECK(num == 5);
 }
 
+// the config and the logger outlive the first of two objects
+TEST_CASE("instances") {
+  auto first = std::make_unique<Fixture>();
+  Fixture second;
+  first.reset();
+  CHECK(second.read_streamly("info", 3) == 3);
+}
+
 TEST_CASE("read<Imu>") {
   std::this_thread::sleep_for(std::chrono::seconds(1));
   Fixture f;
@@ -122,10 +138,8 @@ TEST_CASE("read<Lidar>") {
   auto port = f.yml[sensor_name]["port"].get_value<std::string>();
   REQUIRE(is_device_exist(port));
   size_t max_num = 40;
-  // lazy init, so we need to read once to start the lidar
-  f.pub.read(sensor_name);
-  // lidar may take some time to start
-  std::this_thread::sleep_for(std::chrono::seconds(10));
+  // the lidar is opened in the background and takes some time to start
+  REQUIRE(f.pub.wait_ready(std::chrono::seconds(10)));
   auto num = f.read_streamly(sensor_name, max_num);
   CHECK(num > max_num * 0.5);
 }
@@ -151,9 +165,8 @@ TEST_CASE("read<All>") {
   auto sjob = std::thread([&] { snum = f.read_streamly("info", max_snum); });
   auto ijob = std::thread([&] { inum = f.read_streamly("imu0", max_inum); });
   auto cjob = std::thread([&] { cnum = f.read_streamly("video", max_cnum); });
+  REQUIRE(f.pub.wait_ready(std::chrono::seconds(10)));
   auto ljob = std::thread([&] {
-    f.pub.read("laser");
-    std::this_thread::sleep_for(std::chrono::seconds(10));
     lnum = f.read_streamly("laser", max_lnum);
   });
   sjob.join();
@@ -166,3 +179,23 @@ TEST_CASE("read<All>") {
   CHECK(cnum > max_cnum * 0.5);
   CHECK(lnum > max_lnum * 0.5);
 }
+
+TEST_CASE("startup") {
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  auto start = std::chrono::steady_clock::now();
+  Fixture f;
+  for (auto name : {"laser", "imu0", "video"}) {
+    REQUIRE(is_device_exist(f.yml[name]["port"].get_value<std::string>()));
+  }
+
+  // all devices are opened concurrently, so the cold start is bounded by
+  // the slowest one
+  REQUIRE(f.pub.wait_ready(std::chrono::seconds(10)));
+  auto ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  MESSAGE("cold start to first data on all sensors: " << ms << " ms");
+  for (auto name : {"info", "laser", "imu0", "video"}) {
+    CHECK(f.pub.ready(name));
+  }
+}
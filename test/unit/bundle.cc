@@ -0,0 +1,139 @@
+#include "TSKPub/bundle.hh"
+
+#include <TSKPub/msg/SensorBundle.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+  constexpr uint64_t ms = 1000000;
+
+  /// @brief Framed message with a dummy body
+  tskpub::Msg framed(uint16_t topic_id, uint32_t seq, uint64_t stamp,
+                     tskpub::Schema schema) {
+    tskpub::FrameHeader hdr;
+    hdr.schema = schema;
+    hdr.topic_id = topic_id;
+    hdr.seq = seq;
+    hdr.stamp = stamp;
+    tskpub::Msg msg(tskpub::FrameHeader::Size + 32, 0xab);
+    hdr.encode(msg.data());
+    return msg;
+  }
+
+  /// @brief Lidar, camera and IMU with topic ids 1, 2 and 3
+  struct Sensors {
+    tskpub::Bundler bundler{{"laser", "video", "imu", 0.1}};
+    uint32_t lidar_seq{0}, camera_seq{0}, imu_seq{0};
+
+    tskpub::MsgConstPtr lidar(uint64_t t) {
+      return bundler.add(
+          "laser", framed(1, lidar_seq++, t, tskpub::Schema::PointCloud));
+    }
+
+    tskpub::MsgConstPtr camera(uint64_t t) {
+      return bundler.add("video",
+                         framed(2, camera_seq++, t, tskpub::Schema::Image));
+    }
+
+    tskpub::MsgConstPtr imu(uint64_t t) {
+      return bundler.add("imu", framed(3, imu_seq++, t, tskpub::Schema::Imu));
+    }
+  };
+
+  /// @brief Decoded bundle message
+  struct Bundle {
+    tskpub::FrameHeader hdr;
+    std::optional<kj::ArrayInputStream> in;
+    std::optional<capnp::PackedMessageReader> reader;
+    SensorBundle::Reader root;
+
+    explicit Bundle(const tskpub::MsgConstPtr &msg) {
+      REQUIRE(hdr.decode(msg->data(), msg->size()));
+      in.emplace(kj::ArrayPtr<const kj::byte>(
+          msg->data() + tskpub::FrameHeader::Size,
+          msg->size() - tskpub::FrameHeader::Size));
+      reader.emplace(*in);
+      root = reader->getRoot<SensorBundle>();
+    }
+  };
+}  // namespace
+
+// the lidar frame arrives late, after the IMU samples that followed it
+TEST_CASE("Bundle.align") {
+  Sensors s;
+  // IMU at 200 Hz, camera at 30 Hz
+  for (uint64_t t = 5; t <= 120; t += 5) {
+    CHECK(s.imu(t * ms) == nullptr);
+    if (t % 35 == 0) CHECK(s.camera(t * ms) == nullptr);
+  }
+  // the camera and the IMU are past the frame, the bundle is complete
+  auto msg = s.lidar(100 * ms);
+  REQUIRE(msg != nullptr);
+  Bundle b(msg);
+  CHECK(b.hdr.schema == tskpub::Schema::SensorBundle);
+  CHECK(b.hdr.topic_id == tskpub::FrameHeader::BundleId);
+  CHECK(b.hdr.stamp == 100 * ms);
+  CHECK(b.root.getTimestamp() == 100 * ms);
+  CHECK(b.root.getLidar().getTopicId() == 1);
+  CHECK(b.root.getLidar().getSeq() == 0);
+  // frames at 35, 70 and 105 ms
+  REQUIRE(b.root.hasCamera());
+  CHECK(b.root.getCamera().getTopicId() == 2);
+  CHECK(b.root.getCamera().getTimestamp() == 105 * ms);
+  CHECK(b.root.getCamera().getSeq() == 2);
+  auto imu = b.root.getImu();
+  REQUIRE(imu.size() == 20);
+  CHECK(imu[0].getTimestamp() == 5 * ms);
+  CHECK(imu[19].getTimestamp() == 100 * ms);
+  CHECK(imu[19].getSeq() == 19);
+  CHECK(imu[19].getSchema() == uint8_t(tskpub::Schema::Imu));
+
+  // the next frame waits for the IMU to catch up
+  CHECK(s.lidar(200 * ms) == nullptr);
+  for (uint64_t t = 125; t < 200; t += 5) CHECK(s.imu(t * ms) == nullptr);
+  CHECK(s.camera(210 * ms) == nullptr);
+  msg = s.imu(200 * ms);
+  REQUIRE(msg != nullptr);
+  Bundle b2(msg);
+  CHECK(b2.hdr.seq == b.hdr.seq + 1);
+  CHECK(b2.root.getStartTime() == 100 * ms);
+  CHECK(b2.root.getCamera().getTimestamp() == 210 * ms);
+  // the samples after the first frame are in the second bundle only
+  REQUIRE(b2.root.getImu().size() == 20);
+  CHECK(b2.root.getImu()[0].getTimestamp() == 105 * ms);
+}
+
+// a stalled camera delays the bundle at most max_delay
+TEST_CASE("Bundle.timeout") {
+  Sensors s;
+  CHECK(s.camera(10 * ms) == nullptr);
+  CHECK(s.lidar(100 * ms) == nullptr);
+  for (uint64_t t = 50; t <= 200; t += 10) CHECK(s.imu(t * ms) == nullptr);
+  auto msg = s.imu(210 * ms);
+  REQUIRE(msg != nullptr);
+  Bundle b(msg);
+  CHECK(b.root.getCamera().getTimestamp() == 10 * ms);
+  CHECK(b.root.getImu().size() == 6);
+
+  // a new lidar frame closes the pending one
+  CHECK(s.lidar(300 * ms) == nullptr);
+  msg = s.lidar(400 * ms);
+  REQUIRE(msg != nullptr);
+  Bundle b2(msg);
+  CHECK(b2.root.getTimestamp() == 300 * ms);
+}
+
+TEST_CASE("Bundle.ignored") {
+  Sensors s;
+  // unframed messages and other sensors
+  tskpub::Msg legacy{'l', 'a', 's', 'e', 'r'};
+  CHECK(s.bundler.add("laser", legacy) == nullptr);
+  CHECK(s.bundler.add("status",
+                      framed(4, 0, 100 * ms, tskpub::Schema::Status))
+        == nullptr);
+  for (uint64_t t = 0; t <= 300; t += 10) CHECK(s.imu(t * ms) == nullptr);
+}
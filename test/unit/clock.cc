@@ -0,0 +1,120 @@
+#include "TSKPub/clock.hh"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+  constexpr uint64_t ms = 1000000;
+
+  /// @brief Standard deviation
+  double stddev(const std::vector<double>& v) {
+    double mean = 0, sq = 0;
+    for (auto x : v) mean += x;
+    mean /= v.size();
+    for (auto x : v) sq += (x - mean) * (x - mean);
+    return std::sqrt(sq / v.size());
+  }
+}  // namespace
+
+TEST_CASE("Clock.offset") {
+  tskpub::OffsetFilter f{{0.001, 500 * ms}};
+  CHECK_FALSE(f.update(0, 1000 * ms));
+  CHECK(f.offset() == int64_t(1000 * ms));
+
+  // 2 ms off, slewed out at 1 ms per second
+  CHECK_FALSE(f.update(1000 * ms, 1002 * ms));
+  CHECK(f.offset() == int64_t(1001 * ms));
+  CHECK_FALSE(f.update(3000 * ms, 1002 * ms));
+  CHECK(f.offset() == int64_t(1002 * ms));
+  CHECK_FALSE(f.update(3100 * ms, 1001 * ms));
+  CHECK(f.offset() == int64_t(1002 * ms - 100000));
+
+  // the first NTP sync is stepped at once
+  CHECK(f.update(3200 * ms, -3600000 * int64_t(ms)));
+  CHECK(f.offset() == -3600000 * int64_t(ms));
+}
+
+TEST_CASE("Clock.now") {
+  auto system = [] {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch())
+                        .count());
+  };
+  auto before = system();
+  auto now = tskpub::Clock::now();
+  auto after = system();
+  // no step since the start, the offset has not drifted far
+  CHECK(now + ms > before);
+  CHECK(now < after + ms);
+  CHECK(tskpub::Clock::from_system(after) + ms > now);
+
+  auto last = tskpub::Clock::now();
+  for (int i = 0; i < 100000; i++) {
+    auto t = tskpub::Clock::now();
+    CHECK(t >= last);
+    last = t;
+  }
+}
+
+// a 400 Hz IMU with a millisecond clock behind a USB adapter that batches
+// four packets, plus scheduling noise
+TEST_CASE("Clock.stamp_filter") {
+  tskpub::StampFilter f{{}};
+  std::mt19937 rng(7);
+  std::exponential_distribution<double> noise(1. / 300000);
+  // the device clock runs 50 ppm fast
+  const double drift = 1 + 50e-6;
+  const uint64_t period = 2500000, t0 = 5000 * ms;
+
+  std::vector<double> raw, filtered;
+  uint64_t last = 0, batch = 0;
+  for (uint64_t k = 0; k < 4000; k++) {
+    // every fourth sample sends the batch, decoded 20 us apart
+    auto truth = t0 + k * period;
+    if (k % 4 == 0) batch = t0 + (k + 3) * period + 200000 + noise(rng);
+    auto arrival = batch + k % 4 * 20000;
+    auto device = uint64_t(k * period * drift) / ms * ms;
+    auto est = f.update(arrival, device);
+    CHECK(est <= arrival);
+    CHECK(est >= last);
+    last = est;
+    if (k < 256) continue;
+    raw.push_back(double(arrival) - truth);
+    filtered.push_back(double(est) - truth);
+  }
+  CHECK(f.rate() == doctest::Approx(1 / drift).epsilon(0.01));
+  auto jitter = stddev(raw), residual = stddev(filtered);
+  MESSAGE("jitter: arrival " << jitter / 1e3 << " us, filtered "
+                             << residual / 1e3 << " us");
+  CHECK(residual < jitter / 4);
+  // within the clock resolution of the truth, plus the least delay
+  for (auto e : filtered) {
+    CHECK(e > -double(ms));
+    CHECK(e < 1.5 * ms);
+  }
+}
+
+TEST_CASE("Clock.stamp_filter_restart") {
+  tskpub::StampFilter f{{64, 16, 20 * ms, 1000 * ms}};
+  // without a sensor clock the arrivals come back
+  for (uint64_t k = 1; k < 100; k++) {
+    CHECK(f.update(k * 3 * ms, 0) == k * 3 * ms);
+  }
+  CHECK(f.rate() == 0);
+
+  uint64_t t = 1000 * ms;
+  for (uint64_t k = 0; k < 100; k++) f.update(t + k * 10 * ms, k * 10 * ms);
+  CHECK(f.rate() == doctest::Approx(1));
+  // the sensor clock jumped ahead, the fit would lie far after arrival
+  auto arrival = t + 100 * 10 * ms;
+  CHECK(f.update(arrival, 10000 * ms) == arrival);
+  CHECK(f.rate() == 0);
+  // a long silence
+  arrival += 2000 * ms;
+  CHECK(f.update(arrival, 10010 * ms) == arrival);
+}
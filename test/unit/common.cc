@@ -0,0 +1,90 @@
+#include "common.hh"
+
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST_CASE("ReadStats.total") {
+  // counters are padded to a cache line each
+  static_assert(alignof(tskpub::ReadCounter) == 64);
+  static_assert(sizeof(tskpub::ReadCounter) == 64);
+
+  tskpub::ReadStats::take_total();
+  auto &a = tskpub::ReadStats::counter("stats_a");
+  auto &b = tskpub::ReadStats::counter("stats_b");
+  CHECK(&a == &tskpub::ReadStats::counter("stats_a"));
+  CHECK(&a != &b);
+  CHECK(reinterpret_cast<uintptr_t>(&a) % 64 == 0);
+
+  a.bytes += 100;
+  b.bytes += 23;
+  CHECK(tskpub::ReadStats::take_total() == 123);
+  // taking the total resets the counters
+  CHECK(tskpub::ReadStats::take_total() == 0);
+  CHECK(a.bytes == 0);
+}
+
+TEST_CASE("ReadStats.losses") {
+  auto &c = tskpub::ReadStats::counter("stats_loss");
+  c.seq += 10;
+  c.dropped[size_t(tskpub::DropStage::Queue)] += 2;
+  bool found = false;
+  for (const auto &r : tskpub::ReadStats::losses()) {
+    if (r.sensor != "stats_loss") continue;
+    found = true;
+    CHECK(r.seq == 10);
+    CHECK(r.dropped[size_t(tskpub::DropStage::Queue)] == 2);
+    CHECK(r.dropped[size_t(tskpub::DropStage::Shaper)] == 0);
+  }
+  CHECK(found);
+  // unlike the byte counters the drop counters are never reset
+  tskpub::ReadStats::take_total();
+  CHECK(c.dropped[size_t(tskpub::DropStage::Queue)] == 2);
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.read_counter" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  constexpr size_t n = 10000000;
+  const size_t threads = std::max(2u, std::thread::hardware_concurrency());
+
+  // every thread counts into the counter returned by get(i)
+  auto bench = [&](auto &&get) {
+    std::vector<std::thread> jobs;
+    auto start = clock::now();
+    for (size_t i = 0; i < threads; i++) {
+      jobs.emplace_back([&, i] {
+        auto &c = get(i);
+        for (size_t k = 0; k < n; k++) {
+          c.fetch_add(64, std::memory_order_relaxed);
+        }
+      });
+    }
+    for (auto &j : jobs) j.join();
+    return std::chrono::duration<double, std::nano>(clock::now() - start)
+               .count()
+           / n;
+  };
+
+  std::atomic<uint64_t> shared{0};
+  auto shared_ns = bench([&](size_t) -> auto & { return shared; });
+  std::vector<tskpub::ReadCounter *> counters;
+  for (size_t i = 0; i < threads; i++) {
+    counters.push_back(
+        &tskpub::ReadStats::counter("bench_" + std::to_string(i)));
+  }
+  auto padded_ns
+      = bench([&](size_t i) -> auto & { return counters[i]->bytes; });
+  CHECK(tskpub::ReadStats::take_total() == 64 * n * threads);
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(2) << threads
+     << " threads, ns per read\n"
+     << "shared atomic:       " << shared_ns << "\n"
+     << "per-sensor counters: " << padded_ns << "\n";
+  MESSAGE(os.str());
+}
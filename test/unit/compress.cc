@@ -0,0 +1,280 @@
+#include "TSKPub/compress.hh"
+
+#include <TSKPub/msg/Imu.capnp.h>
+#include <TSKPub/msg/PointCloud.capnp.h>
+#include <TSKPub/msg/Status.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include "common.hh"
+#include "reader/reader.hh"
+
+#ifndef CONFIG_FILE
+#  error "CONFIG_FILE macro must be defined"
+#endif
+
+namespace {
+  /// @brief Pack a capnp message the same way Reader::to_msg does
+  tskpub::Msg pack(capnp::MallocMessageBuilder &builder) {
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    auto arr = out.getArray();
+    return tskpub::Msg(arr.begin(), arr.end());
+  }
+
+  /// @brief Synthetic recorded traffic, values drift slowly like real data
+  struct Traffic {
+    std::mt19937 rng{42};
+    std::normal_distribution<float> noise{0.f, 0.01f};
+    uint64_t stamp{1700000000000000000ull};
+
+    tskpub::Msg imu() {
+      capnp::MallocMessageBuilder builder;
+      auto imu = builder.initRoot<Imu>();
+      imu.setTopic("/tinysk/imu");
+      imu.setTimestamp(stamp += 10000000);
+      auto acc = imu.initLinearAcceleration();
+      acc.setX(noise(rng));
+      acc.setY(noise(rng));
+      acc.setZ(9.8f + noise(rng));
+      auto gyr = imu.initAngularVelocity();
+      gyr.setX(noise(rng));
+      gyr.setY(noise(rng));
+      gyr.setZ(noise(rng));
+      auto ori = imu.initOrientation();
+      ori.setW(1.f);
+      ori.setX(noise(rng));
+      ori.setY(noise(rng));
+      ori.setZ(noise(rng));
+      return pack(builder);
+    }
+
+    tskpub::Msg status() {
+      capnp::MallocMessageBuilder builder;
+      auto status = builder.initRoot<Status>();
+      status.setTopic("/tinysk/status");
+      status.setTimestamp(stamp += 1000000000);
+      status.setCpuUsage(std::round(30 + 100 * noise(rng)));
+      status.setCpuTemp(std::round(450 + 100 * noise(rng)) / 10);
+      status.setMemUsage(39.7f);
+      status.setBatteryVoltage(5.1f);
+      status.setBatteryCurrent(0.113f);
+      status.setIp("192.168.1.2");
+      status.setTotalReadBytes(123456 + rng() % 1000);
+      return pack(builder);
+    }
+
+    tskpub::Msg cloud(size_t n) {
+      capnp::MallocMessageBuilder builder;
+      auto cld = builder.initRoot<PointCloud>();
+      cld.setTopic("/tinysk/laser");
+      cld.setTimestamp(stamp += 100000000);
+      auto points = cld.initPoints(n);
+      std::uniform_real_distribution<float> u(-2.f, 2.f);
+      for (size_t i = 0; i < n; i++) {
+        points[i].setX(u(rng));
+        points[i].setY(u(rng));
+        points[i].setZ(1.f + std::abs(u(rng)));
+        points[i].setI(std::round(100 * std::abs(u(rng))));
+      }
+      return pack(builder);
+    }
+  };
+
+  tskpub::Compressor::Ptr make(const std::string &algo, int level,
+                               const tskpub::Msg &dict = {},
+                               uint8_t dict_id = 0) {
+    tskpub::CompressParams p;
+    p.algo = algo;
+    p.level = level;
+    p.dict = dict;
+    p.dict_id = dict_id;
+    return tskpub::CompressorFactory::create(p);
+  }
+
+  void check_roundtrip(tskpub::Compressor &c, const tskpub::Msg &raw) {
+    auto msg = tskpub::compress(c, raw.data(), raw.size(), "imu0");
+    REQUIRE(msg->size() > 4);
+    CHECK(std::string(msg->begin(), msg->begin() + 4) == "imu0");
+    auto out = tskpub::decompress(msg->data() + 4, msg->size() - 4);
+    CHECK(out == raw);
+  }
+}  // namespace
+
+TEST_CASE("Compress.header") {
+  uint8_t buf[tskpub::CompressHeader::MaxSize];
+  for (uint64_t sz : {0ull, 1ull, 127ull, 128ull, 300000ull, ~0ull}) {
+    tskpub::CompressHeader hdr, out;
+    hdr.algo = tskpub::Compression::Zstd;
+    hdr.dict_id = 7;
+    hdr.raw_size = sz;
+    auto n = hdr.encode(buf);
+    CHECK(n <= tskpub::CompressHeader::MaxSize);
+    CHECK(out.decode(buf, n) == n);
+    CHECK(out.algo == hdr.algo);
+    CHECK(out.dict_id == hdr.dict_id);
+    CHECK(out.raw_size == hdr.raw_size);
+  }
+  // packed capnp does not start with the magic nibble
+  Traffic t;
+  auto raw = t.imu();
+  tskpub::CompressHeader hdr;
+  CHECK(hdr.decode(raw.data(), raw.size()) == 0);
+}
+
+TEST_CASE("Compress.roundtrip") {
+  Traffic t;
+  auto imu = t.imu();
+  auto cloud = t.cloud(5000);
+  for (auto algo : {"lz4", "zstd"}) {
+    for (int level : {-1, 1, 9}) {
+      auto c = make(algo, level);
+      REQUIRE((c != nullptr));
+      check_roundtrip(*c, imu);
+      check_roundtrip(*c, cloud);
+      check_roundtrip(*c, {});
+    }
+  }
+  CHECK((make("unknown", 0) == nullptr));
+  CHECK_THROWS(tskpub::decompress(imu.data(), imu.size()));
+}
+
+// a forged raw size is refused before the decoder allocates it
+TEST_CASE("Compress.forged") {
+  Traffic t;
+  auto cloud = t.cloud(5000);
+  auto c = make("zstd", 1);
+  REQUIRE((c != nullptr));
+  auto zstd = tskpub::compress(*c, cloud.data(), cloud.size());
+  tskpub::CompressHeader real;
+  auto real_sz = real.decode(zstd->data(), zstd->size());
+  REQUIRE(real_sz > 0);
+  REQUIRE(real.algo == tskpub::Compression::Zstd);
+
+  for (auto algo : {tskpub::Compression::None, tskpub::Compression::LZ4,
+                    tskpub::Compression::Zstd}) {
+    for (uint64_t sz : {uint64_t(1) << 40, uint64_t(64) << 20}) {
+      tskpub::CompressHeader hdr;
+      hdr.algo = algo;
+      hdr.raw_size = sz;
+      tskpub::Msg msg(tskpub::CompressHeader::MaxSize);
+      msg.resize(hdr.encode(msg.data()));
+      if (algo == tskpub::Compression::Zstd) {
+        msg.insert(msg.end(), zstd->begin() + real_sz, zstd->end());
+      } else {
+        msg.insert(msg.end(), 16, 0);
+      }
+      CHECK_THROWS_AS(tskpub::decompress(msg.data(), msg.size()),
+                      std::runtime_error);
+    }
+  }
+  // the limit is up to the caller
+  CHECK_THROWS_AS(tskpub::decompress(zstd->data(), zstd->size(), 16),
+                  std::runtime_error);
+}
+
+TEST_CASE("Compress.dictionary") {
+  Traffic t;
+  std::vector<tskpub::Msg> samples;
+  for (int i = 0; i < 2000; i++) samples.push_back(t.imu());
+  auto dict = tskpub::train_dictionary(samples, 4096);
+  REQUIRE(dict.size() > 0);
+
+  auto plain = make("zstd", 3);
+  auto with_dict = make("zstd", 3, dict, 1);
+  tskpub::add_dictionary(1, dict);
+
+  size_t raw = 0, plain_sz = 0, dict_sz = 0;
+  for (int i = 0; i < 100; i++) {
+    auto msg = t.imu();
+    check_roundtrip(*with_dict, msg);
+    raw += msg.size();
+    plain_sz += tskpub::compress(*plain, msg.data(), msg.size())->size();
+    dict_sz += tskpub::compress(*with_dict, msg.data(), msg.size())->size();
+  }
+  MESSAGE("imu bytes raw/zstd/zstd+dict: " << raw << "/" << plain_sz << "/"
+                                           << dict_sz);
+  // small messages only shrink with a dictionary
+  CHECK(dict_sz < raw);
+  CHECK(dict_sz < plain_sz);
+}
+
+TEST_CASE("Compress.reader") {
+  tskpub::GlobalParams::get_instance().load_params(CONFIG_FILE);
+  tskpub::Log::init();
+  std::string sensor_name{"imu_zstd"};
+  auto reader = std::dynamic_pointer_cast<tskpub::IMUReader>(
+      tskpub::ReaderFactory::create("Imu", sensor_name));
+  REQUIRE((reader != nullptr));
+  std::vector<double> data(17, 1.0);
+  auto msg = reader->package_data(data);
+  REQUIRE((msg != nullptr));
+
+  auto body = tskpub::decompress(msg->data() + sensor_name.size(),
+                                 msg->size() - sensor_name.size());
+  kj::ArrayInputStream in(
+      kj::ArrayPtr<const kj::byte>(body.data(), body.size()));
+  capnp::PackedMessageReader r(in);
+  auto imu = r.getRoot<Imu>();
+  CHECK(std::string(imu.getTopic().cStr()) == "/tinysk/imu");
+  CHECK(imu.getLinearAcceleration().getX() == 1.0);
+
+  // the id does not fit the header byte
+  CHECK_THROWS_AS(tskpub::ReaderFactory::create("Imu", "imu_bad_dict"),
+                  std::runtime_error);
+
+  tskpub::GlobalParams::get_instance().destroy();
+  tskpub::Log::destory();
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.compress" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  Traffic t;
+  std::vector<std::pair<std::string, std::vector<tskpub::Msg>>> types(3);
+  types[0].first = "Imu";
+  types[1].first = "Status";
+  types[2].first = "PointCloud";
+  for (int i = 0; i < 2000; i++) types[0].second.push_back(t.imu());
+  for (int i = 0; i < 2000; i++) types[1].second.push_back(t.status());
+  for (int i = 0; i < 20; i++) types[2].second.push_back(t.cloud(5000));
+
+  std::ostringstream os;
+  os << std::left << std::setw(12) << "type" << std::setw(16) << "codec"
+     << std::setw(10) << "ratio" << "us/msg\n";
+  for (auto &[name, msgs] : types) {
+    // first half trains the dictionary, second half is measured
+    std::vector<tskpub::Msg> train(msgs.begin(),
+                                   msgs.begin() + msgs.size() / 2);
+    auto dict = tskpub::train_dictionary(train, 8192);
+    std::vector<std::pair<std::string, tskpub::Compressor::Ptr>> codecs{
+        {"lz4", make("lz4", 0)},      {"lz4hc-9", make("lz4", 9)},
+        {"zstd-1", make("zstd", 1)},  {"zstd-3", make("zstd", 3)},
+        {"zstd-9", make("zstd", 9)},
+    };
+    if (!dict.empty()) {
+      codecs.push_back({"zstd-3+dict", make("zstd", 3, dict, 2)});
+    }
+
+    for (auto &[cname, c] : codecs) {
+      size_t raw = 0, out = 0, n = 0;
+      auto start = clock::now();
+      for (size_t i = msgs.size() / 2; i < msgs.size(); i++, n++) {
+        raw += msgs[i].size();
+        out += tskpub::compress(*c, msgs[i].data(), msgs[i].size())->size();
+      }
+      auto us = std::chrono::duration<double, std::micro>(clock::now() - start)
+                    .count();
+      os << std::setw(12) << name << std::setw(16) << cname << std::setw(10)
+         << std::setprecision(3) << double(raw) / out << us / n << "\n";
+    }
+  }
+  MESSAGE(os.str());
+}
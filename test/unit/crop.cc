@@ -0,0 +1,154 @@
+#include "TSKPub/crop.hh"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+  /// @brief Same layout as XinTan::XtPointXYZI
+  struct XtPoint {
+    float x, y, z, intensity;
+  };
+
+  /// @brief Same layout as pcl::PointXYZI
+  struct alignas(16) PclPoint {
+    float x, y, z, pad;
+    float intensity, pad_[3];
+  };
+
+  /// @brief Synthetic 320x240 ToF frame, about a third of the pixels are NaN
+  std::vector<XtPoint> frame(std::mt19937 &rng, size_t n = 320 * 240) {
+    std::uniform_real_distribution<float> u(-5.f, 5.f), w(0.f, 2000.f);
+    std::vector<XtPoint> pts(n);
+    for (auto &p : pts) {
+      if (rng() % 3 == 0) {
+        p = {NAN, NAN, NAN, 0.f};
+      } else {
+        p = {u(rng), u(rng), u(rng), w(rng)};
+        // single NaN coordinates happen on edges
+        if (rng() % 50 == 0) p.y = NAN;
+      }
+    }
+    return pts;
+  }
+
+  /// @brief Scalar reference, the way LidarReader converted frames before
+  bool keep(const XtPoint &p, const tskpub::CropParams &c) {
+    if (std::isnan(p.x) || std::isnan(p.y) || std::isnan(p.z)) return false;
+    float r = p.x * p.x + p.y * p.y + p.z * p.z;
+    return p.x >= c.min[0] && p.x <= c.max[0] && p.y >= c.min[1]
+           && p.y <= c.max[1] && p.z >= c.min[2] && p.z <= c.max[2]
+           && p.intensity >= c.min_intensity && p.intensity <= c.max_intensity
+           && r >= c.min_range * c.min_range && r <= c.max_range * c.max_range;
+  }
+
+  template <typename OutT>
+  void check_crop(const std::vector<XtPoint> &in,
+                  const tskpub::CropParams &params) {
+    std::vector<OutT> out(in.size());
+    auto n = tskpub::crop_points(in.data(), in.size(), params, out.data());
+    size_t k = 0;
+    for (const auto &p : in) {
+      if (!keep(p, params)) continue;
+      REQUIRE(k < n);
+      CHECK(out[k].x == p.x);
+      CHECK(out[k].y == p.y);
+      CHECK(out[k].z == p.z);
+      CHECK(out[k].intensity == p.intensity);
+      k++;
+    }
+    CHECK(n == k);
+  }
+}  // namespace
+
+TEST_CASE("Crop.filter") {
+  std::mt19937 rng{3};
+  // odd size to cover the tail loop
+  auto in = frame(rng, 1003);
+
+  tskpub::CropParams all;
+  check_crop<XtPoint>(in, all);
+  check_crop<PclPoint>(in, all);
+
+  tskpub::CropParams box;
+  box.min[0] = -1.f;
+  box.max[0] = 3.f;
+  box.min[2] = 0.f;
+  box.min_intensity = 100.f;
+  box.max_intensity = 1500.f;
+  check_crop<XtPoint>(in, box);
+  check_crop<PclPoint>(in, box);
+
+  tskpub::CropParams range;
+  range.min_range = 0.5f;
+  range.max_range = 4.f;
+  check_crop<XtPoint>(in, range);
+  check_crop<PclPoint>(in, range);
+
+  // nothing passes an empty box
+  tskpub::CropParams none;
+  none.min[1] = 1.f;
+  none.max[1] = -1.f;
+  std::vector<XtPoint> out(in.size());
+  CHECK(tskpub::crop_points(in.data(), in.size(), none, out.data()) == 0);
+  CHECK(tskpub::crop_points(in.data(), 0, all, out.data()) == 0);
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.crop" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  std::mt19937 rng{5};
+  std::vector<std::vector<XtPoint>> frames;
+  for (int i = 0; i < 50; i++) frames.push_back(frame(rng));
+
+  tskpub::CropParams params;
+  params.max_range = 4.f;
+  params.min_intensity = 50.f;
+
+  std::ostringstream os;
+  os << std::left << std::setw(28) << "kernel" << std::setw(12) << "points"
+     << "us/frame\n";
+  auto bench = [&](const std::string &name, auto &&run) {
+    size_t kept = 0;
+    auto start = clock::now();
+    for (const auto &f : frames) kept += run(f);
+    auto us = std::chrono::duration<double, std::micro>(clock::now() - start)
+                  .count();
+    os << std::setw(28) << name << std::setw(12) << kept / frames.size()
+       << us / frames.size() << "\n";
+  };
+
+  // previous path: isnan checks and push_back, then crop as a second pass
+  bench("for_each + push_back", [&](const std::vector<XtPoint> &f) {
+    std::vector<PclPoint> filtered, ret;
+    filtered.reserve(f.size());
+    std::for_each(f.begin(), f.end(), [&filtered](const XtPoint &p) {
+      if (std::isnan(p.x) || std::isnan(p.y) || std::isnan(p.z)) return;
+      PclPoint pt;
+      pt.x = p.x;
+      pt.y = p.y;
+      pt.z = p.z;
+      pt.intensity = p.intensity;
+      filtered.push_back(pt);
+    });
+    for (const auto &p : filtered) {
+      float r = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+      if (r <= params.max_range && p.intensity >= params.min_intensity) {
+        ret.push_back(p);
+      }
+    }
+    return ret.size();
+  });
+
+  std::vector<PclPoint> out(frames[0].size());
+  bench("crop_points", [&](const std::vector<XtPoint> &f) {
+    return tskpub::crop_points(f.data(), f.size(), params, out.data());
+  });
+  MESSAGE(os.str());
+}
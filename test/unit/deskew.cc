@@ -0,0 +1,248 @@
+#include "TSKPub/deskew.hh"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "TSKPub/crop.hh"
+
+namespace {
+  /// @brief Same layout as XinTan::XtPointXYZI
+  struct XtPoint {
+    float x, y, z, intensity;
+  };
+
+  /// @brief Same layout as pcl::PointXYZI
+  struct alignas(16) PclPoint {
+    float x, y, z, pad;
+    float intensity, pad_[3];
+  };
+
+  /// @brief Point p of the world seen from a sensor turned by a about z
+  PclPoint seen(const PclPoint& p, double a) {
+    float c = std::cos(a), s = std::sin(a);
+    return {c * p.x + s * p.y, -s * p.x + c * p.y, p.z, 1.f, p.intensity, {}};
+  }
+
+  /// @brief Scalar reference of rotate_points
+  void rotate_scalar(PclPoint* pts, size_t n, const float* rot,
+                     size_t slices) {
+    for (size_t i = 0; i < n; i++) {
+      const float* r = rot + i * slices / n * 9;
+      auto& p = pts[i];
+      float x = p.x, y = p.y, z = p.z;
+      p.x = r[0] * x + r[1] * y + r[2] * z;
+      p.y = r[3] * x + r[4] * y + r[5] * z;
+      p.z = r[6] * x + r[7] * y + r[8] * z;
+    }
+  }
+}  // namespace
+
+TEST_CASE("ImuHistory.copy") {
+  tskpub::ImuHistory history;
+  std::vector<tskpub::RateSample> out(16);
+  CHECK(history.copy(0, 100, out.data(), out.size()) == 0);
+  for (uint64_t i = 1; i <= 10; i++) {
+    const float gyr[3] = {float(i), 0.f, 0.f};
+    history.push(i * 10, gyr);
+  }
+  // (25, 55] is covered by the samples at 30 to 60
+  auto n = history.copy(25, 55, out.data(), out.size());
+  REQUIRE(n == 4);
+  CHECK(out[0].stamp == 30);
+  CHECK(out[3].stamp == 60);
+  CHECK(out[3].gyr[0] == 6.f);
+  // the history ends before to
+  CHECK(history.copy(85, 200, out.data(), out.size()) == 2);
+  // nothing at or before from
+  CHECK(history.copy(5, 30, out.data(), out.size()) == 0);
+
+  // the oldest samples are overwritten
+  for (uint64_t i = 11; i <= tskpub::ImuHistory::Capacity + 10; i++) {
+    const float gyr[3] = {float(i), 0.f, 0.f};
+    history.push(i * 10, gyr);
+  }
+  CHECK(history.copy(25, 55, out.data(), out.size()) == 0);
+  CHECK(history.copy(205, 225, out.data(), out.size()) == 3);
+}
+
+// readers copy while the IMU thread wraps around the buffer many times
+TEST_CASE("ImuHistory.concurrent") {
+  tskpub::ImuHistory history;
+  std::atomic<uint64_t> written{0};
+  std::atomic<bool> running{true};
+  std::thread writer([&] {
+    for (uint64_t i = 1; running; i++) {
+      const float gyr[3] = {float(i % 1000), float(i % 7), 1.f};
+      history.push(i, gyr);
+      written.store(i, std::memory_order_relaxed);
+    }
+  });
+
+  size_t copies = 0, tries = 0;
+  std::vector<tskpub::RateSample> out(64);
+  while (copies < 10000) {
+    auto w = written.load(std::memory_order_relaxed);
+    if (w < 100) continue;
+    tries++;
+    auto n = history.copy(w - 50, w - 10, out.data(), out.size());
+    if (n == 0) continue;
+    copies++;
+    // a torn sample would break the pattern of the writer
+    CHECK(n == 40);
+    for (size_t k = 0; k < n; k++) {
+      CHECK(out[k].stamp == w - 49 + k);
+      CHECK(out[k].gyr[0] == float(out[k].stamp % 1000));
+      CHECK(out[k].gyr[1] == float(out[k].stamp % 7));
+    }
+  }
+  running = false;
+  writer.join();
+  MESSAGE(copies << " of " << tries << " copies were not overwritten");
+}
+
+// a sensor turning at a constant rate sees a still scene, every point is
+// moved to the frame at the end of the window
+TEST_CASE("Deskew.constant_rate") {
+  const double w = 2.0;  // rad/s about z
+  const uint64_t start = 1000000000, end = start + 20000000;
+  std::vector<tskpub::RateSample> rates;
+  for (uint64_t t = start - 5000000; t <= end + 5000000; t += 2500000)
+    rates.push_back({t, {0.f, 0.f, float(w)}});
+
+  std::mt19937 rng{7};
+  std::uniform_real_distribution<float> u(-4.f, 4.f);
+  const size_t n = 5000, slices = 50;
+  std::vector<PclPoint> world(n), pts(n);
+  for (size_t i = 0; i < n; i++) {
+    world[i] = {u(rng), u(rng), u(rng), 1.f, float(i), {}};
+    // captured at the middle of its slice
+    auto k = i * slices / n;
+    double t = (k + 0.5) / slices * (end - start) * 1e-9;
+    pts[i] = seen(world[i], w * t);
+    pts[i].pad = (i + 0.5f) / n;
+  }
+
+  std::vector<float> rot(slices * 9);
+  tskpub::deskew_rotations(rates.data(), rates.size(), start, end, slices,
+                           rot.data());
+  auto ref = pts;
+  tskpub::rotate_points(pts.data(), n, rot.data(), slices);
+  rotate_scalar(ref.data(), n, rot.data(), slices);
+
+  double err = 0, ref_err = 0, smear = 0;
+  for (size_t i = 0; i < n; i++) {
+    auto e = seen(world[i], w * (end - start) * 1e-9);
+    err = std::max(err, double(std::hypot(pts[i].x - e.x, pts[i].y - e.y,
+                                          pts[i].z - e.z)));
+    ref_err = std::max(ref_err, double(std::abs(pts[i].x - ref[i].x)
+                                       + std::abs(pts[i].y - ref[i].y)));
+    smear = std::max(smear, double(std::hypot(world[i].x - e.x,
+                                              world[i].y - e.y)));
+    CHECK(pts[i].pad == 1.f);
+    CHECK(pts[i].intensity == float(i));
+  }
+  CHECK(err < 1e-4);
+  CHECK(ref_err < 1e-5);
+  // without deskew the points are off by centimeters
+  CHECK(smear > 0.1);
+}
+
+// the capture time of a point survives the points cropped before it
+TEST_CASE("Deskew.cropped") {
+  const double w = 2.0;  // rad/s about z
+  const uint64_t start = 1000000000, end = start + 20000000;
+  std::vector<tskpub::RateSample> rates;
+  for (uint64_t t = start - 5000000; t <= end + 5000000; t += 2500000)
+    rates.push_back({t, {0.f, 0.f, float(w)}});
+
+  std::mt19937 rng{11};
+  std::uniform_real_distribution<float> u(-4.f, 4.f);
+  const size_t n = 4000, slices = 40;
+  std::vector<PclPoint> world(n);
+  std::vector<XtPoint> frame(n);
+  for (size_t i = 0; i < n; i++) {
+    // the first quarter and every third point have no return
+    const bool keep = i >= n / 4 && i % 3 != 0;
+    world[i] = {u(rng), u(rng), u(rng), 1.f, keep ? 100.f : 0.f, {}};
+    auto k = i * slices / n;
+    double t = (k + 0.5) / slices * (end - start) * 1e-9;
+    auto p = seen(world[i], w * t);
+    frame[i] = {p.x, p.y, p.z, world[i].intensity};
+  }
+
+  tskpub::CropParams crop;
+  crop.min_intensity = 50.f;
+  std::vector<PclPoint> pts(n);
+  auto m = tskpub::crop_points(frame.data(), n, crop, pts.data());
+  REQUIRE(m < n * 3 / 4);
+
+  std::vector<float> rot(slices * 9);
+  tskpub::deskew_rotations(rates.data(), rates.size(), start, end, slices,
+                           rot.data());
+  tskpub::rotate_points(pts.data(), m, rot.data(), slices);
+
+  const double a = w * (end - start) * 1e-9;
+  size_t j = 0;
+  double err = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (world[i].intensity < 50.f) continue;
+    REQUIRE(j < m);
+    auto e = seen(world[i], a);
+    err = std::max(err, double(std::hypot(pts[j].x - e.x, pts[j].y - e.y,
+                                          pts[j].z - e.z)));
+    CHECK(pts[j].pad == 1.f);
+    j++;
+  }
+  CHECK(j == m);
+  CHECK(err < 1e-4);
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.deskew" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  std::mt19937 rng{5};
+  std::uniform_real_distribution<float> u(-5.f, 5.f), g(-1.f, 1.f);
+  // 400 Hz over a 20 ms window and some margin
+  std::vector<tskpub::RateSample> rates;
+  for (uint64_t t = 0; t <= 30000000; t += 2500000)
+    rates.push_back({t, {g(rng), g(rng), g(rng)}});
+  const size_t slices = 32;
+  std::vector<float> rot(slices * 9);
+
+  std::ostringstream os;
+  os << std::left << std::setw(20) << "kernel" << std::setw(12) << "points"
+     << "us/frame\n";
+  auto bench = [&](const std::string &name, size_t n, auto &&run) {
+    std::vector<PclPoint> pts(n);
+    for (size_t i = 0; i < n; i++)
+      pts[i] = {u(rng), u(rng), u(rng), float(i) / n, 0.f, {}};
+    const int frames = 200;
+    auto start = clock::now();
+    for (int i = 0; i < frames; i++) run(pts);
+    auto us = std::chrono::duration<double, std::micro>(clock::now() - start)
+                  .count();
+    os << std::setw(20) << name << std::setw(12) << n << us / frames << "\n";
+  };
+
+  for (size_t n : {size_t(5000), size_t(50000)}) {
+    bench("scalar", n, [&](std::vector<PclPoint> &pts) {
+      tskpub::deskew_rotations(rates.data(), rates.size(), 5000000, 25000000,
+                               slices, rot.data());
+      rotate_scalar(pts.data(), pts.size(), rot.data(), slices);
+    });
+    bench("rotate_points", n, [&](std::vector<PclPoint> &pts) {
+      tskpub::deskew_rotations(rates.data(), rates.size(), 5000000, 25000000,
+                               slices, rot.data());
+      tskpub::rotate_points(pts.data(), pts.size(), rot.data(), slices);
+    });
+  }
+  MESSAGE(os.str());
+}
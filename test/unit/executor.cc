@@ -0,0 +1,184 @@
+#include "TSKPub/executor.hh"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using Priority = tskpub::Executor::Priority;
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief Closed until open() is called
+  struct Gate {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool opened{false};
+
+    void wait() {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this] { return opened; });
+    }
+
+    void open() {
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        opened = true;
+      }
+      cv.notify_all();
+    }
+  };
+
+  /// @brief CPU bound work, roughly a point cloud filter or a packing pass
+  double burn(size_t n) {
+    double x = 0;
+    for (size_t i = 1; i <= n; i++) x += std::sqrt(double(i));
+    return x;
+  }
+}  // namespace
+
+TEST_CASE("Executor.run") {
+  std::atomic<int> count{0};
+  {
+    tskpub::Executor executor(3);
+    CHECK(executor.size() == 3);
+    for (int i = 0; i < 1000; i++) executor.submit([&] { count++; });
+  }
+  // the destructor runs the queued tasks
+  CHECK(count == 1000);
+}
+
+TEST_CASE("Executor.priority") {
+  tskpub::Executor executor(1);
+  Gate gate;
+  std::mutex mtx;
+  std::vector<Priority> order;
+  // keep the only worker busy while the tasks are queued
+  executor.submit([&] { gate.wait(); });
+  for (auto p : {Priority::Low, Priority::Normal, Priority::High}) {
+    executor.submit(
+        [&, p] {
+          std::lock_guard<std::mutex> lock(mtx);
+          order.push_back(p);
+        },
+        p);
+  }
+  gate.open();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (order.size() == 3) break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(order[0] == Priority::High);
+  CHECK(order[1] == Priority::Normal);
+  CHECK(order[2] == Priority::Low);
+}
+
+// tasks submitted by a worker stay on its queue, the idle workers steal them
+TEST_CASE("Executor.steal") {
+  std::atomic<int> count{0};
+  tskpub::Executor executor(2);
+  executor.submit([&] {
+    for (int i = 0; i < 100; i++) {
+      executor.submit([&] {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        count++;
+      });
+    }
+  });
+  auto deadline = Clock::now() + std::chrono::seconds(5);
+  while (count < 100 && Clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(count == 100);
+  CHECK(executor.steals() > 0);
+}
+
+TEST_CASE("Executor.exception") {
+  std::atomic<int> count{0};
+  {
+    tskpub::Executor executor(1);
+    executor.submit([] { throw std::runtime_error("broken sensor"); });
+    executor.submit([&] { count++; });
+  }
+  CHECK(count == 1);
+}
+
+// 4 sensors on 4 workers against a thread per sensor: an IMU with small
+// high priority reads, two lidars and a camera with heavy packing
+TEST_CASE("Bench.executor" * doctest::skip()) {
+  constexpr size_t workers = 4;
+  constexpr size_t imu_reads = 4000, heavy_reads = 200;
+  constexpr size_t heavy_cost = 2000000, imu_cost = 2000;
+  const std::vector<size_t> heavy = {heavy_cost, heavy_cost, heavy_cost / 2};
+  std::ostringstream oss;
+
+  auto ms = [](Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+  };
+
+  // a thread per sensor
+  {
+    std::atomic<double> sink{0};
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+      for (size_t i = 0; i < imu_reads; i++) sink = sink + burn(imu_cost);
+    });
+    for (auto cost : heavy) {
+      threads.emplace_back([&, cost] {
+        for (size_t i = 0; i < heavy_reads; i++) sink = sink + burn(cost);
+      });
+    }
+    for (auto& t : threads) t.join();
+    auto t = ms(start);
+    auto reads = imu_reads + heavy.size() * heavy_reads;
+    oss << "threads:  " << t << " ms, " << reads / t * 1e3 << " reads/s\n";
+  }
+
+  // the shared executor
+  {
+    std::atomic<double> sink{0};
+    std::atomic<size_t> imu_done{0};
+    std::atomic<int64_t> imu_latency{0};
+    auto start = Clock::now();
+    {
+      tskpub::Executor executor(workers);
+      for (size_t i = 0; i < heavy_reads; i++) {
+        for (auto cost : heavy) {
+          executor.submit([&, cost] { sink = sink + burn(cost); });
+        }
+        for (size_t k = 0; k < imu_reads / heavy_reads; k++) {
+          auto queued = Clock::now();
+          executor.submit(
+              [&, queued] {
+                sink = sink + burn(imu_cost);
+                imu_latency += std::chrono::duration_cast<
+                                   std::chrono::microseconds>(Clock::now()
+                                                              - queued)
+                                   .count();
+                imu_done++;
+              },
+              Priority::High);
+        }
+      }
+    }
+    auto t = ms(start);
+    auto reads = imu_reads + heavy.size() * heavy_reads;
+    oss << "executor: " << t << " ms, " << reads / t * 1e3
+        << " reads/s, IMU queueing " << imu_latency / double(imu_done)
+        << " us on average";
+  }
+  MESSAGE(oss.str());
+}
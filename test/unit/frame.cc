@@ -0,0 +1,208 @@
+#include "TSKPub/frame.hh"
+
+#include <TSKPub/msg/Imu.capnp.h>
+#include <TSKPub/msg/PointCloud.capnp.h>
+#include <TSKPub/msg/Status.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "common.hh"
+#include "reader/reader.hh"
+
+#ifndef CONFIG_FILE
+#  error "CONFIG_FILE macro must be defined"
+#endif
+
+namespace {
+  /// @brief Copy of the unit test config with the framed message layout
+  struct FramedConfig {
+    std::string path{"/tmp/tskpub_framed.yml"};
+
+    FramedConfig() {
+      std::ifstream in(CONFIG_FILE);
+      std::stringstream ss;
+      ss << in.rdbuf();
+      auto yml = ss.str();
+      auto pos = yml.find("app:\n");
+      REQUIRE(pos != std::string::npos);
+      yml.insert(pos + 5, "  framing: header\n");
+      std::ofstream(path) << yml;
+
+      tskpub::GlobalParams::get_instance().load_params(path);
+      tskpub::Log::init();
+    }
+
+    ~FramedConfig() {
+      tskpub::GlobalParams::get_instance().destroy();
+      tskpub::Log::destory();
+      std::remove(path.c_str());
+    }
+  };
+
+  /// @brief Pack a capnp message the same way Reader::to_msg does
+  size_t packed_size(capnp::MallocMessageBuilder &builder) {
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    return out.getArray().size();
+  }
+
+  /// @brief Packed body of an IMU sample
+  size_t imu_size(bool framed) {
+    capnp::MallocMessageBuilder builder;
+    auto imu = builder.initRoot<Imu>();
+    if (!framed) {
+      imu.setTopic("/tinysk/imu");
+      imu.setTimestamp(1700000000123456789ull);
+    }
+    auto acc = imu.initLinearAcceleration();
+    acc.setX(0.013f);
+    acc.setY(-0.021f);
+    acc.setZ(9.81f);
+    auto gyr = imu.initAngularVelocity();
+    gyr.setX(0.001f);
+    gyr.setY(0.002f);
+    gyr.setZ(-0.003f);
+    auto ori = imu.initOrientation();
+    ori.setW(0.999f);
+    ori.setX(0.01f);
+    ori.setY(0.02f);
+    ori.setZ(0.03f);
+    return packed_size(builder);
+  }
+
+  /// @brief Packed body of a status message
+  size_t status_size(bool framed) {
+    capnp::MallocMessageBuilder builder;
+    auto status = builder.initRoot<Status>();
+    if (!framed) {
+      status.setTopic("/tinysk/status");
+      status.setTimestamp(1700000000123456789ull);
+    }
+    status.setCpuUsage(31);
+    status.setCpuTemp(45.3f);
+    status.setMemUsage(39.7f);
+    status.setBatteryVoltage(5.1f);
+    status.setBatteryCurrent(0.113f);
+    status.setIp("192.168.1.2");
+    return packed_size(builder);
+  }
+
+  /// @brief Packed body of a small point cloud
+  size_t cloud_size(bool framed, size_t n) {
+    capnp::MallocMessageBuilder builder;
+    auto cld = builder.initRoot<PointCloud>();
+    if (!framed) {
+      cld.setTopic("/tinysk/laser");
+      cld.setTimestamp(1700000000123456789ull);
+    }
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> u(-2.f, 2.f);
+    auto points = cld.initPoints(n);
+    for (size_t i = 0; i < n; i++) {
+      points[i].setX(u(rng));
+      points[i].setY(u(rng));
+      points[i].setZ(u(rng));
+      points[i].setI(100);
+    }
+    return packed_size(builder);
+  }
+}  // namespace
+
+TEST_CASE("Frame.header") {
+  tskpub::FrameHeader hdr, out;
+  hdr.flags = tskpub::FrameHeader::Compressed;
+  hdr.schema = tskpub::Schema::PointCloud;
+  hdr.topic_id = 0x1234;
+  hdr.seq = 0xdeadbeef;
+  hdr.stamp = 1700000000123456789ull;
+  uint8_t buf[tskpub::FrameHeader::Size];
+  hdr.encode(buf);
+  REQUIRE(out.decode(buf, sizeof(buf)));
+  CHECK(out.flags == hdr.flags);
+  CHECK(out.schema == hdr.schema);
+  CHECK(out.topic_id == hdr.topic_id);
+  CHECK(out.seq == hdr.seq);
+  CHECK(out.stamp == hdr.stamp);
+  // little endian on the wire
+  CHECK(buf[2] == 0x34);
+  CHECK(buf[4] == 0xef);
+
+  // short and foreign messages are rejected
+  CHECK_FALSE(out.decode(buf, sizeof(buf) - 1));
+  buf[0] = 0x2f;
+  CHECK_FALSE(out.decode(buf, sizeof(buf)));
+
+  CHECK(tskpub::schema_from_type("Imu") == tskpub::Schema::Imu);
+  CHECK(tskpub::schema_from_type("Foo") == tskpub::Schema::Unknown);
+}
+
+TEST_CASE("Frame.topic") {
+  // a subscription is a prefix match on the first bytes of the message
+  auto imu = tskpub::topic_frame("imu");
+  auto imu0 = tskpub::topic_frame("imu0");
+  CHECK(imu.size() == 4);
+  CHECK(imu0.compare(0, imu.size(), imu) != 0);
+  CHECK(imu.compare(0, 3, "imu") == 0);
+}
+
+TEST_CASE("Frame.reader") {
+  FramedConfig cfg;
+  auto reader = tskpub::ReaderFactory::create("Status", "info");
+  REQUIRE((reader != nullptr));
+  CHECK(reader->topic_id() == 1);
+  CHECK(reader->schema() == tskpub::Schema::Status);
+
+  // the numbers continue over readers of the same sensor
+  auto first = tskpub::ReadStats::counter("info").seq.load();
+  for (uint32_t i = 0; i < 2; i++) {
+    auto msg = reader->read();
+    REQUIRE((msg != nullptr));
+    tskpub::FrameHeader hdr;
+    REQUIRE(hdr.decode(msg->data(), msg->size()));
+    CHECK(hdr.flags == 0);
+    CHECK(hdr.schema == tskpub::Schema::Status);
+    CHECK(hdr.topic_id == 1);
+    CHECK(hdr.seq == first + i);
+    CHECK(hdr.stamp > 0);
+
+    // the body has no topic and no timestamp
+    auto body = kj::ArrayPtr<const kj::byte>(
+        msg->data() + tskpub::FrameHeader::Size,
+        msg->size() - tskpub::FrameHeader::Size);
+    kj::ArrayInputStream in(body);
+    capnp::PackedMessageReader pr(in);
+    auto status = pr.getRoot<Status>();
+    CHECK_FALSE(status.hasTopic());
+    CHECK(status.getTimestamp() == 0);
+    CHECK(status.getCpuTemp() > 0.0);
+  }
+}
+
+// bytes on the wire per message, the legacy layout is [name][body with topic
+// and timestamp], the framed one is [name\0][FrameHeader][body]
+TEST_CASE("Bench.framing" * doctest::skip()) {
+  struct Topic {
+    std::string name;
+    size_t legacy, framed;
+  };
+  std::vector<Topic> topics{
+      {"imu", imu_size(false), imu_size(true)},
+      {"status", status_size(false), status_size(true)},
+      {"laser", cloud_size(false, 256), cloud_size(true, 256)},
+  };
+  for (const auto &t : topics) {
+    auto legacy = t.name.size() + t.legacy;
+    auto framed = tskpub::topic_frame(t.name).size()
+                  + tskpub::FrameHeader::Size + t.framed;
+    std::ostringstream oss;
+    oss << std::left << std::setw(8) << t.name << " legacy " << legacy
+        << " B, framed " << framed << " B";
+    MESSAGE(oss.str());
+  }
+}
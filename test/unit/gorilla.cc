@@ -0,0 +1,355 @@
+#include "TSKPub/gorilla.hh"
+
+#include <TSKPub/msg/Imu.capnp.h>
+#include <TSKPub/msg/Series.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+  /// @brief Reads bits most significant first
+  class BitReader {
+  public:
+    BitReader(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    /// @brief Next bits as an unsigned value
+    /// @throw std::out_of_range past the end of the data
+    uint64_t get(int bits) {
+      uint64_t v = 0;
+      while (bits > 0) {
+        if (pos_ / 8 >= size_) throw std::out_of_range("Truncated sample");
+        int used = pos_ % 8;
+        int n = std::min(bits, 8 - used);
+        v = v << n | ((data_[pos_ / 8] >> (8 - used - n)) & ((1u << n) - 1));
+        pos_ += n;
+        bits -= n;
+      }
+      return v;
+    }
+
+    /// @brief Next bits as a two's complement value
+    int64_t get_signed(int bits) {
+      auto v = get(bits);
+      if (bits < 64 && v >> (bits - 1)) v |= ~uint64_t(0) << bits;
+      return int64_t(v);
+    }
+
+  private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t pos_{0};
+  };
+
+  /// @brief Subscriber side decoder of one Series topic, the counterpart of
+  ///        tskpub::GorillaEncoder
+  class GorillaDecoder {
+  public:
+    /// @brief Decode the data of a message
+    /// @param index index of the message
+    /// @param stamp capture time in nanoseconds
+    /// @param values channel values
+    /// @return false while waiting for a key, after joining late or a gap
+    bool decode(uint32_t index, const std::vector<uint8_t> &data,
+                uint64_t &stamp, std::vector<double> &values) {
+      BitReader bits(data.data(), data.size());
+      if (index == 0) {
+        // a key has no padding
+        REQUIRE(data.size() % 8 == 0);
+        const size_t n = data.size() / 8 - 1;
+        stamp_ = bits.get(64);
+        delta_ = 0;
+        values_.resize(n);
+        leading_.assign(n, 64);
+        trailing_.assign(n, 0);
+        for (auto &v : values_) v = bits.get(64);
+      } else {
+        if (!synced_ || index != next_) {
+          synced_ = false;
+          return false;
+        }
+        delta_ += uint64_t(dod(bits));
+        stamp_ += delta_;
+        for (size_t i = 0; i < values_.size(); i++) {
+          if (bits.get(1) == 0) continue;
+          if (bits.get(1) == 1) {
+            leading_[i] = bits.get(5);
+            auto meaningful = bits.get(6);
+            trailing_[i] = 64 - leading_[i] - (meaningful ? meaningful : 64);
+          }
+          const int meaningful = 64 - leading_[i] - trailing_[i];
+          values_[i] ^= bits.get(meaningful) << trailing_[i];
+        }
+      }
+      synced_ = true;
+      next_ = index + 1;
+      stamp = stamp_;
+      values.resize(values_.size());
+      for (size_t i = 0; i < values_.size(); i++) {
+        std::memcpy(&values[i], &values_[i], sizeof(double));
+      }
+      return true;
+    }
+
+  private:
+    static int64_t dod(BitReader &bits) {
+      if (bits.get(1) == 0) return 0;
+      if (bits.get(1) == 0) return bits.get_signed(16);
+      if (bits.get(1) == 0) return bits.get_signed(24);
+      if (bits.get(1) == 0) return bits.get_signed(36);
+      return bits.get_signed(64);
+    }
+
+    bool synced_{false};
+    uint32_t next_{0};
+    uint64_t stamp_{0}, delta_{0};
+    std::vector<uint64_t> values_;
+    std::vector<int> leading_, trailing_;
+  };
+
+  /// @brief IMU sample in the channel order of the IMU reader: orientation
+  ///        w x y z, angular velocity, linear acceleration
+  struct Sample {
+    uint64_t stamp;
+    std::vector<double> values;
+  };
+
+  /// @brief Slow rotation with sensor noise, read at 100 Hz from a 400 Hz
+  ///        device: the period jitters by the device ticks and some reads
+  ///        are missed. Values are rounded to float like the Imu fields
+  std::vector<Sample> imu_trace(size_t n) {
+    std::mt19937 rng{3};
+    std::normal_distribution<double> noise{0., 1.};
+    std::uniform_int_distribution<int> tick{-1, 1};
+    std::vector<Sample> trace;
+    uint64_t stamp = 1700000000000000000ull;
+    for (size_t i = 0; i < n; i++) {
+      stamp += 10000000 + tick(rng) * 2500000 + (rng() % 100 == 0) * 20000000;
+      double t = i * 0.01, yaw = 0.2 * std::sin(0.3 * t);
+      double gz = 0.06 * std::cos(0.3 * t) * 180 / M_PI;
+      std::vector<double> v{std::cos(yaw / 2),
+                            0.,
+                            0.,
+                            std::sin(yaw / 2),
+                            0.05 * noise(rng),
+                            0.05 * noise(rng),
+                            gz + 0.05 * noise(rng),
+                            0.02 * noise(rng),
+                            0.02 * noise(rng),
+                            9.8 + 0.02 * noise(rng)};
+      for (auto &x : v) x = float(x);
+      trace.push_back({stamp, v});
+    }
+    return trace;
+  }
+
+  /// @brief Series channel names of the IMU reader
+  const std::vector<std::string> Channels{
+      "orientation.w", "orientation.x", "orientation.y", "orientation.z",
+      "angularVelocity.x", "angularVelocity.y", "angularVelocity.z",
+      "linearAcceleration.x", "linearAcceleration.y", "linearAcceleration.z"};
+
+  bool same_bits(const std::vector<double> &a, const std::vector<double> &b) {
+    return a.size() == b.size()
+           && std::memcmp(a.data(), b.data(), a.size() * sizeof(double)) == 0;
+  }
+}  // namespace
+
+TEST_CASE("Gorilla.round_trip") {
+  auto trace = imu_trace(1000);
+  // exceptional values
+  trace[400].values[4] = std::numeric_limits<double>::quiet_NaN();
+  trace[401].values[4] = -std::numeric_limits<double>::infinity();
+  trace[402].values[4] = -0.;
+  trace[403].values[4] = 1e-300;
+
+  tskpub::GorillaEncoder enc(64);
+  GorillaDecoder dec;
+  std::vector<uint8_t> data;
+  std::vector<double> values;
+  size_t key_bytes = 0, keys = 0, bytes = 0;
+  for (size_t i = 0; i < trace.size(); i++) {
+    const auto &s = trace[i];
+    auto index = enc.encode(s.stamp, s.values.data(), s.values.size(), data);
+    CHECK(index == i % 64);
+    uint64_t stamp = 0;
+    REQUIRE(dec.decode(index, data, stamp, values));
+    CHECK(stamp == s.stamp);
+    CHECK(same_bits(values, s.values));
+    if (index == 0) {
+      key_bytes += data.size();
+      keys++;
+    } else {
+      bytes += data.size();
+    }
+  }
+  CHECK(key_bytes == keys * 8 * 11);
+  // float values keep 29 zero bits at the end of every XOR
+  CHECK(bytes < (trace.size() - keys) * 8 * 11 / 2);
+
+  // every class of the delta of delta, stamps going backwards too
+  uint64_t stamp = 1700000000000000000ull, delta = 0, decoded = 0;
+  double value = 1;
+  REQUIRE(enc.encode(stamp, &value, 1, data) == 0);
+  REQUIRE(dec.decode(0, data, decoded, values));
+  for (int64_t dod : {0ll, 1ll, -20000ll, 3000000ll, -4000000000ll,
+                      100000000000ll, -1ll, -200000000000ll, 0ll}) {
+    delta += dod;
+    stamp += delta;
+    auto index = enc.encode(stamp, &value, 1, data);
+    REQUIRE(dec.decode(index, data, decoded, values));
+    CHECK(decoded == stamp);
+  }
+}
+
+TEST_CASE("Gorilla.keys") {
+  auto trace = imu_trace(50);
+  tskpub::GorillaEncoder enc(10);
+  GorillaDecoder dec;
+  std::vector<uint8_t> data;
+  std::vector<double> values;
+  auto send = [&](size_t i) {
+    const auto &s = trace[i];
+    return enc.encode(s.stamp, s.values.data(), s.values.size(), data);
+  };
+  auto receive = [&](size_t i, uint32_t index) {
+    uint64_t stamp = 0;
+    if (!dec.decode(index, data, stamp, values)) return false;
+    CHECK(stamp == trace[i].stamp);
+    CHECK(same_bits(values, trace[i].values));
+    return true;
+  };
+
+  // a late subscriber waits for the next key
+  for (size_t i = 0; i < 3; i++) send(i);
+  for (size_t i = 3; i < 10; i++) CHECK_FALSE(receive(i, send(i)));
+  for (size_t i = 10; i < 15; i++) CHECK(receive(i, send(i)));
+  // a lost message breaks the chain until the next key
+  send(15);
+  for (size_t i = 16; i < 20; i++) CHECK_FALSE(receive(i, send(i)));
+  CHECK(send(20) == 0);
+  CHECK(receive(20, 0));
+  CHECK(receive(21, send(21)));
+
+  // reset() makes the next sample a key
+  enc.reset();
+  CHECK(send(22) == 0);
+  CHECK(receive(22, 0));
+  // so does another number of channels
+  CHECK(send(23) == 1);
+  double one = 1;
+  CHECK(enc.encode(trace[24].stamp, &one, 1, data) == 0);
+  uint64_t stamp = 0;
+  REQUIRE(dec.decode(0, data, stamp, values));
+  CHECK(values == std::vector<double>{1});
+
+  tskpub::GorillaEncoder every(1);
+  CHECK(every.encode(1, &one, 1, data) == 0);
+  CHECK(every.encode(2, &one, 1, data) == 0);
+  CHECK_THROWS_AS(tskpub::GorillaEncoder(0), std::invalid_argument);
+}
+
+// run with --no-skip. TSKPUB_IMU may name a CSV of recorded samples, one
+// per line: stamp in ns, then the channels in the order of the IMU reader
+// (orientation w x y z, angular velocity, linear acceleration). A synthetic
+// trace is used otherwise. Sizes are packed bodies without the frame header
+TEST_CASE("Bench.gorilla" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  std::vector<Sample> trace;
+  std::string source = "synthetic";
+  if (auto file = std::getenv("TSKPUB_IMU")) {
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream ss(line);
+      Sample s{0, {}};
+      std::string field;
+      if (!std::getline(ss, field, ',')) continue;
+      s.stamp = std::stoull(field);
+      while (std::getline(ss, field, ','))
+        s.values.push_back(float(std::stod(field)));
+      if (s.values.size() == 10) trace.push_back(s);
+    }
+    source = file;
+  } else {
+    trace = imu_trace(100000);
+  }
+  REQUIRE(!trace.empty());
+
+  auto packed_size = [](capnp::MallocMessageBuilder &builder) {
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    return out.getArray().size();
+  };
+  size_t imu_bytes = 0;
+  for (const auto &s : trace) {
+    capnp::MallocMessageBuilder builder;
+    auto imu = builder.initRoot<Imu>();
+    const auto &v = s.values;
+    auto ori = imu.initOrientation();
+    ori.setW(v[0]);
+    ori.setX(v[1]);
+    ori.setY(v[2]);
+    ori.setZ(v[3]);
+    auto gyr = imu.initAngularVelocity();
+    gyr.setX(v[4]);
+    gyr.setY(v[5]);
+    gyr.setZ(v[6]);
+    auto acc = imu.initLinearAcceleration();
+    acc.setX(v[7]);
+    acc.setY(v[8]);
+    acc.setZ(v[9]);
+    imu_bytes += packed_size(builder);
+  }
+
+  std::ostringstream os;
+  os << source << ", " << trace.size() << " samples, Imu "
+     << double(imu_bytes) / trace.size() << " B/sample\n"
+     << std::left << std::setw(14) << "key_interval" << std::setw(12)
+     << "ns/sample" << std::setw(12) << "data B" << std::setw(12)
+     << "Series B" << "ratio\n";
+  for (uint32_t interval : {1u, 10u, 100u, 1000u}) {
+    tskpub::GorillaEncoder enc(interval);
+    std::vector<std::vector<uint8_t>> coded(trace.size());
+    std::vector<uint32_t> index(trace.size());
+    auto start = clock::now();
+    for (size_t i = 0; i < trace.size(); i++) {
+      const auto &s = trace[i];
+      index[i] = enc.encode(s.stamp, s.values.data(), s.values.size(),
+                            coded[i]);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(clock::now() - start)
+                  .count();
+
+    size_t data_bytes = 0, series_bytes = 0;
+    for (size_t i = 0; i < trace.size(); i++) {
+      capnp::MallocMessageBuilder builder;
+      auto series = builder.initRoot<Series>();
+      series.setIndex(index[i]);
+      if (index[i] == 0) {
+        auto names = series.initNames(Channels.size());
+        for (size_t k = 0; k < Channels.size(); k++) names.set(k, Channels[k]);
+      }
+      series.setData(kj::ArrayPtr<const kj::byte>(coded[i].data(),
+                                                  coded[i].size()));
+      data_bytes += coded[i].size();
+      series_bytes += packed_size(builder);
+    }
+    os << std::setw(14) << interval << std::setw(12) << ns / trace.size()
+       << std::setw(12) << double(data_bytes) / trace.size() << std::setw(12)
+       << double(series_bytes) / trace.size()
+       << double(imu_bytes) / series_bytes << "\n";
+  }
+  MESSAGE(os.str());
+}
@@ -0,0 +1,114 @@
+#include "TSKPub/lod.hh"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+namespace {
+  struct Point {
+    float x, y, z, intensity;
+  };
+
+  bool operator<(const Point &a, const Point &b) {
+    return std::tie(a.x, a.y, a.z, a.intensity)
+           < std::tie(b.x, b.y, b.z, b.intensity);
+  }
+
+  bool operator==(const Point &a, const Point &b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z
+           && a.intensity == b.intensity;
+  }
+
+  /// @brief Row by row scan of a 4x3 m wall with range noise
+  std::vector<Point> wall(size_t w, size_t h) {
+    std::mt19937 rng{5};
+    std::normal_distribution<float> noise{0.f, 0.002f};
+    std::vector<Point> pts;
+    for (size_t v = 0; v < h; v++) {
+      for (size_t u = 0; u < w; u++) {
+        pts.push_back({3.f + noise(rng), 4.f * u / w - 2.f, 3.f * v / h - 1.f,
+                       float(u + v)});
+      }
+    }
+    return pts;
+  }
+
+  /// @brief Largest distance from a point of the cloud to the closest
+  ///        point of a sample
+  float coverage(const std::vector<Point> &cloud, const Point *sample,
+                 size_t n) {
+    float worst = 0;
+    for (const auto &p : cloud) {
+      float best = 1e9f;
+      for (size_t i = 0; i < n; i++) {
+        const auto &q = sample[i];
+        best = std::min(best, std::hypot(p.x - q.x, p.y - q.y, p.z - q.z));
+      }
+      worst = std::max(worst, best);
+    }
+    return worst;
+  }
+}  // namespace
+
+TEST_CASE("Lod.split") {
+  tskpub::LodSplitter lod({4, 4});
+  auto pts = wall(80, 60);
+  std::vector<Point> out;
+  lod.split(pts.data(), pts.size(), out);
+  REQUIRE(out.size() == pts.size());
+  REQUIRE(lod.layers() == 4);
+
+  // every layer is stride times denser than the layers before it
+  CHECK(lod.offset(0) == 0);
+  CHECK(lod.offset(1) == 75);
+  CHECK(lod.offset(2) == 300);
+  CHECK(lod.offset(3) == 1200);
+  CHECK(lod.offset(4) == 4800);
+
+  // all layers together are the whole cloud
+  auto a = pts, b = out;
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  CHECK(a == b);
+
+  // layer 0 covers the wall evenly, the same number of points in scan
+  // order only covers the first rows
+  auto n = lod.offset(1);
+  auto even = coverage(pts, out.data(), n);
+  CHECK(even < 0.6f);
+  CHECK(even < coverage(pts, pts.data(), n) / 4);
+  // each refinement closes the gaps further
+  CHECK(coverage(pts, out.data(), lod.offset(2)) < even);
+
+  // buffers are reused for a smaller frame
+  lod.split(pts.data(), 10, out);
+  CHECK(out.size() == 10);
+  CHECK(lod.offset(1) == 1);
+  CHECK(lod.offset(4) == 10);
+}
+
+TEST_CASE("Lod.edge_cases") {
+  std::vector<Point> out;
+  // an empty frame has empty layers
+  tskpub::LodSplitter lod({3, 2});
+  lod.split(static_cast<const Point *>(nullptr), 0, out);
+  CHECK(out.empty());
+  CHECK(lod.offset(3) == 0);
+
+  // all points in one spot, a single layer keeps everything
+  std::vector<Point> same(5, Point{1, 2, 3, 4});
+  lod.split(same.data(), same.size(), out);
+  CHECK(out == same);
+  CHECK(lod.offset(1) == 2);
+  tskpub::LodSplitter one({1, 4});
+  one.split(same.data(), same.size(), out);
+  CHECK(one.offset(1) == 5);
+
+  CHECK_THROWS_AS(tskpub::LodSplitter({0, 4}), std::invalid_argument);
+  CHECK_THROWS_AS(tskpub::LodSplitter({4, 1}), std::invalid_argument);
+}
@@ -0,0 +1,288 @@
+#include "TSKPub/octree.hh"
+
+#include <TSKPub/msg/PointCloud.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace {
+  struct Point {
+    float x, y, z, intensity;
+  };
+
+  /// @brief Synthetic ToF frame: a floor and two walls seen from the sensor,
+  ///        320x240 rays with range noise
+  struct Scene {
+    std::mt19937 rng{7};
+    std::normal_distribution<float> noise{0.f, 0.002f};
+
+    std::vector<Point> frame(float yaw = 0.f, size_t w = 320, size_t h = 240) {
+      std::vector<Point> pts;
+      pts.reserve(w * h);
+      for (size_t v = 0; v < h; v++) {
+        for (size_t u = 0; u < w; u++) {
+          // ray direction in a 90x70 degree field of view
+          float az = (u / float(w) - 0.5f) * 1.57f + yaw;
+          float el = (v / float(h) - 0.5f) * 1.22f;
+          float dx = std::cos(el) * std::cos(az);
+          float dy = std::cos(el) * std::sin(az);
+          float dz = std::sin(el);
+          // closest hit of floor z=-0.3, wall x=3, wall y=+-2
+          float t = 1e9f;
+          if (dz < 0) t = std::min(t, -0.3f / dz);
+          if (dx > 0) t = std::min(t, 3.f / dx);
+          if (dy != 0) t = std::min(t, 2.f / std::abs(dy));
+          t += noise(rng);
+          pts.push_back({t * dx, t * dy, t * dz, 500.f + 100.f * dz});
+        }
+      }
+      return pts;
+    }
+  };
+
+  /// @brief Size of the current PointCloud message for n points
+  size_t pointcloud_bytes(const std::vector<Point> &pts, size_t n) {
+    capnp::MallocMessageBuilder builder;
+    auto msg = builder.initRoot<PointCloud>();
+    msg.setTopic("/tinysk/laser");
+    msg.setTimestamp(1);
+    auto points = msg.initPoints(n);
+    for (size_t i = 0; i < n; i++) {
+      const auto &p = pts[i * pts.size() / n];
+      points[i].setX(p.x);
+      points[i].setY(p.y);
+      points[i].setZ(p.z);
+      points[i].setI(p.intensity);
+    }
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    return out.getArray().size();
+  }
+}  // namespace
+
+TEST_CASE("Octree.occupancy") {
+  std::mt19937_64 rng{1};
+  std::vector<uint64_t> codes(1000), out;
+  for (auto &c : codes) c = rng() & ((1ull << 30) - 1);
+  std::sort(codes.begin(), codes.end());
+  codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+
+  std::vector<uint8_t> occ;
+  tskpub::encode_occupancy(codes, 10, occ);
+  REQUIRE(tskpub::decode_occupancy(occ, 10, out));
+  CHECK(out == codes);
+
+  // truncated masks are rejected
+  occ.pop_back();
+  CHECK_FALSE(tskpub::decode_occupancy(occ, 10, out));
+}
+
+TEST_CASE("Octree.keyframe") {
+  tskpub::OctreeParams params;
+  params.resolution = 0.02f;
+  params.range = 4.f;
+  params.max_intensity = 1000.f;
+  tskpub::OctreeEncoder enc(params);
+  tskpub::OctreeDecoder dec;
+  Scene scene;
+  auto pts = scene.frame(0, 80, 60);
+  // invalid points are skipped
+  pts.push_back({NAN, 0, 0, 0});
+  pts.push_back({100.f, 0, 0, 0});
+
+  tskpub::OctreeFrame frame;
+  enc.encode(pts.data(), pts.size(), frame);
+  CHECK(frame.keyframe);
+  std::vector<tskpub::OctreeDecoder::Point> out;
+  REQUIRE(dec.decode(frame, params.max_intensity, out));
+  REQUIRE(out.size() > 0);
+  CHECK(out.size() <= pts.size() - 2);
+
+  // every decoded voxel center is close to an input point
+  const float tol = params.resolution * std::sqrt(3.f) / 2 + 1e-4f;
+  for (const auto &q : out) {
+    float best = 1e9f;
+    for (size_t i = 0; i + 2 < pts.size(); i++) {
+      const auto &p = pts[i];
+      best = std::min(best, std::hypot(p.x - q.x, p.y - q.y, p.z - q.z));
+    }
+    REQUIRE(best <= tol);
+    CHECK(q.intensity == doctest::Approx(500.f).epsilon(0.25));
+  }
+}
+
+TEST_CASE("Octree.differential") {
+  tskpub::OctreeParams params;
+  params.resolution = 0.02f;
+  params.keyframe_interval = 5;
+  tskpub::OctreeEncoder enc(params), key_enc(params);
+  tskpub::OctreeDecoder dec, key_dec;
+  Scene scene;
+  auto pts = scene.frame(0, 160, 120);
+
+  std::vector<tskpub::OctreeDecoder::Point> out, ref;
+  tskpub::OctreeFrame frame, key;
+  size_t diff_bytes = 0, key_bytes = 0;
+  for (int i = 0; i < 10; i++) {
+    // the scene is static except for a small moving object
+    auto cur = pts;
+    for (size_t k = 0; k < 500; k++) {
+      cur[k].x = 1.f + 0.05f * i;
+      cur[k].y = 0.001f * k;
+    }
+    enc.encode(cur.data(), cur.size(), frame);
+    CHECK(frame.keyframe == (i % 5 == 0));
+    REQUIRE(dec.decode(frame, params.max_intensity, out));
+
+    // compare with a key frame only stream
+    key_enc.reset();
+    key_enc.encode(cur.data(), cur.size(), key);
+    REQUIRE(key_dec.decode(key, params.max_intensity, ref));
+    REQUIRE(out.size() == ref.size());
+    for (size_t k = 0; k < out.size(); k++) {
+      CHECK(out[k].x == ref[k].x);
+      CHECK(out[k].y == ref[k].y);
+      CHECK(out[k].z == ref[k].z);
+      // kept voxels may lag behind by the intensity threshold
+      CHECK(std::abs(out[k].intensity - ref[k].intensity)
+            <= (params.intensity_threshold + 1) * params.max_intensity / 255);
+    }
+    diff_bytes += frame.bytes();
+    key_bytes += key.bytes();
+  }
+  MESSAGE("10 frames, differential " << diff_bytes << " B, key frames only "
+                                     << key_bytes << " B");
+  CHECK(diff_bytes < key_bytes / 2);
+
+  // a lost frame breaks the chain until the next key frame
+  tskpub::OctreeDecoder late;
+  enc.encode(pts.data(), pts.size(), frame);
+  CHECK(frame.keyframe);
+  enc.encode(pts.data(), pts.size(), frame);
+  CHECK_FALSE(frame.keyframe);
+  CHECK_FALSE(late.decode(frame, params.max_intensity, out));
+}
+
+TEST_CASE("Octree.voxel_hash") {
+  tskpub::VoxelHash grid;
+  CHECK(grid.find(1) == nullptr);
+  // more voxels than the initial slots, every code twice
+  for (int round = 0; round < 2; round++) {
+    for (uint64_t c = 0; c < 5000; c++) grid.add(c * 7919, c % 200 + round);
+  }
+  REQUIRE(grid.size() == 5000);
+  for (uint64_t c = 0; c < 5000; c++) {
+    auto v = grid.find(c * 7919);
+    REQUIRE(v != nullptr);
+    CHECK(v->count == 2);
+    CHECK(v->intensity() == c % 200);
+  }
+  CHECK(grid.find(7918) == nullptr);
+
+  // cleared voxels are gone, the slots are reused
+  grid.clear();
+  CHECK(grid.size() == 0);
+  CHECK(grid.find(0) == nullptr);
+  grid.add(42, 9);
+  REQUIRE(grid.find(42) != nullptr);
+  CHECK(grid.find(42)->intensity() == 9);
+  CHECK(grid.find(7919) == nullptr);
+}
+
+TEST_CASE("Octree.keyframe_reference") {
+  tskpub::OctreeParams params;
+  params.resolution = 0.05f;
+  params.keyframe_interval = 10;
+  params.reference = tskpub::OctreeParams::Reference::Keyframe;
+  tskpub::OctreeEncoder enc(params), key_enc(params);
+  tskpub::OctreeDecoder dec, key_dec;
+  // a static scene, only the range noise changes between frames
+  Scene scene;
+
+  std::vector<tskpub::OctreeDecoder::Point> out, ref;
+  tskpub::OctreeFrame frame, key;
+  size_t diff_bytes = 0, key_bytes = 0;
+  for (uint32_t i = 0; i < 20; i++) {
+    auto cur = scene.frame(0, 160, 120);
+    enc.encode(cur.data(), cur.size(), frame);
+    CHECK(frame.keyframe == (i % 10 == 0));
+    CHECK(frame.reference == i / 10 * 10);
+    key_enc.reset();
+    key_enc.encode(cur.data(), cur.size(), key);
+    diff_bytes += frame.bytes();
+    key_bytes += key.bytes();
+    // every other difference is lost, the rest only need the key frame
+    if (i % 2 == 1) continue;
+    REQUIRE(dec.decode(frame, params.max_intensity, out));
+    REQUIRE(key_dec.decode(key, params.max_intensity, ref));
+    REQUIRE(out.size() == ref.size());
+    for (size_t k = 0; k < out.size(); k++) {
+      CHECK(out[k].x == ref[k].x);
+      CHECK(out[k].y == ref[k].y);
+      CHECK(out[k].z == ref[k].z);
+    }
+  }
+  MESSAGE("20 frames, key frame differences " << diff_bytes
+                                              << " B, key frames only "
+                                              << key_bytes << " B");
+  // range noise moves points across voxel borders
+  CHECK(diff_bytes < key_bytes * 3 / 4);
+
+  // a decoder that missed the key frame waits for the next one
+  tskpub::OctreeDecoder late;
+  CHECK_FALSE(late.decode(frame, params.max_intensity, out));
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.octree" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  Scene scene;
+  std::vector<std::vector<Point>> frames;
+  for (int i = 0; i < 20; i++) frames.push_back(scene.frame(0.002f * i));
+  const auto n = frames[0].size();
+
+  std::ostringstream os;
+  os << std::left << std::setw(28) << "encoding" << std::setw(14)
+     << "bytes/frame" << "ms/frame\n";
+  auto bench = [&](const std::string &name, auto &&encode) {
+    size_t bytes = 0;
+    auto start = clock::now();
+    for (const auto &f : frames) bytes += encode(f);
+    auto ms = std::chrono::duration<double, std::milli>(clock::now() - start)
+                  .count();
+    os << std::setw(28) << name << std::setw(14) << bytes / frames.size()
+       << ms / frames.size() << "\n";
+  };
+
+  bench("PointCloud 5000 points", [](auto &f) {
+    return pointcloud_bytes(f, 5000);
+  });
+  bench("PointCloud all points", [&](auto &f) {
+    return pointcloud_bytes(f, n);
+  });
+  for (float res : {0.01f, 0.02f, 0.05f}) {
+    for (int mode : {0, 1, 2}) {
+      tskpub::OctreeParams params;
+      params.resolution = res;
+      params.keyframe_interval = mode == 0 ? 1 : 10;
+      if (mode == 2) {
+        params.reference = tskpub::OctreeParams::Reference::Keyframe;
+      }
+      tskpub::OctreeEncoder enc(params);
+      tskpub::OctreeFrame frame;
+      std::ostringstream name;
+      const char *modes[] = {" key only", " differential", " to key frame"};
+      name << "octree " << res * 100 << "cm" << modes[mode];
+      bench(name.str(), [&](auto &f) {
+        enc.encode(f.data(), f.size(), frame);
+        return frame.bytes();
+      });
+    }
+  }
+  MESSAGE(os.str());
+}
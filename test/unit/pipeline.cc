@@ -0,0 +1,179 @@
+#include "reader/pipeline.hh"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using Data = std::vector<int>;
+  using DataStage = tskpub::Stage<Data>;
+  using DataPipeline = tskpub::Pipeline<Data>;
+
+  /// @brief Adds a value to every element in place
+  class AddStage final : public DataStage {
+  public:
+    explicit AddStage(int value) : value_(value) {}
+
+    bool process(Data& data) override {
+      for (auto& v : data) v += value_;
+      return true;
+    }
+
+    bool accepts(const std::string& key, double value) const override {
+      return key == "add" && value != 0;
+    }
+
+    void set_param(const std::string&, double value) override {
+      value_ = value;
+    }
+
+  private:
+    std::atomic<int> value_;
+  };
+
+  /// @brief Discards data with an odd first element
+  class EvenStage final : public DataStage {
+  public:
+    bool process(Data& data) override {
+      return !data.empty() && data[0] % 2 == 0;
+    }
+  };
+
+  /// @brief Blocks process() until opened
+  class GateStage final : public DataStage {
+  public:
+    bool process(Data&) override {
+      std::unique_lock<std::mutex> lock(mtx_);
+      entered_++;
+      cv_.notify_all();
+      cv_.wait(lock, [this] { return opened_; });
+      return true;
+    }
+
+    void wait_entered(int n) {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [&] { return entered_ >= n; });
+    }
+
+    void open() {
+      std::lock_guard<std::mutex> lock(mtx_);
+      opened_ = true;
+      cv_.notify_all();
+    }
+
+  private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    int entered_{0};
+    bool opened_{false};
+  };
+
+  const bool registed
+      = tskpub::StageFactory<Data>::regist(
+            "add",
+            [](const fkyaml::node& cfg) -> DataStage::Ptr {
+              return std::make_unique<AddStage>(cfg["value"].get_value<int>());
+            })
+        && tskpub::StageFactory<Data>::regist(
+            "even", [](const fkyaml::node&) -> DataStage::Ptr {
+              return std::make_unique<EvenStage>();
+            });
+
+  /// @brief Collects the sink output
+  struct Output {
+    std::mutex mtx;
+    std::vector<Data> data;
+    std::vector<tskpub::DropStage> drops;
+
+    DataPipeline::Sink sink() {
+      return [this](Data&& d) {
+        std::lock_guard<std::mutex> lock(mtx);
+        data.push_back(std::move(d));
+      };
+    }
+
+    DataPipeline::DropCallback on_drop() {
+      return [this](tskpub::DropStage stage) {
+        std::lock_guard<std::mutex> lock(mtx);
+        drops.push_back(stage);
+      };
+    }
+
+    size_t size() {
+      std::lock_guard<std::mutex> lock(mtx);
+      return data.size();
+    }
+  };
+}  // namespace
+
+TEST_CASE("Pipeline.load") {
+  REQUIRE(registed);
+  Output out;
+  DataPipeline pipeline(out.sink(), out.on_drop());
+  pipeline.load(fkyaml::node::deserialize(
+      "- {stage: add, value: 2}\n- {stage: even}\n- {stage: add, value: 1}"));
+  CHECK(pipeline.size() == 3);
+
+  Data data{2, 3, 4};
+  auto buffer = data.data();
+  pipeline.push(std::move(data));
+  REQUIRE(out.data.size() == 1);
+  CHECK(out.data[0] == Data{5, 6, 7});
+  // the buffer is moved through every stage
+  CHECK(out.data[0].data() == buffer);
+
+  // discarded by a stage
+  pipeline.push({1});
+  CHECK(out.data.size() == 1);
+  REQUIRE(out.drops.size() == 1);
+  CHECK(out.drops[0] == tskpub::DropStage::Read);
+
+  CHECK_THROWS_AS(
+      pipeline.load(fkyaml::node::deserialize("- {stage: unknown}")),
+      std::runtime_error);
+}
+
+TEST_CASE("Pipeline.params") {
+  Output out;
+  DataPipeline pipeline(out.sink());
+  CHECK_FALSE(pipeline.accepts("add", 3));
+  pipeline.add(std::make_unique<AddStage>(1));
+  CHECK(pipeline.accepts("add", 3));
+  CHECK_FALSE(pipeline.accepts("add", 0));
+  pipeline.set_param("add", 3);
+  pipeline.push({0});
+  REQUIRE(out.data.size() == 1);
+  CHECK(out.data[0] == Data{3});
+}
+
+// an async stage runs on the executor, a busy segment keeps the latest data
+TEST_CASE("Pipeline.async") {
+  Output out;
+  auto gate = std::make_unique<GateStage>();
+  auto& g = *gate;
+  {
+    DataPipeline pipeline(out.sink(), out.on_drop());
+    pipeline.add(std::make_unique<AddStage>(1));
+    pipeline.add(std::move(gate), true);
+
+    // push() does not wait for the blocked segment
+    pipeline.push({0});
+    g.wait_entered(1);
+    pipeline.push({1});
+    pipeline.push({2});
+    CHECK(out.size() == 0);
+    g.open();
+  }
+  // the destructor waited for the segment
+  REQUIRE(out.data.size() == 2);
+  CHECK(out.data[0] == Data{1});
+  CHECK(out.data[1] == Data{3});
+  REQUIRE(out.drops.size() == 1);
+  CHECK(out.drops[0] == tskpub::DropStage::Overwrite);
+}
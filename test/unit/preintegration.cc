@@ -0,0 +1,207 @@
+#include "TSKPub/preintegration.hh"
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace {
+  // allocations of the calling thread, counted by the operator new below
+  thread_local size_t allocations = 0;
+
+  struct Sample {
+    uint64_t stamp;
+    double acc[3];
+    double gyr[3];
+  };
+
+  /// @brief Samples of a smooth motion at rate Hz over seconds
+  std::vector<Sample> motion(double rate, double seconds) {
+    std::vector<Sample> samples;
+    for (size_t i = 1; i <= size_t(rate * seconds); i++) {
+      double t = i / rate;
+      samples.push_back({uint64_t(std::llround(t * 1e9)),
+                         {std::sin(t), 9.8 + 0.5 * std::cos(2 * t), 0.3 * t},
+                         {0.8 * std::sin(3 * t), 0.5, -0.6 * std::cos(t)}});
+    }
+    return samples;
+  }
+
+  /// @brief Offline reference: every sample held over its interval and
+  ///        integrated in fine steps with an exact rotation per step
+  struct Reference {
+    std::array<double, 9> r{1, 0, 0, 0, 1, 0, 0, 0, 1};
+    std::array<double, 3> v{0, 0, 0}, p{0, 0, 0};
+
+    void integrate(const Sample& s, double dt, int steps = 1000) {
+      double h = dt / steps;
+      for (int k = 0; k < steps; k++) {
+        double a[3];
+        for (int i = 0; i < 3; i++) {
+          a[i] = r[i * 3] * s.acc[0] + r[i * 3 + 1] * s.acc[1]
+                 + r[i * 3 + 2] * s.acc[2];
+        }
+        for (int i = 0; i < 3; i++) {
+          p[i] += v[i] * h + 0.5 * a[i] * h * h;
+          v[i] += a[i] * h;
+        }
+        rotate(s.gyr, h);
+      }
+    }
+
+    void rotate(const double* w, double h) {
+      double phi[3] = {w[0] * h, w[1] * h, w[2] * h};
+      double t = std::sqrt(phi[0] * phi[0] + phi[1] * phi[1] + phi[2] * phi[2]);
+      double k[3] = {phi[0] / t, phi[1] / t, phi[2] / t};
+      double c = std::cos(t), s = std::sin(t), C = 1 - c;
+      // axis angle matrix
+      std::array<double, 9> e{c + k[0] * k[0] * C,
+                              k[0] * k[1] * C - k[2] * s,
+                              k[0] * k[2] * C + k[1] * s,
+                              k[1] * k[0] * C + k[2] * s,
+                              c + k[1] * k[1] * C,
+                              k[1] * k[2] * C - k[0] * s,
+                              k[2] * k[0] * C - k[1] * s,
+                              k[2] * k[1] * C + k[0] * s,
+                              c + k[2] * k[2] * C};
+      std::array<double, 9> n{};
+      for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+          for (int m = 0; m < 3; m++) {
+            n[i * 3 + j] += r[i * 3 + m] * e[m * 3 + j];
+          }
+        }
+      }
+      r = n;
+    }
+  };
+
+  /// @brief Rotation matrix of a quaternion w, x, y, z
+  std::array<double, 9> matrix(const std::array<double, 4>& q) {
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    return {1 - 2 * (y * y + z * z), 2 * (x * y - w * z),
+            2 * (x * z + w * y),     2 * (x * y + w * z),
+            1 - 2 * (x * x + z * z), 2 * (y * z - w * x),
+            2 * (x * z - w * y),     2 * (y * z + w * x),
+            1 - 2 * (x * x + y * y)};
+  }
+
+  double max_diff(const double* a, const double* b, size_t n) {
+    double d = 0;
+    for (size_t i = 0; i < n; i++) d = std::max(d, std::abs(a[i] - b[i]));
+    return d;
+  }
+}  // namespace
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// 200 Hz samples of a tumbling motion against a fine offline integration
+TEST_CASE("Preintegration.reference") {
+  auto samples = motion(200, 2);
+  tskpub::Preintegrator pre;
+  pre.reset(0);
+  Reference ref;
+  uint64_t last = 0;
+  for (const auto& s : samples) {
+    pre.integrate(s.acc, s.gyr, s.stamp);
+    ref.integrate(s, (s.stamp - last) * 1e-9);
+    last = s.stamp;
+  }
+  const auto& d = pre.delta();
+  CHECK(d.samples == samples.size());
+  CHECK(d.end == samples.back().stamp);
+  CHECK(d.duration() == doctest::Approx(2));
+  auto r = matrix(d.rotation);
+  CHECK(max_diff(r.data(), ref.r.data(), 9) < 1e-6);
+  CHECK(max_diff(d.velocity.data(), ref.v.data(), 3) < 1e-4);
+  CHECK(max_diff(d.position.data(), ref.p.data(), 3) < 1e-4);
+  // the motion is large enough to make the check meaningful
+  CHECK(std::abs(ref.v[1]) > 1);
+}
+
+// splitting the samples at an anchor and chaining the two deltas gives the
+// delta over the whole time
+TEST_CASE("Preintegration.split") {
+  auto samples = motion(100, 1);
+  tskpub::Preintegrator whole, first, second;
+  whole.reset(0);
+  first.reset(0);
+  const uint64_t anchor = 333333333;
+  for (const auto& s : samples) {
+    whole.integrate(s.acc, s.gyr, s.stamp);
+    if (s.stamp <= anchor) {
+      first.integrate(s.acc, s.gyr, s.stamp);
+      continue;
+    }
+    if (first.delta().end < anchor) {
+      first.integrate(s.acc, s.gyr, anchor);
+      second.reset(anchor);
+    }
+    second.integrate(s.acc, s.gyr, s.stamp);
+  }
+  const auto &a = first.delta(), &b = second.delta(), &w = whole.delta();
+  CHECK(a.end == anchor);
+  CHECK(b.start == anchor);
+  CHECK(a.samples + b.samples == w.samples + 1);
+
+  // R = Ra Rb, v = va + Ra vb, p = pa + va tb + Ra pb
+  auto ra = matrix(a.rotation), rb = matrix(b.rotation);
+  std::array<double, 9> r{};
+  std::array<double, 3> v{}, p{};
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) r[i * 3 + j] += ra[i * 3 + k] * rb[k * 3 + j];
+      v[i] += ra[i * 3 + j] * b.velocity[j];
+      p[i] += ra[i * 3 + j] * b.position[j];
+    }
+    v[i] += a.velocity[i];
+    p[i] += a.position[i] + a.velocity[i] * b.duration();
+  }
+  auto rw = matrix(w.rotation);
+  CHECK(max_diff(r.data(), rw.data(), 9) < 1e-9);
+  CHECK(max_diff(v.data(), w.velocity.data(), 3) < 1e-6);
+  CHECK(max_diff(p.data(), w.position.data(), 3) < 1e-6);
+}
+
+TEST_CASE("Preintegration.covariance") {
+  tskpub::ImuNoise noise;
+  tskpub::Preintegrator pre(noise);
+  pre.reset(0);
+  const double acc[3] = {0, 0, 9.8}, gyr[3] = {0, 0, 0};
+  for (uint64_t i = 1; i <= 100; i++) pre.integrate(acc, gyr, i * 10000000);
+  const auto& cov = pre.delta().covariance;
+  for (int i = 0; i < 9; i++) {
+    CHECK(cov[i * 9 + i] > 0);
+    for (int j = 0; j < i; j++) {
+      CHECK(cov[i * 9 + j] == doctest::Approx(cov[j * 9 + i]));
+    }
+  }
+  // a resting IMU: the rotation error is a random walk of the rate noise
+  CHECK(cov[0] == doctest::Approx(noise.gyro * noise.gyro * 1.0));
+  // along gravity only the accelerometer noise adds up
+  CHECK(cov[5 * 9 + 5] == doctest::Approx(noise.acc * noise.acc * 1.0));
+  // tilt errors leak gravity into the horizontal velocity
+  CHECK(cov[3 * 9 + 3] > cov[5 * 9 + 5]);
+}
+
+// the sample path runs at the full IMU rate and must not allocate
+TEST_CASE("Preintegration.no_allocation") {
+  auto samples = motion(400, 5);
+  tskpub::Preintegrator pre;
+  pre.reset(0);
+  auto before = allocations;
+  for (const auto& s : samples) pre.integrate(s.acc, s.gyr, s.stamp);
+  pre.reset(samples.back().stamp);
+  CHECK(allocations == before);
+}
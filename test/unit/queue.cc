@@ -0,0 +1,237 @@
+#include "TSKPub/queue.hh"
+
+#include <doctest/doctest.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+  using Policy = tskpub::MessageQueue::Policy;
+
+  /// @brief Message of n bytes, the first byte tags it
+  tskpub::MsgConstPtr make(size_t n, uint8_t tag = 0) {
+    auto msg = std::make_shared<tskpub::Msg>(n);
+    if (n) (*msg)[0] = tag;
+    return msg;
+  }
+
+  tskpub::MessageQueue::TopicParams params(size_t msgs, size_t bytes,
+                                           Policy policy) {
+    tskpub::MessageQueue::TopicParams p;
+    p.max_msgs = msgs;
+    p.max_bytes = bytes;
+    p.policy = policy;
+    return p;
+  }
+
+  /// @brief Resident set size of this process
+  size_t rss() {
+    size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+  }
+}  // namespace
+
+TEST_CASE("Queue.drop_oldest") {
+  tskpub::MessageQueue q;
+  q.add_topic("imu", params(3, 0, Policy::DropOldest));
+  size_t dropped = 0;
+  for (uint8_t i = 0; i < 5; i++) dropped += q.push("imu", make(8, i));
+  CHECK(dropped == 2);
+  CHECK(q.size() == 3);
+  CHECK(q.stats("imu").dropped_msgs == 2);
+  CHECK(q.stats("imu").pushed_msgs == 5);
+  // the freshest messages are kept
+  for (uint8_t i = 2; i < 5; i++) CHECK((*q.pop())[0] == i);
+  CHECK((q.pop() == nullptr));
+  CHECK(q.bytes() == 0);
+}
+
+TEST_CASE("Queue.drop_newest") {
+  tskpub::MessageQueue q;
+  q.add_topic("status", params(8, 20, Policy::DropNewest));
+  CHECK(q.push("status", make(8, 0)) == 0);
+  CHECK(q.push("status", make(8, 1)) == 0);
+  // over the byte limit
+  CHECK(q.push("status", make(8, 2)) == 1);
+  // larger than the limit on its own
+  CHECK(q.push("status", make(32, 3)) == 1);
+  CHECK(q.bytes() == 16);
+  CHECK((*q.pop())[0] == 0);
+  CHECK((*q.pop())[0] == 1);
+}
+
+TEST_CASE("Queue.order") {
+  tskpub::MessageQueue q;
+  std::vector<std::string> names{"imu", "video", "imu", "laser", "video"};
+  for (size_t i = 0; i < names.size(); i++) q.push(names[i], make(4, i));
+  std::string name;
+  for (size_t i = 0; i < names.size(); i++) {
+    auto msg = q.pop(&name);
+    REQUIRE((msg != nullptr));
+    CHECK(name == names[i]);
+    CHECK((*msg)[0] == i);
+  }
+}
+
+// the ceiling is shared, a full topic never evicts another one
+TEST_CASE("Queue.ceiling") {
+  tskpub::MessageQueue q(100);
+  q.add_topic("video", params(10, 0, Policy::DropOldest));
+  q.add_topic("imu", params(10, 0, Policy::DropOldest));
+  for (int i = 0; i < 4; i++) q.push("video", make(30));
+  // video evicts its own oldest message to stay under the ceiling
+  CHECK(q.stats("video").dropped_msgs == 1);
+  CHECK(q.bytes() == 90);
+  CHECK(q.push("imu", make(8)) == 0);
+  // no room left and nothing of imu to evict
+  CHECK(q.push("imu", make(8)) == 1);
+  CHECK(q.stats("video").dropped_msgs == 1);
+  CHECK(q.bytes() <= 100);
+}
+
+TEST_CASE("Queue.block") {
+  tskpub::MessageQueue q;
+  q.add_topic("laser", params(1, 0, Policy::Block));
+  CHECK(q.push("laser", make(8, 0)) == 0);
+
+  std::atomic<bool> done{false};
+  size_t dropped = 99;
+  std::thread producer([&] {
+    dropped = q.push("laser", make(8, 1));
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK_FALSE(done);
+  CHECK((*q.pop())[0] == 0);
+  producer.join();
+  CHECK(dropped == 0);
+  CHECK(q.stats("laser").blocked_ns > 0);
+
+  // closing releases a blocked producer, its message is dropped
+  producer = std::thread([&] { dropped = q.push("laser", make(8, 2)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  q.close();
+  producer.join();
+  CHECK(dropped == 1);
+  CHECK((*q.pop())[0] == 1);
+}
+
+// a bounded wait drops the new message when no room is made in time
+TEST_CASE("Queue.block_timeout") {
+  tskpub::MessageQueue q;
+  auto p = params(1, 0, Policy::Block);
+  p.max_wait = std::chrono::milliseconds(20);
+  q.add_topic("laser", p);
+  CHECK(q.push("laser", make(8, 0)) == 0);
+
+  auto start = std::chrono::steady_clock::now();
+  CHECK(q.push("laser", make(8, 1)) == 1);
+  CHECK(std::chrono::steady_clock::now() - start
+        >= std::chrono::milliseconds(20));
+  CHECK(q.stats("laser").dropped_msgs == 1);
+  CHECK((*q.pop())[0] == 0);
+
+  // room made while waiting
+  CHECK(q.push("laser", make(8, 2)) == 0);
+  p.max_wait = std::chrono::seconds(10);
+  q.add_topic("laser", p);
+  std::thread consumer([&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.pop();
+  });
+  CHECK(q.push("laser", make(8, 3)) == 0);
+  consumer.join();
+  CHECK((*q.pop())[0] == 3);
+}
+
+TEST_CASE("Queue.refinements") {
+  tskpub::MessageQueue q;
+  q.add_topic("laser", params(4, 0, Policy::DropOldest));
+  // a frame in three layers fits
+  for (uint8_t l = 0; l < 3; l++) CHECK(q.push("laser", make(8, l), l) == 0);
+  CHECK(q.push("laser", make(8, 10), 0) == 0);
+  // the next frame evicts the finest layer of the first one
+  CHECK(q.push("laser", make(8, 11), 1) == 1);
+  // no room for a layer without evicting its level or below
+  CHECK(q.push("laser", make(8, 12), 2) == 1);
+  CHECK(q.push("laser", make(8, 20), 0) == 1);
+  CHECK(q.stats("laser").dropped_msgs == 3);
+
+  // the base messages of both frames survive
+  std::vector<std::pair<uint8_t, uint8_t>> popped;
+  uint8_t level = 99;
+  while (auto msg = q.pop(nullptr, &level)) {
+    popped.emplace_back((*msg)[0], level);
+  }
+  CHECK(popped
+        == std::vector<std::pair<uint8_t, uint8_t>>{{0, 0}, {10, 0}, {11, 1},
+                                                   {20, 0}});
+
+  // a refinement never waits for room
+  q.add_topic("depth", params(1, 0, Policy::Block));
+  CHECK(q.push("depth", make(8, 0), 0) == 0);
+  CHECK(q.push("depth", make(8, 1), 1) == 1);
+  CHECK(q.stats("depth").blocked_ns == 0);
+}
+
+// camera sized messages from several fast sensors into a slow publisher,
+// memory stays at the ceiling instead of growing with the backlog
+TEST_CASE("Queue.bounded_rss") {
+  constexpr size_t msg_size = 1 << 20;
+  constexpr size_t ceiling = 16 * msg_size;
+  constexpr size_t producers = 4;
+  constexpr size_t per_producer = 100;
+  // large buffers go straight to mmap, so the RSS follows the live messages
+  // instead of the allocator high water mark. The setting is process wide,
+  // glibc has no getter, so the default threshold comes back at the end
+  struct MmapThreshold {
+    MmapThreshold() { mallopt(M_MMAP_THRESHOLD, 64 * 1024); }
+    ~MmapThreshold() { mallopt(M_MMAP_THRESHOLD, 128 * 1024); }
+  } threshold;
+
+  tskpub::MessageQueue q(ceiling);
+  for (size_t i = 0; i < producers; i++) {
+    q.add_topic("cam" + std::to_string(i),
+                params(64, 0, Policy::DropOldest));
+  }
+  auto base = rss();
+
+  std::atomic<size_t> running{producers};
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < producers; i++) {
+    threads.emplace_back([&, i] {
+      auto name = "cam" + std::to_string(i);
+      for (size_t k = 0; k < per_producer; k++) q.push(name, make(msg_size));
+      running--;
+    });
+  }
+
+  size_t peak = 0, peak_bytes = 0, popped = 0;
+  while (running || q.size()) {
+    if (q.pop()) popped++;
+    peak = std::max(peak, rss());
+    peak_bytes = std::max(peak_bytes, q.bytes());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  for (auto &t : threads) t.join();
+
+  uint64_t dropped = 0;
+  for (size_t i = 0; i < producers; i++) {
+    dropped += q.stats("cam" + std::to_string(i)).dropped_msgs;
+  }
+  CHECK(popped + dropped == producers * per_producer);
+  CHECK(dropped > 0);
+  CHECK(peak_bytes <= ceiling);
+  // queued messages plus one in flight per thread
+  CHECK(peak - std::min(peak, base) <= ceiling + 2 * producers * msg_size);
+  MESSAGE("peak RSS growth " << (peak - std::min(peak, base)) / msg_size
+                             << " MB with a " << ceiling / msg_size
+                             << " MB ceiling");
+}
@@ -0,0 +1,167 @@
+#include "TSKPub/range_image.hh"
+
+#include <TSKPub/msg/PointCloud.capnp.h>
+#include <capnp/serialize-packed.h>
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+#include "TSKPub/compress.hh"
+
+namespace {
+  struct Point {
+    float x, y, z, intensity;
+  };
+
+  const tskpub::Intrinsics truth{200.f, 201.f, 159.5f, 119.5f};
+
+  /// @brief Synthetic organized ToF frame in the optical frame: a floor, a
+  ///        back wall and two side walls, some pixels without return
+  struct Scene {
+    std::mt19937 rng{11};
+    std::normal_distribution<float> noise{0.f, 0.003f};
+
+    std::vector<Point> frame(uint16_t w = 320, uint16_t h = 240) {
+      std::vector<Point> pts(size_t(w) * h);
+      for (uint16_t v = 0; v < h; v++) {
+        for (uint16_t u = 0; u < w; u++) {
+          auto &p = pts[size_t(v) * w + u];
+          if (rng() % 20 == 0) {
+            p = {NAN, NAN, NAN, 0.f};
+            continue;
+          }
+          float dx = (u - truth.cx) / truth.fx;
+          float dy = (v - truth.cy) / truth.fy;
+          // closest hit of floor y=0.3, wall z=3, walls x=+-2
+          float t = 3.f;
+          if (dy > 0) t = std::min(t, 0.3f / dy);
+          if (dx != 0) t = std::min(t, 2.f / std::abs(dx));
+          float n = std::sqrt(dx * dx + dy * dy + 1);
+          float r = t * n + noise(rng);
+          t = r / n;
+          p = {t * dx, t * dy, t, 300.f + 200.f * dy};
+        }
+      }
+      return pts;
+    }
+  };
+
+  /// @brief Size of the current PointCloud message for n points
+  size_t pointcloud_bytes(const std::vector<Point> &pts, size_t n) {
+    capnp::MallocMessageBuilder builder;
+    auto msg = builder.initRoot<PointCloud>();
+    msg.setTopic("/tinysk/laser");
+    msg.setTimestamp(1);
+    auto points = msg.initPoints(n);
+    for (size_t i = 0; i < n; i++) {
+      const auto &p = pts[i * pts.size() / n];
+      points[i].setX(p.x);
+      points[i].setY(p.y);
+      points[i].setZ(p.z);
+      points[i].setI(p.intensity);
+    }
+    kj::VectorOutputStream out;
+    capnp::writePackedMessage(out, builder);
+    return out.getArray().size();
+  }
+}  // namespace
+
+TEST_CASE("RangeImage.intrinsics") {
+  Scene scene;
+  auto pts = scene.frame();
+  tskpub::Intrinsics k;
+  REQUIRE(tskpub::fit_intrinsics(pts.data(), 320, 240, k));
+  CHECK(k.fx == doctest::Approx(truth.fx).epsilon(1e-3));
+  CHECK(k.fy == doctest::Approx(truth.fy).epsilon(1e-3));
+  CHECK(k.cx == doctest::Approx(truth.cx).epsilon(1e-3));
+  CHECK(k.cy == doctest::Approx(truth.cy).epsilon(1e-3));
+
+  // an empty frame can not be fitted
+  std::vector<Point> empty(320 * 240, Point{NAN, NAN, NAN, 0.f});
+  CHECK_FALSE(tskpub::fit_intrinsics(empty.data(), 320, 240, k));
+}
+
+TEST_CASE("RangeImage.roundtrip") {
+  Scene scene;
+  auto pts = scene.frame();
+  tskpub::RangeImage img;
+  img.intrinsics = truth;
+  img.max_intensity = 1000.f;
+  img.from_points(pts.data(), 320, 240);
+
+  // planes survive shuffling and compression
+  tskpub::Msg planes;
+  tskpub::shuffle_depth(img.depth, planes);
+  tskpub::CompressParams cp;
+  cp.algo = "zstd";
+  cp.level = 1;
+  auto c = tskpub::CompressorFactory::create(cp);
+  auto packed = tskpub::compress(*c, planes.data(), planes.size());
+  std::vector<uint16_t> depth;
+  REQUIRE(tskpub::unshuffle_depth(
+      tskpub::decompress(packed->data(), packed->size()), depth));
+  CHECK(depth == img.depth);
+
+  std::vector<Point> out(pts.size());
+  auto n = img.to_points(out.data());
+  size_t k = 0;
+  for (const auto &p : pts) {
+    if (std::isnan(p.x)) continue;
+    REQUIRE(k < n);
+    const auto &q = out[k++];
+    // range is quantized to depth_scale
+    CHECK(std::hypot(p.x - q.x, p.y - q.y, p.z - q.z)
+          <= img.depth_scale / 2 + 1e-4f);
+    CHECK(std::abs(p.intensity - q.intensity) <= img.max_intensity / 255);
+  }
+  CHECK(n == k);
+}
+
+// run with --no-skip on the target board
+TEST_CASE("Bench.range_image" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  Scene scene;
+  std::vector<std::vector<Point>> frames;
+  for (int i = 0; i < 20; i++) frames.push_back(scene.frame());
+
+  std::ostringstream os;
+  os << std::left << std::setw(28) << "encoding" << std::setw(14)
+     << "bytes/frame" << "ms/frame\n";
+  auto bench = [&](const std::string &name, auto &&encode) {
+    size_t bytes = 0;
+    auto start = clock::now();
+    for (const auto &f : frames) bytes += encode(f);
+    auto ms = std::chrono::duration<double, std::milli>(clock::now() - start)
+                  .count();
+    os << std::setw(28) << name << std::setw(14) << bytes / frames.size()
+       << ms / frames.size() << "\n";
+  };
+
+  bench("PointCloud 5000 points", [](auto &f) {
+    return pointcloud_bytes(f, 5000);
+  });
+  for (auto [algo, level] : {std::pair{"lz4", 0}, std::pair{"zstd", 1},
+                             std::pair{"zstd", 3}, std::pair{"zstd", 9}}) {
+    tskpub::CompressParams cp;
+    cp.algo = algo;
+    cp.level = level;
+    auto c = tskpub::CompressorFactory::create(cp);
+    tskpub::RangeImage img;
+    img.intrinsics = truth;
+    tskpub::Msg planes;
+    bench("range image " + cp.algo + "-" + std::to_string(level),
+          [&](auto &f) {
+            img.from_points(f.data(), 320, 240);
+            tskpub::shuffle_depth(img.depth, planes);
+            return tskpub::compress(*c, planes.data(), planes.size())->size()
+                   + tskpub::compress(*c, img.intensity.data(),
+                                      img.intensity.size())
+                         ->size();
+          });
+  }
+  MESSAGE(os.str());
+}
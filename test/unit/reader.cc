@@ -1,18 +1,35 @@
 #include "reader/reader.hh"
 
+#include <TSKPub/imu_history.hh>
 #include <TSKPub/msg/Image.capnp.h>
 #include <TSKPub/msg/Imu.capnp.h>
+#include <TSKPub/msg/ImuDelta.capnp.h>
 #include <TSKPub/msg/PointCloud.capnp.h>
+#include <TSKPub/msg/Series.capnp.h>
 #include <TSKPub/msg/Status.capnp.h>
 #include <capnp/serialize-packed.h>
+#include <dirent.h>
 #include <doctest/doctest.h>
+#include <fcntl.h>
 #include <sys/stat.h>
-
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <optional>
+#include <random>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "common.hh"
+#include "reader/serial_hub.hh"
 
 #ifndef CONFIG_FILE
 #  error "CONFIG_FILE macro must be defined"
@@ -79,6 +96,123 @@ namespace {
       root = reader->getRoot<T>();
     }
   };
+
+  /// @brief Reader that packs given bytes as an Image message with a far
+  ///        too small reservation
+  class BlobReader final : public tskpub::Reader {
+  public:
+    using Reader::Reader;
+
+    tskpub::MsgConstPtr read() override { return nullptr; }
+
+    tskpub::MsgPtr pack(const std::vector<uint8_t> &blob) {
+      capnp::MallocMessageBuilder builder;
+      auto img = builder.initRoot<Image>();
+      fill_header(img, 1);
+      img.setData(kj::ArrayPtr<const kj::byte>(blob.data(), blob.size()));
+      return to_msg(builder, 16, 1);
+    }
+  };
+
+  /// @brief HiPNUC IMU on a pseudo terminal, the port in the config file is
+  ///        a symlink to the slave side
+  struct ImuSim {
+    int master{-1};
+    std::string link;
+    // device clock in ms, sent with every packet
+    uint32_t time{0};
+
+    explicit ImuSim(std::string path) : link(std::move(path)) {
+      master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+      REQUIRE(master >= 0);
+      REQUIRE(grantpt(master) == 0);
+      REQUIRE(unlockpt(master) == 0);
+      ::unlink(link.c_str());
+      REQUIRE(symlink(ptsname(master), link.c_str()) == 0);
+    }
+
+    ~ImuSim() {
+      ::unlink(link.c_str());
+      close(master);
+    }
+
+    /// @brief Send a 0x91 packet with the given acceleration in g
+    /// @param corrupt Break the checksum
+    void send(float ax, float ay, float az, bool corrupt = false) {
+      // tag, pps, temp, pressure, time, then acc at 12 and quat at 60
+      std::array<uint8_t, 76> payload{};
+      payload[0] = 0x91;
+      std::memcpy(&payload[8], &time, sizeof(time));
+      float acc[3] = {ax, ay, az};
+      std::memcpy(&payload[12], acc, sizeof(acc));
+      float quat[4] = {1.f, 0.f, 0.f, 0.f};
+      std::memcpy(&payload[60], quat, sizeof(quat));
+
+      // [0x5a 0xa5][len][crc16 of the header and payload][payload]
+      const uint8_t len = payload.size();
+      std::vector<uint8_t> frame{0x5a, 0xa5, len, 0, 0, 0};
+      uint16_t crc = crc16(0, frame.data(), 4);
+      crc = crc16(crc, payload.data(), payload.size());
+      frame[4] = crc & 0xff;
+      frame[5] = crc >> 8;
+      if (corrupt) frame[4] ^= 0xff;
+      frame.insert(frame.end(), payload.begin(), payload.end());
+      REQUIRE(write(master, frame.data(), frame.size())
+              == ssize_t(frame.size()));
+
+      // drop what the reader wrote, e.g. the output enable command
+      std::array<uint8_t, 256> buf;
+      while (::read(master, buf.data(), buf.size()) > 0) {
+      }
+    }
+
+    static uint16_t crc16(uint16_t crc, const uint8_t *data, size_t len) {
+      for (size_t i = 0; i < len; i++) {
+        crc ^= data[i] << 8;
+        for (int k = 0; k < 8; k++) {
+          crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+      }
+      return crc;
+    }
+  };
+
+  /// @brief Number of threads of this process
+  size_t thread_count() {
+    size_t n = 0;
+    auto dir = opendir("/proc/self/task");
+    while (auto entry = readdir(dir)) n += entry->d_name[0] != '.';
+    closedir(dir);
+    return n;
+  }
+
+  /// @brief Pause a reader, check that it stops producing and measure the
+  ///        time from resume to the first message
+  /// @return resume latency in ms
+  double check_pause(tskpub::Reader &reader, const std::string &name) {
+    using clock = std::chrono::steady_clock;
+    reader.pause();
+    CHECK(reader.paused());
+    // paused readers return nothing
+    for (int i = 0; i < 10; i++) {
+      CHECK((reader.read() == nullptr));
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto start = clock::now();
+    reader.resume();
+    CHECK_FALSE(reader.paused());
+    tskpub::MsgConstPtr msg{nullptr};
+    while (!msg && clock::now() - start < std::chrono::seconds(10)) {
+      msg = reader.read();
+      if (!msg) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK((msg != nullptr));
+    auto ms = std::chrono::duration<double, std::milli>(clock::now() - start)
+                  .count();
+    MESSAGE(name << " resume latency: " << ms << " ms");
+    return ms;
+  }
 }  // namespace
 
 // test if auto regist factory works
@@ -116,6 +250,109 @@ TEST_CASE("Status.read") {
   CHECK(status.getBatteryCurrent() > 0.0);
   CHECK(status.getIp().size() > 0);
   CHECK(status.getTotalReadBytes() >= 0);
+
+  // without a frame header the body carries the sequence number
+  auto next = sreader->read();
+  REQUIRE((next != nullptr));
+  CapnpMsg<Status> nextmsg(next, "info");
+  CHECK(nextmsg.root->getSeq() == status.getSeq() + 1);
+  CHECK(tskpub::ReadStats::counter("info").seq == status.getSeq() + 2);
+}
+
+// startup phases are published in the status message
+TEST_CASE("Status.startup") {
+  Fixture f{config_file};
+  tskpub::Startup::reset();
+  auto sreader = f.create_reader<tskpub::StatusReader>("info");
+  CHECK_FALSE(sreader->opened());
+  CHECK_FALSE(sreader->ready());
+  sreader->open();
+  CHECK(sreader->opened());
+  // no device, ready as soon as the command works
+  CHECK(sreader->ready());
+
+  auto msg = sreader->read();
+  REQUIRE((msg != nullptr));
+  CapnpMsg<Status> capnpmsg(msg, "info");
+  auto startup = capnpmsg.root->getStartup();
+  REQUIRE(startup.size() == 3);
+  double prev = 0;
+  for (auto [i, phase] : {std::pair{0, "open"}, std::pair{1, "ready"},
+                          std::pair{2, "opened"}}) {
+    CHECK(std::string(startup[i].getSensor().cStr()) == "info");
+    CHECK(std::string(startup[i].getPhase().cStr()) == phase);
+    CHECK(startup[i].getMs() >= prev);
+    prev = startup[i].getMs();
+  }
+}
+
+// pause and resume StatusReader
+TEST_CASE("Status.pause") {
+  Fixture f{config_file};
+  auto sreader = f.create_reader<tskpub::StatusReader>("info");
+  REQUIRE((sreader->read() != nullptr));
+  check_pause(*sreader, "info");
+}
+
+// a resumed series starts with a key for the new subscribers
+TEST_CASE("Status.series") {
+  Fixture f{config_file};
+  auto sreader = f.create_reader<tskpub::StatusReader>("info_series");
+  auto index = [&] {
+    auto msg = sreader->read();
+    REQUIRE((msg != nullptr));
+    CapnpMsg<Series> capnpmsg(msg, "info_series");
+    return capnpmsg.root->getIndex();
+  };
+  CHECK(index() == 0);
+  CHECK(index() == 1);
+  sreader->pause();
+  CHECK((sreader->read() == nullptr));
+  sreader->resume();
+  CHECK(index() == 0);
+  CHECK(index() == 1);
+}
+
+// runtime parameters are validated before anything is changed
+TEST_CASE("Reader.set_params") {
+  Fixture f{config_file};
+  auto sreader = f.create_reader<tskpub::StatusReader>("info");
+  CHECK(sreader->set_params({}));
+  CHECK_FALSE(sreader->set_params({{"rate", 1.}}));
+
+  // the lidar connects lazily, so this does not need the device
+  auto lreader = f.create_reader<tskpub::LidarReader>("laser");
+  CHECK(lreader->set_params({{"cloud_size", 2000.}, {"dustEnable", 1.}}));
+  CHECK_FALSE(lreader->set_params({{"cloud_size", 2000.}, {"foo", 1.}}));
+  CHECK_FALSE(lreader->set_params({{"medianSize", -1.}}));
+
+  // parameters of the configured pipeline stages
+  auto vreader = f.create_reader<tskpub::LidarReader>("laser_voxel");
+  CHECK(vreader->set_params({{"voxel_leaf", 0.1}, {"cloud_size", 500.}}));
+  CHECK_FALSE(vreader->set_params({{"voxel_leaf", 0.}}));
+
+  // no sampling stage, the cloud size is ignored as before the pipeline
+  auto oreader = f.create_reader<tskpub::LidarReader>("laser_octree");
+  CHECK(oreader->set_params({{"cloud_size", 2000.}}));
+  CHECK_FALSE(oreader->set_params({{"cloud_size", 0.}}));
+  CHECK_FALSE(oreader->set_params({{"voxel_leaf", 0.1}}));
+}
+
+// packing random bytes takes more than their size, the message grows
+TEST_CASE("Reader.to_msg") {
+  Fixture f{config_file};
+  BlobReader reader("info");
+  std::mt19937 rng{7};
+  std::vector<uint8_t> blob(512 * 1024);
+  for (auto &b : blob) b = uint8_t(rng() | 1);
+  auto msg = reader.pack(blob);
+  REQUIRE((msg != nullptr));
+  CHECK(msg->size() > blob.size());
+
+  CapnpMsg<Image> capnpmsg(msg, "info");
+  auto data = capnpmsg.root->getData();
+  REQUIRE(data.size() == blob.size());
+  CHECK(std::equal(data.begin(), data.end(), blob.begin()));
 }
 
 // package data from IMUReader
@@ -187,8 +424,11 @@ TEST_CASE("Camera.read") {
   REQUIRE(is_device_exist(port));
 
   auto cam = f.create_reader<tskpub::CameraReader>(sensor_name);
-  auto msg = cam->read();
-  CHECK((msg != nullptr));
+  cam->open();
+  tskpub::MsgConstPtr msg{nullptr};
+  // the first frame follows the pipeline start
+  while (!msg) msg = cam->read();
+  CHECK(cam->ready());
 
   CapnpMsg<Image> capnpmsg(msg, sensor_name);
   auto &image = capnpmsg.root.value();
@@ -209,6 +449,79 @@ TEST_CASE("Camera.read") {
   CHECK(data[1] == 0xd8);
 }
 
+// scaled preview frames and full resolution stills from one test source,
+// a still is only encoded on request
+TEST_CASE("Camera.snapshot") {
+  Fixture f{config_file};
+  auto cam = f.create_reader<tskpub::CameraReader>("video_test");
+  auto still = f.create_reader<tskpub::SnapshotReader>("video_still");
+  REQUIRE((cam != nullptr));
+  REQUIRE((still != nullptr));
+  cam->open();
+  still->open();
+  CHECK(still->ready());
+
+  for (int i = 0; i < 5; i++) {
+    tskpub::MsgConstPtr msg{nullptr};
+    while (!msg) msg = cam->read();
+    CapnpMsg<Image> preview(msg, "video_test");
+    CHECK(preview.root->getWidth() == 320);
+    CHECK(preview.root->getHeight() == 240);
+  }
+  CHECK((still->read() == nullptr));
+
+  // one still per request
+  REQUIRE(still->set_params({{"snapshot", 1.}}));
+  tskpub::MsgConstPtr msg{nullptr};
+  for (int i = 0; i < 100 && !msg; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    msg = still->read();
+  }
+  REQUIRE((msg != nullptr));
+  CapnpMsg<Image> capnpmsg(msg, "video_still");
+  auto &image = capnpmsg.root.value();
+  CHECK(std::string(image.getTopic().cStr()) == "/tinysk/video_still");
+  CHECK(image.getWidth() == 1280);
+  CHECK(image.getHeight() == 720);
+  CHECK(std::string(image.getEncoding().cStr()) == "jpeg");
+  const auto &data = image.getData();
+  REQUIRE(data.size() > 2);
+  CHECK(data[0] == 0xff);
+  CHECK(data[1] == 0xd8);
+
+  // the branch is closed again, the preview goes on
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  CHECK((still->read() == nullptr));
+  msg = nullptr;
+  while (!msg) msg = cam->read();
+  CHECK_FALSE(still->set_params({{"quality", 50.}}));
+}
+
+// a still requested with the preview paused runs the pipeline until the
+// still is taken
+TEST_CASE("Camera.snapshot_paused") {
+  Fixture f{config_file};
+  auto cam = f.create_reader<tskpub::CameraReader>("video_test");
+  auto still = f.create_reader<tskpub::SnapshotReader>("video_still");
+  REQUIRE((cam != nullptr));
+  REQUIRE((still != nullptr));
+  cam->open();
+  still->open();
+  cam->pause();
+
+  REQUIRE(still->set_params({{"snapshot", 1.}}));
+  tskpub::MsgConstPtr msg{nullptr};
+  for (int i = 0; i < 250 && !msg; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    msg = still->read();
+  }
+  REQUIRE((msg != nullptr));
+  CapnpMsg<Image> capnpmsg(msg, "video_still");
+  CHECK(capnpmsg.root->getWidth() == 1280);
+  // the preview stays paused
+  CHECK((cam->read() == nullptr));
+}
+
 // read once from LidarReader
 TEST_CASE("Lidar.read") {
   Fixture f{config_file};
@@ -235,3 +548,311 @@ TEST_CASE("Lidar.read") {
   auto points = cloud.getPoints();
   CHECK(points.size() > 1000);
 }
+
+// pause and resume IMUReader, the port is closed while paused
+TEST_CASE("IMU.pause") {
+  Fixture f{config_file};
+  std::string sensor_name{"imu0"};
+  auto port = f.yaml()[sensor_name]["port"].get_value<std::string>();
+  REQUIRE(is_device_exist(port));
+
+  auto ireader = f.create_reader<tskpub::IMUReader>(sensor_name);
+  REQUIRE((ireader->read() != nullptr));
+  CHECK(check_pause(*ireader, sensor_name) < 500);
+}
+
+// pause and resume CameraReader, the pipeline is torn down and rebuilt.
+// Runs on the test source, no device needed
+TEST_CASE("Camera.pause") {
+  Fixture f{config_file};
+  std::string sensor_name{"video_test"};
+
+  auto cam = f.create_reader<tskpub::CameraReader>(sensor_name);
+  tskpub::MsgConstPtr msg{nullptr};
+  while (!msg) msg = cam->read();
+  CHECK(check_pause(*cam, sensor_name) < 2000);
+  // a second cycle connects the camera rebuilt by the first
+  CHECK(check_pause(*cam, sensor_name) < 2000);
+}
+
+// pause and resume LidarReader, streaming is stopped and started
+TEST_CASE("Lidar.pause") {
+  Fixture f{config_file};
+  std::string sensor_name{"laser"};
+  REQUIRE(
+      is_device_exist(f.yaml()[sensor_name]["port"].get_value<std::string>()));
+
+  auto lreader = f.create_reader<tskpub::LidarReader>(sensor_name);
+  tskpub::MsgConstPtr msg{nullptr};
+  while (!msg) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    msg = lreader->read();
+  }
+  CHECK(check_pause(*lreader, sensor_name) < 2000);
+}
+
+// several IMUs on simulated ports, each reader only sees its own device and
+// all of them share one polling thread
+TEST_CASE("IMU.multi_instance") {
+  Fixture f{config_file};
+  constexpr size_t n = 3;
+  std::vector<std::unique_ptr<ImuSim>> sims;
+  std::vector<tskpub::IMUReader::Ptr> readers;
+  for (size_t i = 0; i < n; i++) {
+    auto name = "imu_sim" + std::to_string(i);
+    sims.push_back(std::make_unique<ImuSim>(
+        f.yaml()[name]["port"].get_value<std::string>()));
+  }
+  // the hub thread may already run from other tests
+  tskpub::SerialHub::instance();
+  auto threads = thread_count();
+  auto ports = tskpub::SerialHub::instance().size();
+  for (size_t i = 0; i < n; i++) {
+    readers.push_back(
+        f.create_reader<tskpub::IMUReader>("imu_sim" + std::to_string(i)));
+    readers.back()->open();
+  }
+  CHECK(tskpub::SerialHub::instance().size() == ports + n);
+  CHECK(thread_count() == threads);
+
+  for (int round = 0; round < 5; round++) {
+    for (size_t i = 0; i < n; i++) sims[i]->send(float(i), float(round), 1.f);
+    for (size_t i = 0; i < n; i++) {
+      auto name = "imu_sim" + std::to_string(i);
+      auto msg = readers[i]->read();
+      REQUIRE((msg != nullptr));
+      CapnpMsg<Imu> capnpmsg(msg, name);
+      auto &imu = capnpmsg.root.value();
+      CHECK(std::string(imu.getTopic().cStr())
+            == "/tinysk/imu" + std::to_string(i));
+      auto acc = imu.getLinearAcceleration();
+      CHECK(acc.getX() == doctest::Approx(i * 9.8));
+      CHECK(acc.getY() == doctest::Approx(round * 9.8));
+      CHECK(acc.getZ() == doctest::Approx(9.8));
+      // no new sample until the next packet
+      CHECK((readers[i]->read() == nullptr));
+    }
+  }
+
+  // closing one port does not disturb the others
+  readers[0]->pause();
+  CHECK((readers[0]->read() == nullptr));
+  CHECK(tskpub::SerialHub::instance().size() == ports + n - 1);
+  sims[1]->send(0.f, 0.f, 2.f);
+  CHECK((readers[1]->read() != nullptr));
+  readers.clear();
+  CHECK(tskpub::SerialHub::instance().size() == ports);
+}
+
+// an unplugged device is reported to its reader, which reopens the port
+TEST_CASE("IMU.hangup") {
+  Fixture f{config_file};
+  const std::string name{"imu_sim0"};
+  auto port = f.yaml()[name]["port"].get_value<std::string>();
+  auto sim = std::make_unique<ImuSim>(port);
+  auto reader = f.create_reader<tskpub::IMUReader>(name);
+  reader->open();
+  auto ports = tskpub::SerialHub::instance().size();
+  sim->send(0.f, 0.f, 1.f);
+  REQUIRE((reader->read() != nullptr));
+
+  // closing the master side hangs up the port, the hub stops polling it
+  sim.reset();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (tskpub::SerialHub::instance().size() == ports
+         && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(tskpub::SerialHub::instance().size() == ports - 1);
+
+  // plugged in again, the next read opens the new device
+  sim = std::make_unique<ImuSim>(port);
+  CHECK((reader->read() == nullptr));
+  CHECK(tskpub::SerialHub::instance().size() == ports);
+  sim->send(0.f, 0.f, 2.f);
+  CHECK((reader->read() != nullptr));
+}
+
+// every discarded sample is counted and leaves a gap in the sequence numbers
+TEST_CASE("IMU.loss") {
+  Fixture f{config_file};
+  const std::string name{"imu_sim0"};
+  ImuSim sim(f.yaml()[name]["port"].get_value<std::string>());
+  auto reader = f.create_reader<tskpub::IMUReader>(name);
+  reader->open();
+  auto &c = tskpub::ReadStats::counter(name);
+  auto dropped = [&](tskpub::DropStage s) {
+    return c.dropped[size_t(s)].load();
+  };
+  auto overwrite = dropped(tskpub::DropStage::Overwrite);
+  auto decode = dropped(tskpub::DropStage::Decode);
+  auto seq = c.seq.load();
+
+  // three samples before the reader looks, the hub thread decodes them
+  for (int i = 0; i < 3; i++) sim.send(0.f, 0.f, 1.f);
+  sim.send(0.f, 0.f, 1.f, true);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (dropped(tskpub::DropStage::Decode) == decode
+         && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(dropped(tskpub::DropStage::Decode) == decode + 1);
+  CHECK(dropped(tskpub::DropStage::Overwrite) == overwrite + 2);
+  CHECK((reader->read() != nullptr));
+  CHECK(c.seq == seq + 3);
+
+  // reported through the status message
+  bool found = false;
+  for (const auto &r : tskpub::ReadStats::losses()) {
+    if (r.sensor != name) continue;
+    found = true;
+    CHECK(r.seq == seq + 3);
+    CHECK(r.dropped[size_t(tskpub::DropStage::Overwrite)] == overwrite + 2);
+  }
+  CHECK(found);
+}
+
+// the device settings go out as AT commands before the output is enabled,
+// then the time from the packet on the wire to the message is measured
+TEST_CASE("IMU.low_latency") {
+  Fixture f{config_file};
+  const std::string name{"imu_sim_fast"};
+  ImuSim sim(f.yaml()[name]["port"].get_value<std::string>());
+
+  // answer every command line with OK while the reader opens
+  std::vector<std::string> commands;
+  std::atomic<bool> answering{true};
+  std::thread responder([&] {
+    std::string line;
+    char c;
+    while (answering) {
+      if (::read(sim.master, &c, 1) != 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      line += c;
+      if (line.size() < 2 || line.compare(line.size() - 2, 2, "\r\n")) {
+        continue;
+      }
+      commands.push_back(line.substr(0, line.size() - 2));
+      line.clear();
+      REQUIRE(write(sim.master, "OK\r\n", 4) == 4);
+    }
+  });
+  auto reader = f.create_reader<tskpub::IMUReader>(name);
+  reader->open();
+  answering = false;
+  responder.join();
+  CHECK(commands
+        == std::vector<std::string>{"AT+EOUT=0", "AT+ODR=400", "AT+SETPTL=91",
+                                    "AT+BAUD=921600", "AT+EOUT=1"});
+  // the host followed the device to the new rate
+  termios tio;
+  REQUIRE(tcgetattr(sim.master, &tio) == 0);
+  CHECK(cfgetospeed(&tio) == B921600);
+
+  using clock = std::chrono::steady_clock;
+  std::vector<double> latency;
+  for (int i = 0; i < 200; i++) {
+    auto start = clock::now();
+    sim.send(0.f, 0.f, 1.f);
+    tskpub::MsgConstPtr msg{nullptr};
+    while (!msg) msg = reader->read();
+    latency.push_back(
+        std::chrono::duration<double, std::micro>(clock::now() - start)
+            .count());
+  }
+  std::sort(latency.begin(), latency.end());
+  auto median = latency[latency.size() / 2];
+  auto p99 = latency[latency.size() * 99 / 100];
+  MESSAGE("byte arrival to message: median " << median << " us, p99 " << p99
+                                             << " us");
+  // vmin is one packet, so a packet wakes the hub thread once
+  CHECK(p99 < 5000);
+}
+
+// a resting IMU at 500 Hz, integrated over fixed periods of 50 ms
+TEST_CASE("IMU.preintegration") {
+  Fixture f{config_file};
+  const std::string name{"imu_sim_delta"};
+  ImuSim sim(f.yaml()[name]["port"].get_value<std::string>());
+  auto reader = f.create_reader<tskpub::IMUReader>(name);
+  CHECK(reader->schema() == tskpub::Schema::ImuDelta);
+  reader->open();
+
+  std::atomic<bool> sending{true};
+  std::thread sender([&] {
+    while (sending) {
+      sim.send(0.f, 0.f, 1.f);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+  });
+  uint64_t end = 0;
+  for (int i = 0; i < 3; i++) {
+    tskpub::MsgConstPtr msg{nullptr};
+    while (!msg) msg = reader->read();
+    CapnpMsg<ImuDelta> capnpmsg(msg, name);
+    auto &delta = capnpmsg.root.value();
+    CHECK(std::string(delta.getTopic().cStr()) == "/tinysk/imu_delta");
+    // deltas are contiguous and end at the period
+    if (end) CHECK(delta.getStartTime() == end);
+    end = delta.getTimestamp();
+    CHECK(end - delta.getStartTime() == 50000000);
+    CHECK(delta.getSamples() > 10);
+
+    // the specific force of gravity, held over the whole period
+    CHECK(delta.getVelocity().getZ() == doctest::Approx(9.8 * 0.05));
+    CHECK(delta.getPosition().getZ()
+          == doctest::Approx(0.5 * 9.8 * 0.05 * 0.05));
+    CHECK(delta.getVelocity().getX() == 0);
+    CHECK(delta.getRotation().getW() == 1);
+    REQUIRE(delta.getCovariance().size() == 45);
+    CHECK(delta.getCovariance()[0] > 0);
+  }
+  sending = false;
+  sender.join();
+}
+
+// a 400 Hz IMU behind an adapter that batches four packets, the sample times
+// follow the device clock instead of the batches
+TEST_CASE("IMU.stamp_filter") {
+  Fixture f{config_file};
+  const std::string name{"imu_sim_stamp"};
+  ImuSim sim(f.yaml()[name]["port"].get_value<std::string>());
+  auto reader = f.create_reader<tskpub::IMUReader>(name);
+  reader->open();
+
+  // the first sample marks the start of the history to look at
+  using clock = std::chrono::steady_clock;
+  constexpr size_t n = 400;
+  constexpr auto period = std::chrono::microseconds(2500);
+  auto start = clock::now();
+  sim.send(0.f, 0.f, 1.f);
+  tskpub::MsgConstPtr msg{nullptr};
+  while (!msg) msg = reader->read();
+  const uint64_t first = CapnpMsg<Imu>(msg, name).root->getTimestamp();
+  for (size_t k = 1; k <= n; k++) {
+    if (k % 4 == 1) std::this_thread::sleep_until(start + (k + 3) * period);
+    sim.time = k * 5 / 2;
+    sim.send(0.f, 0.f, 1.f);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  std::vector<tskpub::RateSample> samples(n + 1);
+  REQUIRE(tskpub::ImuHistory::get(name).copy(first, UINT64_MAX,
+                                             samples.data(), samples.size())
+          == n + 1);
+  // deviation from the device schedule, after the fit has settled
+  std::vector<double> dev;
+  for (size_t k = 64; k <= n; k++) {
+    dev.push_back(double(samples[k].stamp - samples[0].stamp) / 1e3
+                  - k * 2500.);
+  }
+  double mean = 0, sq = 0;
+  for (auto d : dev) mean += d;
+  mean /= dev.size();
+  for (auto d : dev) sq += (d - mean) * (d - mean);
+  auto jitter = std::sqrt(sq / dev.size());
+  MESSAGE("sample time jitter " << jitter << " us, batches alone 2800 us");
+  CHECK(jitter < 1000);
+}
@@ -0,0 +1,202 @@
+#include "TSKPub/scene.hh"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace {
+  constexpr uint64_t ms = 1000000;
+  constexpr int Width = 640, Height = 480;
+
+  /// @brief Reference for block_sad()
+  std::vector<uint32_t> sad_scalar(const std::vector<uint8_t> &a,
+                                   const std::vector<uint8_t> &b,
+                                   size_t width, size_t height) {
+    std::vector<uint32_t> out((width / 8) * (height / 8), 0);
+    for (size_t y = 0; y < height / 8 * 8; y++) {
+      for (size_t x = 0; x < width / 8 * 8; x++) {
+        auto i = y * width + x;
+        out[y / 8 * (width / 8) + x / 8] += std::abs(a[i] - b[i]);
+      }
+    }
+    return out;
+  }
+
+  /// @brief RGB frame of a still room, a box at (bx, by), the view shifted
+  ///        by pan pixels and sensor noise
+  std::vector<uint8_t> scene(std::mt19937 &rng, int bx, int by, int pan) {
+    std::normal_distribution<float> noise(0.f, 2.f);
+    std::vector<uint8_t> rgb(Width * Height * 3);
+    for (int y = 0; y < Height; y++) {
+      for (int x = 0; x < Width; x++) {
+        int u = x + pan;
+        // walls, a door and some texture
+        float v = 60 + 0.15f * u + 40 * ((u / 40 + y / 40) % 2);
+        if (u > 400 && u < 480 && y > 100) v = 30;
+        if (x >= bx && x < bx + 80 && y >= by && y < by + 80) v = 220;
+        v += noise(rng);
+        auto c = uint8_t(std::clamp(v, 0.f, 255.f));
+        auto *p = &rgb[(y * Width + x) * 3];
+        p[0] = c;
+        p[1] = uint8_t(c * 0.9f);
+        p[2] = uint8_t(c * 0.7f);
+      }
+    }
+    return rgb;
+  }
+
+  /// @brief Encode an RGB frame like jpegenc
+  std::vector<uint8_t> encode(const std::vector<uint8_t> &rgb,
+                              int quality = 85) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr err;
+    cinfo.err = jpeg_std_error(&err);
+    jpeg_create_compress(&cinfo);
+    unsigned char *buf = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &buf, &size);
+    cinfo.image_width = Width;
+    cinfo.image_height = Height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+      auto row = const_cast<JSAMPROW>(&rgb[cinfo.next_scanline * Width * 3]);
+      jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    std::vector<uint8_t> out(buf, buf + size);
+    jpeg_destroy_compress(&cinfo);
+    std::free(buf);
+    return out;
+  }
+
+  /// @brief 30 s at 10 fps: still, a box crossing, still, a pan, still
+  std::vector<std::vector<uint8_t>> clip() {
+    std::mt19937 rng{3};
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < 300; i++) {
+      int bx = -100, pan = 0;
+      if (i >= 100 && i < 130) bx = (i - 100) * 20;
+      if (i >= 250) pan = std::min(i - 250, 20) * 8;
+      frames.push_back(encode(scene(rng, bx, 200, pan)));
+    }
+    return frames;
+  }
+}  // namespace
+
+TEST_CASE("Scene.block_sad") {
+  std::mt19937 rng{1};
+  std::uniform_int_distribution<int> u(0, 255);
+  // an odd number of blocks and partial blocks at the edges
+  for (auto [w, h] : {std::pair<size_t, size_t>{80, 60}, {88, 64}, {7, 7}}) {
+    std::vector<uint8_t> a(w * h), b(w * h);
+    for (auto &v : a) v = u(rng);
+    for (auto &v : b) v = u(rng);
+    std::vector<uint32_t> out((w / 8) * (h / 8));
+    tskpub::block_sad(a.data(), b.data(), w, h, out.data());
+    CHECK(out == sad_scalar(a, b, w, h));
+  }
+  // the extremes do not overflow
+  std::vector<uint8_t> a(16 * 8, 0), b(16 * 8, 255);
+  std::vector<uint32_t> out(2);
+  tskpub::block_sad(a.data(), b.data(), 16, 8, out.data());
+  CHECK(out == std::vector<uint32_t>{255 * 64, 255 * 64});
+}
+
+TEST_CASE("Scene.gate") {
+  std::mt19937 rng{2};
+  tskpub::SceneGate gate{{10, 0.02, 1}};
+  uint64_t t = 1000 * ms;
+  // the first frame is the reference
+  auto still = encode(scene(rng, -100, 0, 0));
+  CHECK(gate.check(still.data(), still.size(), t));
+  CHECK(gate.change() == 1);
+
+  // sensor noise is no change
+  for (int i = 1; i < 10; i++) {
+    auto f = encode(scene(rng, -100, 0, 0));
+    CHECK_FALSE(gate.check(f.data(), f.size(), t + i * 100 * ms));
+    CHECK(gate.change() < 0.02);
+  }
+  // an object entering the view
+  auto box = encode(scene(rng, 300, 200, 0));
+  CHECK(gate.check(box.data(), box.size(), t + 950 * ms));
+  CHECK(gate.change() > 0.02);
+  CHECK_FALSE(gate.check(box.data(), box.size(), t + 1000 * ms));
+  // the keepalive counts from the last frame that passed
+  CHECK_FALSE(gate.check(box.data(), box.size(), t + 1900 * ms));
+  CHECK(gate.check(box.data(), box.size(), t + 1950 * ms));
+
+  // broken frames pass, the reference is kept
+  std::vector<uint8_t> junk(1000, 0x55);
+  CHECK(gate.check(junk.data(), junk.size(), t + 2000 * ms));
+  CHECK(gate.check(box.data(), box.size() / 2, t + 2000 * ms));
+  CHECK_FALSE(gate.check(box.data(), box.size(), t + 2000 * ms));
+  gate.reset();
+  CHECK(gate.check(box.data(), box.size(), t + 2000 * ms));
+}
+
+// run with --no-skip on the target board. TSKPUB_CLIP may name a directory
+// of JPEG frames recorded at 10 fps, a synthetic clip is used otherwise
+TEST_CASE("Bench.scene_gate" * doctest::skip()) {
+  using clock = std::chrono::steady_clock;
+  std::vector<std::vector<uint8_t>> frames;
+  std::string source = "synthetic";
+  if (auto dir = std::getenv("TSKPUB_CLIP")) {
+    std::vector<std::filesystem::path> files;
+    for (auto &e : std::filesystem::directory_iterator(dir)) {
+      if (e.path().extension() == ".jpg") files.push_back(e.path());
+    }
+    std::sort(files.begin(), files.end());
+    for (auto &f : files) {
+      std::ifstream in(f, std::ios::binary);
+      frames.emplace_back(std::istreambuf_iterator<char>(in),
+                          std::istreambuf_iterator<char>());
+    }
+    source = dir;
+  } else {
+    frames = clip();
+  }
+  REQUIRE(!frames.empty());
+
+  std::ostringstream os;
+  os << source << ", " << frames.size() << " frames\n"
+     << std::left << std::setw(12) << "keepalive" << std::setw(12)
+     << "us/frame" << std::setw(12) << "published" << "bytes\n";
+  for (double keepalive : {0., 1., 5.}) {
+    tskpub::SceneGate gate{{10, 0.02, keepalive}};
+    size_t total = 0, sent = 0, published = 0;
+    auto start = clock::now();
+    for (size_t i = 0; i < frames.size(); i++) {
+      const auto &f = frames[i];
+      total += f.size();
+      if (gate.check(f.data(), f.size(), i * 100 * ms)) {
+        sent += f.size();
+        published++;
+      }
+    }
+    auto us = std::chrono::duration<double, std::micro>(clock::now() - start)
+                  .count();
+    os << std::setw(12) << keepalive << std::setw(12) << us / frames.size()
+       << std::setw(12) << published << 100.0 * sent / total << " %\n";
+  }
+  MESSAGE(os.str());
+}
@@ -0,0 +1,202 @@
+#include "TSKPub/shaper.hh"
+
+#include <doctest/doctest.h>
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace {
+  constexpr uint64_t MS = 1000000;
+  constexpr uint64_t SEC = 1000 * MS;
+
+  /// @brief A sensor producing fixed size messages at a fixed rate
+  struct SimSource {
+    std::string name;
+    size_t msg_size;
+    uint64_t period;
+    uint64_t next{0};
+  };
+
+  /// @brief Simulated link behind the shaper.
+  ///        Sources push into the shaper on a virtual clock, the link takes
+  ///        whatever the shaper releases and records what each topic got
+  struct SimLink {
+    tskpub::Shaper shaper;
+    double rate;
+    double burst;
+    std::vector<SimSource> sources;
+    std::map<std::string, uint64_t> bytes;
+    std::map<std::string, uint64_t> max_latency;
+    std::unordered_map<const tskpub::Msg *, uint64_t> push_time;
+    uint64_t total{0};
+
+    SimLink(double rate, double burst)
+        : shaper(rate, burst), rate(rate), burst(burst) {}
+
+    void add(const std::string &name, size_t sz, double hz,
+             const tskpub::Shaper::TopicParams &params) {
+      shaper.add_topic(name, params);
+      sources.push_back({name, sz, static_cast<uint64_t>(SEC / hz)});
+    }
+
+    /// @brief Run the simulation with a 100us step
+    void run(uint64_t duration) {
+      for (uint64_t now = 1; now < duration; now += MS / 10) {
+        for (auto &s : sources) {
+          while (s.next <= now) {
+            auto msg = std::make_shared<tskpub::Msg>(s.msg_size);
+            push_time[msg.get()] = now;
+            shaper.push(s.name, msg, now);
+            s.next += s.period;
+          }
+        }
+        std::string name;
+        while (auto msg = shaper.pop(now, &name)) {
+          bytes[name] += msg->size();
+          total += msg->size();
+          auto lat = now - push_time[msg.get()];
+          max_latency[name] = std::max(max_latency[name], lat);
+          push_time.erase(msg.get());
+        }
+        // the shaper must never exceed the link budget
+        REQUIRE(total <= rate * now * 1e-9 + burst);
+      }
+    }
+  };
+}  // namespace
+
+TEST_CASE("Shaper.token_bucket") {
+  tskpub::TokenBucket b(1000, 100);
+  b.refill(1);
+  CHECK(b.conform(100));
+  b.consume(100);
+  CHECK_FALSE(b.conform(10));
+  CHECK(b.wait_time(10) == 10 * MS);
+
+  // a message larger than the bucket passes once the bucket is full
+  b.refill(1 + 100 * MS);
+  CHECK(b.conform(500));
+  b.consume(500);
+  CHECK(b.tokens < 0);
+  CHECK(b.wait_time(1) > 400 * MS);
+
+  // unlimited bucket
+  tskpub::TokenBucket u;
+  CHECK(u.conform(1 << 20));
+  CHECK(u.wait_time(1 << 20) == 0);
+}
+
+TEST_CASE("Shaper.weighted_share_under_saturation") {
+  // 100 kB/s link, video and laser together want 1 MB/s
+  SimLink link(100e3, 32e3);
+  tskpub::Shaper::TopicParams imu, video, laser, status;
+  imu.priority = status.priority = 1;
+  video.weight = 3;
+  laser.weight = 1;
+  link.add("imu", 60, 200, imu);
+  link.add("status", 200, 1, status);
+  link.add("video", 20000, 30, video);
+  link.add("laser", 20000, 20, laser);
+  link.run(20 * SEC);
+
+  // high priority topics get everything they send
+  auto imu_stats = link.shaper.stats("imu");
+  CHECK(imu_stats.dropped_msgs == 0);
+  CHECK(imu_stats.sent_msgs >= 200 * 20 - 1);
+  CHECK(link.shaper.stats("status").dropped_msgs == 0);
+
+  // and are never blocked behind the 20 kB messages
+  CHECK(link.max_latency["imu"] < 2 * MS);
+  CHECK(link.max_latency["status"] < 2 * MS);
+
+  // the rest of the link is split 3:1
+  double share = static_cast<double>(link.bytes["video"])
+                 / (link.bytes["video"] + link.bytes["laser"]);
+  MESSAGE("video share: " << share);
+  CHECK(share == doctest::Approx(0.75).epsilon(0.05));
+
+  // the link is saturated
+  CHECK(link.total > 0.95 * 100e3 * 20);
+}
+
+TEST_CASE("Shaper.topic_rate_limit") {
+  SimLink link(1e6, 64e3);
+  tskpub::Shaper::TopicParams video, laser;
+  // video is policed to 50 kB/s, laser is shaped to 20 kB/s
+  video.rate = 50e3;
+  video.burst = 20e3;
+  video.policy = tskpub::Shaper::Policy::Drop;
+  laser.rate = 20e3;
+  laser.burst = 10e3;
+  laser.queue_size = 2;
+  link.add("video", 10000, 30, video);
+  link.add("laser", 5000, 20, laser);
+  link.run(10 * SEC);
+
+  CHECK(link.bytes["video"] <= 50e3 * 10 + 20e3);
+  CHECK(link.bytes["video"] > 0.9 * 50e3 * 10);
+  CHECK(link.bytes["laser"] <= 20e3 * 10 + 10e3);
+  CHECK(link.bytes["laser"] > 0.9 * 20e3 * 10);
+  CHECK(link.shaper.stats("video").dropped_msgs > 0);
+  CHECK(link.shaper.stats("laser").dropped_msgs > 0);
+  // delayed topics never hold more than their queue size
+  CHECK(link.shaper.queued() <= 3);
+}
+
+TEST_CASE("Shaper.unlimited") {
+  tskpub::Shaper shaper(0, 0);
+  for (int i = 0; i < 4; i++) {
+    shaper.push("a", std::make_shared<tskpub::Msg>(1 << 20), 1);
+  }
+  CHECK(shaper.next_ready(1) == 0);
+  size_t n = 0;
+  while (shaper.pop(1)) n++;
+  CHECK(n == 4);
+  CHECK(shaper.next_ready(1) == UINT64_MAX);
+}
+
+// the link is reserved for the higher level, a small message below it does
+// not make the shaper ready
+TEST_CASE("Shaper.next_ready") {
+  tskpub::Shaper shaper(1000, 1000);
+  tskpub::Shaper::TopicParams video, imu;
+  video.priority = 1;
+  shaper.add_topic("video", video);
+  shaper.add_topic("imu", imu);
+  shaper.push("video", std::make_shared<tskpub::Msg>(500), SEC);
+  REQUIRE(shaper.pop(SEC));
+
+  shaper.push("video", std::make_shared<tskpub::Msg>(900), SEC);
+  shaper.push("imu", std::make_shared<tskpub::Msg>(10), SEC);
+  CHECK((shaper.pop(SEC) == nullptr));
+  auto wait = shaper.next_ready(SEC);
+  CHECK(wait > 390 * MS);
+  CHECK(wait <= 400 * MS);
+
+  std::string name;
+  CHECK((shaper.pop(SEC + wait, &name) != nullptr));
+  CHECK(name == "video");
+  CHECK(shaper.next_ready(SEC + wait) > 0);
+}
+
+TEST_CASE("Shaper.refinements") {
+  tskpub::Shaper shaper(0, 0);
+  tskpub::Shaper::TopicParams tp;
+  tp.queue_size = 3;
+  shaper.add_topic("laser", tp);
+  auto make = [](uint8_t tag) {
+    return std::make_shared<tskpub::Msg>(1, tag);
+  };
+  // three layers of a frame fit, the next frame pushes the finest out
+  for (uint8_t l = 0; l < 3; l++) CHECK(shaper.push("laser", make(l), 1, l));
+  CHECK(shaper.push("laser", make(10), 1, 0));
+  CHECK(shaper.push("laser", make(11), 1, 1));
+  // the finest layer is dropped itself
+  CHECK_FALSE(shaper.push("laser", make(12), 1, 2));
+  CHECK(shaper.stats("laser").dropped_msgs == 3);
+
+  std::vector<uint8_t> sent;
+  while (auto msg = shaper.pop(1)) sent.push_back((*msg)[0]);
+  CHECK(sent == std::vector<uint8_t>{0, 10, 11});
+}
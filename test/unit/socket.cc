@@ -0,0 +1,75 @@
+#include "TSKPub/socket.hh"
+
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+#include "TSKPub/shaper.hh"
+
+// a small message of a high priority topic and a large frame leave the
+// shaper in one burst, the subscriber gets both
+TEST_CASE("Socket.burst") {
+  zmq::context_t ctx;
+  zmq::socket_t pub(ctx, zmq::socket_type::xpub);
+  tskpub::setup_publisher(pub);
+  pub.bind("inproc://tskpub_burst");
+  zmq::socket_t sub(ctx, zmq::socket_type::sub);
+  sub.set(zmq::sockopt::rcvtimeo, 1000);
+  sub.connect("inproc://tskpub_burst");
+  sub.set(zmq::sockopt::subscribe, "");
+  // the subscription has arrived once the publisher sees it
+  zmq::message_t msg;
+  pub.set(zmq::sockopt::rcvtimeo, 1000);
+  REQUIRE(pub.recv(msg).has_value());
+
+  tskpub::Shaper shaper(0, 0);
+  tskpub::Shaper::TopicParams imu, video;
+  imu.priority = 1;
+  shaper.add_topic("imu", imu);
+  shaper.add_topic("video", video);
+  for (int i = 0; i < 3; i++) {
+    shaper.push("video", std::make_shared<tskpub::Msg>(1 << 20, 'v'), 0);
+    shaper.push("imu", std::make_shared<tskpub::Msg>(64, 'i'), 0);
+  }
+  std::string order;
+  while (auto out = shaper.pop(0)) {
+    REQUIRE(pub.send(zmq::buffer(*out), zmq::send_flags::none).has_value());
+    order += char((*out)[0]);
+  }
+  CHECK(order == "iiivvv");
+
+  std::string received;
+  while (received.size() < order.size() && sub.recv(msg)) {
+    received += msg.data<char>()[0];
+    CHECK(msg.size() == (received.back() == 'i' ? 64u : 1u << 20));
+  }
+  CHECK(received == order);
+}
+
+// a framed message is the topic frame and the message, subscribers filter
+// on the first frame
+TEST_CASE("Socket.framed") {
+  zmq::context_t ctx;
+  zmq::socket_t pub(ctx, zmq::socket_type::xpub);
+  tskpub::setup_publisher(pub);
+  pub.bind("inproc://tskpub_framed");
+  zmq::socket_t sub(ctx, zmq::socket_type::sub);
+  sub.set(zmq::sockopt::rcvtimeo, 1000);
+  sub.connect("inproc://tskpub_framed");
+  sub.set(zmq::sockopt::subscribe, tskpub::topic_frame("imu"));
+  zmq::message_t msg;
+  pub.set(zmq::sockopt::rcvtimeo, 1000);
+  REQUIRE(pub.recv(msg).has_value());
+
+  tskpub::send_message(pub, "imu0", tskpub::Msg(32, 'x'), true);
+  tskpub::send_message(pub, "imu", tskpub::Msg(16, 'i'), true);
+
+  REQUIRE(sub.recv(msg).has_value());
+  CHECK(msg.to_string() == tskpub::topic_frame("imu"));
+  REQUIRE(msg.more());
+  REQUIRE(sub.recv(msg).has_value());
+  CHECK(msg.size() == 16u);
+  CHECK(msg.data<char>()[0] == 'i');
+  CHECK_FALSE(msg.more());
+}
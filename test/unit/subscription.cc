@@ -0,0 +1,86 @@
+#include "TSKPub/subscription.hh"
+
+#include <doctest/doctest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+  /// @brief Message an XPUB socket receives for a (un)subscription
+  std::vector<uint8_t> sub_msg(bool subscribe, const std::string &prefix) {
+    std::vector<uint8_t> msg{static_cast<uint8_t>(subscribe)};
+    msg.insert(msg.end(), prefix.begin(), prefix.end());
+    return msg;
+  }
+
+  struct Recorder {
+    std::vector<std::pair<std::string, bool>> changes;
+    tskpub::SubscriptionTracker tracker;
+
+    Recorder()
+        : tracker({"status", "imu", "video", "laser"},
+                  [this](const std::string &t, bool w) {
+                    changes.emplace_back(t, w);
+                  }) {}
+
+    bool feed(bool subscribe, const std::string &prefix) {
+      auto msg = sub_msg(subscribe, prefix);
+      return tracker.update(msg.data(), msg.size());
+    }
+  };
+}  // namespace
+
+TEST_CASE("Subscription.topic") {
+  Recorder r;
+  CHECK_FALSE(r.tracker.wanted("video"));
+  REQUIRE(r.feed(true, "video"));
+  CHECK(r.tracker.wanted("video"));
+  CHECK_FALSE(r.tracker.wanted("laser"));
+  REQUIRE(r.changes.size() == 1);
+  CHECK(r.changes[0] == std::make_pair(std::string("video"), true));
+
+  // a second subscriber does not change anything
+  r.feed(true, "video");
+  CHECK(r.changes.size() == 1);
+  r.feed(false, "video");
+  CHECK(r.tracker.wanted("video"));
+  CHECK(r.changes.size() == 1);
+
+  // the last one leaving pauses the topic
+  r.feed(false, "video");
+  CHECK_FALSE(r.tracker.wanted("video"));
+  REQUIRE(r.changes.size() == 2);
+  CHECK(r.changes[1] == std::make_pair(std::string("video"), false));
+
+  // unknown unsubscribe is ignored
+  CHECK(r.feed(false, "video"));
+  CHECK(r.changes.size() == 2);
+}
+
+TEST_CASE("Subscription.prefix") {
+  Recorder r;
+  // the empty prefix subscribes to everything
+  r.feed(true, "");
+  CHECK(r.changes.size() == 4);
+  for (auto t : {"status", "imu", "video", "laser"}) {
+    CHECK(r.tracker.wanted(t));
+  }
+  r.feed(false, "");
+  CHECK(r.changes.size() == 8);
+
+  // short and long prefixes
+  r.feed(true, "im");
+  CHECK(r.tracker.wanted("imu"));
+  r.feed(false, "im");
+  r.feed(true, "laser\x01");
+  CHECK(r.tracker.wanted("laser"));
+  CHECK_FALSE(r.tracker.wanted("status"));
+}
+
+TEST_CASE("Subscription.invalid") {
+  Recorder r;
+  std::vector<uint8_t> data{2, 'i', 'm', 'u'};
+  CHECK_FALSE(r.tracker.update(data.data(), data.size()));
+  CHECK_FALSE(r.tracker.update(data.data(), 0));
+  CHECK(r.changes.empty());
+}